@@ -0,0 +1,942 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 快捷键匹配核心。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译、测试和做基准测试；
+// Window.cpp 中的钩子过程只负责把 Win32 的输入翻译成这里的数据结构。
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <bit>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <utility>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace w32oop::hotkey {
+	// 与 Window::HotKeyOptions::Scope 一一对应，数值越小优先级越高
+	enum Scope : int {
+		Windowed,
+		Thread,
+		Process,
+		System
+	};
+
+	enum Modifier : uint32_t {
+		Mod_None = 0,
+		Mod_Ctrl = 1,
+		Mod_Shift = 2,
+		Mod_Alt = 4,
+		// 鼠标组合：触发时按住的其他鼠标键。只在鼠标事件中出现，不影响键盘绑定
+		Mod_LButton = 8,
+		Mod_RButton = 16,
+		Mod_MButton = 32,
+		Mod_XButton1 = 64,
+		Mod_XButton2 = 128,
+		Mod_Buttons = Mod_LButton | Mod_RButton | Mod_MButton | Mod_XButton1 | Mod_XButton2,
+	};
+
+	constexpr uint32_t modifiers(bool ctrl, bool shift, bool alt) {
+		return (ctrl ? Mod_Ctrl : Mod_None) | (shift ? Mod_Shift : Mod_None) | (alt ? Mod_Alt : Mod_None);
+	}
+
+	// 把 (vk, 修饰键掩码) 打包成一个整数，作为索引的键
+	constexpr uint32_t pack(int vk, uint32_t mods) {
+		return (static_cast<uint32_t>(vk) & 0xFFFF) | (mods << 16);
+	}
+	constexpr int key_vk(uint32_t key) {
+		return static_cast<int>(key & 0xFFFF);
+	}
+	constexpr uint32_t key_modifiers(uint32_t key) {
+		return key >> 16;
+	}
+
+	// 与 <winuser.h> 中的 VK_* 取值相同
+	namespace vk {
+		constexpr int Shift = 0x10, Control = 0x11, Menu = 0x12;
+		constexpr int LShift = 0xA0, RShift = 0xA1;
+		constexpr int LControl = 0xA2, RControl = 0xA3;
+		constexpr int LMenu = 0xA4, RMenu = 0xA5;
+		constexpr int LWin = 0x5B, RWin = 0x5C;
+		constexpr int LButton = 0x01, RButton = 0x02, MButton = 0x04, XButton1 = 0x05, XButton2 = 0x06;
+		// 滚轮没有虚拟键码，使用 0xFF 以上的伪键码，不会与真实按键冲突
+		constexpr int WheelUp = 0x100, WheelDown = 0x101, WheelLeft = 0x102, WheelRight = 0x103;
+	}
+
+	constexpr bool is_mouse_vk(int vk_code) {
+		switch (vk_code) {
+		case vk::LButton: case vk::RButton: case vk::MButton:
+		case vk::XButton1: case vk::XButton2:
+		case vk::WheelUp: case vk::WheelDown: case vk::WheelLeft: case vk::WheelRight:
+			return true;
+		}
+		return false;
+	}
+
+	// 鼠标键对应的组合位；滚轮和键盘按键返回 0
+	constexpr uint32_t button_modifier(int vk_code) {
+		switch (vk_code) {
+		case vk::LButton: return Mod_LButton;
+		case vk::RButton: return Mod_RButton;
+		case vk::MButton: return Mod_MButton;
+		case vk::XButton1: return Mod_XButton1;
+		case vk::XButton2: return Mod_XButton2;
+		}
+		return 0;
+	}
+
+	// 把鼠标消息翻译成 (伪) 虚拟键码。mouse_data 为 MSLLHOOKSTRUCT/MOUSEHOOKSTRUCTEX 的 mouseData。
+	// 滚轮总是视为按下；不关心的消息（移动等）返回 vk == 0
+	struct MouseInput {
+		int vk = 0;
+		bool pressed = false;
+	};
+	constexpr MouseInput decode_mouse(uint32_t message, uint32_t mouse_data) {
+		// 与 <winuser.h> 中的 WM_* 取值相同
+		constexpr uint32_t LButtonDown = 0x0201, LButtonUp = 0x0202;
+		constexpr uint32_t RButtonDown = 0x0204, RButtonUp = 0x0205;
+		constexpr uint32_t MButtonDown = 0x0207, MButtonUp = 0x0208;
+		constexpr uint32_t MouseWheel = 0x020A;
+		constexpr uint32_t XButtonDown = 0x020B, XButtonUp = 0x020C;
+		constexpr uint32_t MouseHWheel = 0x020E;
+		int16_t high = static_cast<int16_t>(mouse_data >> 16);
+		switch (message) {
+		case LButtonDown: return { vk::LButton, true };
+		case LButtonUp: return { vk::LButton, false };
+		case RButtonDown: return { vk::RButton, true };
+		case RButtonUp: return { vk::RButton, false };
+		case MButtonDown: return { vk::MButton, true };
+		case MButtonUp: return { vk::MButton, false };
+		case XButtonDown: case XButtonUp:
+			if (high != 1 && high != 2) return {};
+			return { high == 1 ? vk::XButton1 : vk::XButton2, message == XButtonDown };
+		case MouseWheel:
+			if (high == 0) return {};
+			return { high > 0 ? vk::WheelUp : vk::WheelDown, true };
+		case MouseHWheel:
+			if (high == 0) return {};
+			return { high > 0 ? vk::WheelRight : vk::WheelLeft, true };
+		}
+		return {};
+	}
+
+	constexpr bool is_modifier_vk(int vk_code) {
+		switch (vk_code) {
+		case vk::Shift: case vk::Control: case vk::Menu:
+		case vk::LShift: case vk::RShift:
+		case vk::LControl: case vk::RControl:
+		case vk::LMenu: case vk::RMenu:
+		case vk::LWin: case vk::RWin:
+			return true;
+		}
+		return false;
+	}
+
+	// 在钩子内部增量维护修饰键状态，避免每次按键都调用 GetAsyncKeyState。
+	// 左右两个键分别记录，这样松开其中一个时不会误判。
+	class ModifierTracker {
+	public:
+		enum Bits : uint8_t {
+			LShift = 1, RShift = 2,
+			LCtrl = 4, RCtrl = 8,
+			LAlt = 16, RAlt = 32,
+		};
+		// 用当前的物理按键状态初始化（安装钩子时调用一次）
+		void seed(uint8_t modifier_bits, uint32_t button_bits = 0) {
+			state = modifier_bits;
+			buttons = button_bits & Mod_Buttons;
+		}
+		// 返回 true 表示 vk 是修饰键（状态已更新）
+		bool update(int vk_code, bool pressed) {
+			uint8_t bit = 0;
+			switch (vk_code) {
+			case vk::Shift: case vk::LShift: bit = LShift; break;
+			case vk::RShift: bit = RShift; break;
+			case vk::Control: case vk::LControl: bit = LCtrl; break;
+			case vk::RControl: bit = RCtrl; break;
+			case vk::Menu: case vk::LMenu: bit = LAlt; break;
+			case vk::RMenu: bit = RAlt; break;
+			default: return false;
+			}
+			if (pressed) state |= bit;
+			else state &= ~bit;
+			return true;
+		}
+		uint32_t mask() const {
+			return modifiers(state & (LCtrl | RCtrl), state & (LShift | RShift), state & (LAlt | RAlt));
+		}
+		uint8_t bits() const {
+			return state;
+		}
+		// 鼠标键的按下状态，用于鼠标组合
+		void update_button(int vk_code, bool pressed) {
+			uint32_t bit = button_modifier(vk_code);
+			if (pressed) buttons |= bit;
+			else buttons &= ~bit;
+		}
+		// 鼠标事件的修饰键掩码：键盘修饰键加上除自身以外按住的鼠标键
+		uint32_t chord_mask(int vk_code) const {
+			return mask() | (buttons & ~button_modifier(vk_code));
+		}
+	private:
+		uint8_t state = 0;
+		uint32_t buttons = 0;
+	};
+
+	// 前台窗口信息。window 为 HWND，这里只当作不透明指针比较
+	struct Foreground {
+		const void* window = nullptr;
+		uint32_t thread = 0;
+		uint32_t process = 0;
+	};
+
+	// 每次按键最多解析一次前台窗口；只有真的遇到需要判断作用域的绑定时才解析
+	template <class Resolver>
+	class ForegroundCache {
+	public:
+		explicit ForegroundCache(Resolver resolve) : resolver(std::move(resolve)) {}
+		const Foreground& get() {
+			if (!resolved) {
+				value = resolver();
+				resolved = true;
+			}
+			return value;
+		}
+		bool is_resolved() const {
+			return resolved;
+		}
+	private:
+		Resolver resolver;
+		Foreground value;
+		bool resolved = false;
+	};
+
+	template <class Handler>
+	struct Binding {
+		Scope scope = Thread;
+		const void* owner = nullptr;  // 注册它的 Window
+		const void* window = nullptr; // Windowed: 注册时的 HWND
+		uint32_t thread = 0;          // Thread: 所属线程
+		// 分发策略在注册时声明，钩子只需查表即可决定是否吞掉按键
+		bool swallow = false;
+		bool synchronous = true;      // false: 回调投递到 target 所在线程执行
+		const void* target = nullptr;
+		int native_id = 0;            // 非 0 表示由 NativeBackend（RegisterHotKey）负责，钩子不处理
+		bool accelerator = false;     // 由消息循环中的加速键表负责，钩子不处理
+		Handler handler;
+	};
+
+	// 判断绑定在当前前台窗口下是否生效
+	template <class Handler, class Resolver>
+	bool accepts(const Binding<Handler>& binding, ForegroundCache<Resolver>& foreground, uint32_t self_process) {
+		switch (binding.scope) {
+		case System:
+			return true;
+		case Windowed:
+			return foreground.get().window && foreground.get().window == binding.window;
+		case Thread:
+			return foreground.get().window && foreground.get().thread == binding.thread;
+		case Process:
+			return foreground.get().window && foreground.get().process == self_process;
+		}
+		return false;
+	}
+
+	// 所有者 -> 它注册过的键（同一个键按作用域可以出现多次）。
+	// 按所有者删除时只访问这些键，而不是扫描整张表
+	template <class Key>
+	class OwnerIndex {
+	public:
+		void add(const void* owner, const Key& key) {
+			keys[owner].push_back(key);
+		}
+		void remove(const void* owner, const Key& key) {
+			auto it = keys.find(owner);
+			if (it == keys.end()) return;
+			auto& list = it->second;
+			auto pos = std::find(list.begin(), list.end(), key);
+			if (pos != list.end()) {
+				*pos = std::move(list.back());
+				list.pop_back();
+			}
+			if (list.empty()) keys.erase(it);
+		}
+		// 取走该所有者的全部键
+		std::vector<Key> take(const void* owner) {
+			auto it = keys.find(owner);
+			if (it == keys.end()) return {};
+			auto list = std::move(it->second);
+			keys.erase(it);
+			return list;
+		}
+		bool contains(const void* owner) const {
+			return keys.find(owner) != keys.end();
+		}
+		void clear() {
+			keys.clear();
+		}
+	private:
+		std::unordered_map<const void*, std::vector<Key>> keys;
+	};
+
+	// 快捷键表：以打包后的 (vk, 修饰键) 为键的哈希索引，
+	// 每个键对应一个按作用域排序的小列表（通常只有一两个元素）。
+	template <class Handler>
+	class Table {
+	public:
+		using binding_type = Binding<Handler>;
+		using list_type = std::vector<binding_type>;
+
+		// 同一个键、同一个作用域只允许一个绑定；重复时返回 false
+		bool insert(uint32_t key, binding_type binding) {
+			auto& list = index[key];
+			auto pos = std::lower_bound(list.begin(), list.end(), binding.scope,
+				[](const binding_type& item, Scope scope) { return item.scope < scope; });
+			if (pos != list.end() && pos->scope == binding.scope) return false;
+			owners.add(binding.owner, key);
+			list.insert(pos, std::move(binding));
+			++count;
+			return true;
+		}
+		// on_erase 会在删除前收到被删除的绑定（用于释放后端资源）
+		template <class OnErase = void(*)(const binding_type&)>
+		bool erase(uint32_t key, Scope scope, OnErase on_erase = [](const binding_type&) {}) {
+			auto it = index.find(key);
+			if (it == index.end()) return false;
+			auto& list = it->second;
+			auto pos = std::find_if(list.begin(), list.end(),
+				[scope](const binding_type& item) { return item.scope == scope; });
+			if (pos == list.end()) return false;
+			on_erase(*pos);
+			owners.remove(pos->owner, key);
+			list.erase(pos);
+			--count;
+			if (list.empty()) index.erase(it);
+			return true;
+		}
+		// 只访问该所有者注册过的键，代价与表的大小无关
+		template <class OnErase = void(*)(const binding_type&)>
+		size_t erase_owner(const void* owner, OnErase on_erase = [](const binding_type&) {}) {
+			size_t removed = 0;
+			for (auto key : owners.take(owner)) {
+				auto it = index.find(key);
+				if (it == index.end()) continue;
+				auto& list = it->second;
+				auto tail = std::remove_if(list.begin(), list.end(),
+					[owner, &on_erase](const binding_type& item) {
+						if (item.owner != owner) return false;
+						on_erase(item);
+						return true;
+					});
+				removed += static_cast<size_t>(list.end() - tail);
+				list.erase(tail, list.end());
+				if (list.empty()) index.erase(it);
+			}
+			count -= removed;
+			return removed;
+		}
+		template <class OnErase = void(*)(const binding_type&)>
+		void clear(OnErase on_erase = [](const binding_type&) {}) {
+			for (auto& pair : index) {
+				for (auto& binding : pair.second) on_erase(binding);
+			}
+			index.clear();
+			owners.clear();
+			count = 0;
+		}
+		bool has_owner(const void* owner) const {
+			return owners.contains(owner);
+		}
+		bool contains(uint32_t key, Scope scope) const {
+			auto list = find(key);
+			if (!list) return false;
+			return std::any_of(list->begin(), list->end(),
+				[scope](const binding_type& item) { return item.scope == scope; });
+		}
+		// 一次哈希查找
+		const list_type* find(uint32_t key) const {
+			auto it = index.find(key);
+			return it == index.end() ? nullptr : &it->second;
+		}
+		// 返回第一个生效的绑定（作用域越小越优先），没有则返回 nullptr。
+		// 钩子过程不处理由 NativeBackend 负责的绑定；收到 WM_HOTKEY 时则需要包含它们，
+		// 以便同一个键上作用域更小的绑定仍然优先。
+		// 加速键绑定照常参与优先级比较，但胜出时钩子得到 nullptr，让按键继续走到消息循环
+		template <class Resolver>
+		const binding_type* match(uint32_t key, ForegroundCache<Resolver>& foreground, uint32_t self_process, bool include_native = false) const {
+			auto list = find(key);
+			if (!list) return nullptr;
+			for (auto& binding : *list) {
+				if (binding.native_id && !include_native) continue;
+				if (accepts(binding, foreground, self_process)) {
+					if (binding.accelerator && !include_native) return nullptr;
+					return &binding;
+				}
+			}
+			return nullptr;
+		}
+		template <class Visitor>
+		void for_each(Visitor visitor) const {
+			for (auto& pair : index) visitor(pair.first, pair.second);
+		}
+		size_t size() const {
+			return count;
+		}
+		bool empty() const {
+			return count == 0;
+		}
+	private:
+		std::unordered_map<uint32_t, list_type> index;
+		OwnerIndex<uint32_t> owners;
+		size_t count = 0;
+	};
+
+	// 多键序列（例如 Ctrl+K, Ctrl+C）。
+	// SequenceTable 是写者维护的主表；每次修改后编译成不可变的 SequenceTrie 发布给钩子，
+	// 钩子每次按键只在当前节点上做一次哈希查找，与序列的数量无关
+	template <class Handler>
+	class SequenceTable {
+	public:
+		using binding_type = Binding<Handler>;
+		using list_type = std::vector<binding_type>;
+		using sequence_type = std::vector<uint32_t>;
+		struct Entry {
+			list_type bindings;          // 按作用域排序
+			uint32_t timeout_ms = 0;     // 两次按键之间最长的等待时间
+		};
+
+		// 序列至少两步。同一序列、同一作用域只允许一个绑定；
+		// 与已有序列互为前缀时无法区分，也返回 false
+		bool insert(const sequence_type& keys, binding_type binding, uint32_t timeout_ms) {
+			if (keys.size() < 2) return false;
+			for (size_t length = 1; length < keys.size(); ++length) {
+				if (sequences.count(sequence_type(keys.begin(), keys.begin() + length))) return false;
+			}
+			auto next = sequences.upper_bound(keys);
+			if (next != sequences.end() && next->first.size() > keys.size()
+				&& std::equal(keys.begin(), keys.end(), next->first.begin())) {
+				return false;
+			}
+			auto& entry = sequences[keys];
+			auto pos = std::lower_bound(entry.bindings.begin(), entry.bindings.end(), binding.scope,
+				[](const binding_type& item, Scope scope) { return item.scope < scope; });
+			if (pos != entry.bindings.end() && pos->scope == binding.scope) return false;
+			owners.add(binding.owner, keys);
+			entry.bindings.insert(pos, std::move(binding));
+			entry.timeout_ms = (std::max)(entry.timeout_ms, timeout_ms);
+			++count;
+			return true;
+		}
+		template <class OnErase = void(*)(const binding_type&)>
+		bool erase(const sequence_type& keys, Scope scope, OnErase on_erase = [](const binding_type&) {}) {
+			auto it = sequences.find(keys);
+			if (it == sequences.end()) return false;
+			auto& list = it->second.bindings;
+			auto pos = std::find_if(list.begin(), list.end(),
+				[scope](const binding_type& item) { return item.scope == scope; });
+			if (pos == list.end()) return false;
+			on_erase(*pos);
+			owners.remove(pos->owner, keys);
+			list.erase(pos);
+			--count;
+			if (list.empty()) sequences.erase(it);
+			return true;
+		}
+		template <class OnErase = void(*)(const binding_type&)>
+		size_t erase_owner(const void* owner, OnErase on_erase = [](const binding_type&) {}) {
+			size_t removed = 0;
+			for (auto& keys : owners.take(owner)) {
+				auto it = sequences.find(keys);
+				if (it == sequences.end()) continue;
+				auto& list = it->second.bindings;
+				auto tail = std::remove_if(list.begin(), list.end(),
+					[owner, &on_erase](const binding_type& item) {
+						if (item.owner != owner) return false;
+						on_erase(item);
+						return true;
+					});
+				removed += static_cast<size_t>(list.end() - tail);
+				list.erase(tail, list.end());
+				if (list.empty()) sequences.erase(it);
+			}
+			count -= removed;
+			return removed;
+		}
+		template <class OnErase = void(*)(const binding_type&)>
+		void clear(OnErase on_erase = [](const binding_type&) {}) {
+			for (auto& pair : sequences) {
+				for (auto& binding : pair.second.bindings) on_erase(binding);
+			}
+			sequences.clear();
+			owners.clear();
+			count = 0;
+		}
+		bool has_owner(const void* owner) const {
+			return owners.contains(owner);
+		}
+		bool contains(const sequence_type& keys, Scope scope) const {
+			auto it = sequences.find(keys);
+			if (it == sequences.end()) return false;
+			return std::any_of(it->second.bindings.begin(), it->second.bindings.end(),
+				[scope](const binding_type& item) { return item.scope == scope; });
+		}
+		template <class Visitor>
+		void for_each(Visitor visitor) const {
+			for (auto& pair : sequences) visitor(pair.first, pair.second);
+		}
+		size_t size() const {
+			return count;
+		}
+		bool empty() const {
+			return count == 0;
+		}
+	private:
+		std::map<sequence_type, Entry> sequences;
+		OwnerIndex<sequence_type> owners;
+		size_t count = 0;
+	};
+
+	// 编译好的序列前缀树。节点 0 是根；其他节点都不会是 0，所以 step 用 0 表示“没有”
+	template <class Handler>
+	class SequenceTrie {
+	public:
+		using binding_type = Binding<Handler>;
+		struct Node {
+			std::unordered_map<uint32_t, uint32_t> children;
+			std::vector<binding_type> bindings; // 只有终点才有
+			uint32_t timeout_ms = 0;            // 子树中最长的超时
+			// 子树中出现过的作用域，以及 Windowed/Thread 绑定的窗口和线程（已排序去重），
+			// 用来判断在当前前台窗口下这一步是否可能走到某个生效的绑定
+			uint8_t scopes = 0;
+			std::vector<const void*> windows;
+			std::vector<uint32_t> threads;
+		};
+
+		SequenceTrie() : nodes(1) {}
+		explicit SequenceTrie(const SequenceTable<Handler>& table) : nodes(1) {
+			table.for_each([this](const std::vector<uint32_t>& keys, const typename SequenceTable<Handler>::Entry& entry) {
+				uint32_t current = 0;
+				for (uint32_t key : keys) {
+					auto found = nodes[current].children.find(key);
+					if (found != nodes[current].children.end()) {
+						current = found->second;
+					}
+					else {
+						uint32_t created = static_cast<uint32_t>(nodes.size());
+						nodes[current].children.emplace(key, created);
+						nodes.emplace_back();
+						current = created;
+					}
+					summarize(nodes[current], entry);
+				}
+				nodes[current].bindings = entry.bindings;
+			});
+			for (auto& node : nodes) {
+				std::sort(node.windows.begin(), node.windows.end());
+				node.windows.erase(std::unique(node.windows.begin(), node.windows.end()), node.windows.end());
+				std::sort(node.threads.begin(), node.threads.end());
+				node.threads.erase(std::unique(node.threads.begin(), node.threads.end()), node.threads.end());
+			}
+		}
+
+		// 一次哈希查找
+		uint32_t step(uint32_t node, uint32_t key) const {
+			auto& children = nodes[node].children;
+			auto found = children.find(key);
+			return found == children.end() ? 0 : found->second;
+		}
+		const Node& node(uint32_t index) const {
+			return nodes[index];
+		}
+		bool empty() const {
+			return nodes.size() == 1;
+		}
+		// system 为 true 时只考虑 System 作用域（低级钩子），否则只考虑其余作用域（线程钩子）
+		template <class Resolver>
+		bool reachable(uint32_t index, ForegroundCache<Resolver>& foreground, uint32_t self_process, bool system) const {
+			auto& node = nodes[index];
+			if (system) return (node.scopes & bit(System)) != 0;
+			if (!foreground.get().window) return false;
+			if ((node.scopes & bit(Process)) && foreground.get().process == self_process) return true;
+			if ((node.scopes & bit(Thread)) && std::binary_search(node.threads.begin(), node.threads.end(), foreground.get().thread)) return true;
+			if ((node.scopes & bit(Windowed)) && std::binary_search(node.windows.begin(), node.windows.end(), foreground.get().window)) return true;
+			return false;
+		}
+		template <class Resolver>
+		const binding_type* match(uint32_t index, ForegroundCache<Resolver>& foreground, uint32_t self_process, bool system) const {
+			for (auto& binding : nodes[index].bindings) {
+				if ((binding.scope == System) != system) continue;
+				if (accepts(binding, foreground, self_process)) return &binding;
+			}
+			return nullptr;
+		}
+		// 投递的回调执行前用来确认绑定仍然存在
+		bool contains_handler(const Handler& handler) const {
+			for (auto& node : nodes) {
+				for (auto& binding : node.bindings) {
+					if (binding.handler == handler) return true;
+				}
+			}
+			return false;
+		}
+	private:
+		static constexpr uint8_t bit(Scope scope) {
+			return static_cast<uint8_t>(1u << scope);
+		}
+		static void summarize(Node& node, const typename SequenceTable<Handler>::Entry& entry) {
+			node.timeout_ms = (std::max)(node.timeout_ms, entry.timeout_ms);
+			for (auto& binding : entry.bindings) {
+				node.scopes |= bit(binding.scope);
+				if (binding.scope == Windowed) node.windows.push_back(binding.window);
+				if (binding.scope == Thread) node.threads.push_back(binding.thread);
+			}
+		}
+		std::vector<Node> nodes;
+	};
+
+	// 每个钩子上下文一份的序列状态
+	struct SequenceState {
+		uint32_t node = 0;       // 0 表示不在序列中
+		uint32_t deadline = 0;   // GetTickCount 毫秒
+		uint64_t generation = 0; // 节点编号只在同一份 SequenceTrie 中有效
+	};
+
+	enum class SequenceStep {
+		None,    // 与序列无关，按普通按键处理
+		Pending, // 序列的中间一步，吞掉按键等待下一步
+		Matched, // 序列完成，matched 为要执行的绑定
+	};
+
+	// 每次按下（非修饰键）时推进一次。now 与 deadline 都是会回绕的毫秒计数
+	template <class Handler, class Resolver>
+	SequenceStep advance(
+		const SequenceTrie<Handler>& trie, uint64_t generation, SequenceState& state,
+		uint32_t key, uint32_t now,
+		ForegroundCache<Resolver>& foreground, uint32_t self_process, bool system,
+		const Binding<Handler>*& matched
+	) {
+		matched = nullptr;
+		if (is_modifier_vk(key_vk(key))) return SequenceStep::None;
+		if (state.node && (state.generation != generation || static_cast<int32_t>(now - state.deadline) > 0)) {
+			state.node = 0;
+		}
+		if (state.node) {
+			uint32_t next = trie.step(state.node, key);
+			state.node = 0;
+			if (next) {
+				if (!trie.node(next).bindings.empty()) {
+					matched = trie.match(next, foreground, self_process, system);
+					if (matched) return SequenceStep::Matched;
+				}
+				else if (trie.reachable(next, foreground, self_process, system)) {
+					state.node = next;
+					state.deadline = now + trie.node(next).timeout_ms;
+					return SequenceStep::Pending;
+				}
+			}
+			// 不是序列的下一步：这次按键重新从头处理，它本身可能是另一个序列的开头
+		}
+		if (trie.empty()) return SequenceStep::None;
+		uint32_t first = trie.step(0, key);
+		if (!first || !trie.reachable(first, foreground, self_process, system)) return SequenceStep::None;
+		state.node = first;
+		state.deadline = now + trie.node(first).timeout_ms;
+		state.generation = generation;
+		return SequenceStep::Pending;
+	}
+
+	// 快捷键由谁来实现
+	enum class Route {
+		Hook,         // 线程键盘钩子（WH_KEYBOARD）
+		LowLevelHook, // 全局低级键盘钩子（WH_KEYBOARD_LL），每次按键都会经过本进程
+		Native,       // RegisterHotKey，系统直接投递 WM_HOTKEY，平时没有任何开销
+		Accelerator,  // 编译进加速键表，由 Window::run() 的 TranslateAcceleratorW 处理
+	};
+
+	// RegisterHotKey 能否表达这个键：普通按键，不能是修饰键本身或鼠标键
+	constexpr bool native_expressible(uint32_t key) {
+		int vk_code = key_vk(key);
+		if (vk_code <= 0 || vk_code > 0xFE) return false;
+		if (vk_code <= 0x06 && vk_code != 0x03) return false;
+		return !is_modifier_vk(vk_code);
+	}
+
+	// RegisterHotKey 只有系统范围、并且总是吞掉按键，回调也无法在按键途中检查，
+	// 所以只有 System 作用域、异步且吞键的绑定才能使用它。
+	// 加速键同样总是吞键，且只在 Window::run() 的消息循环中生效，
+	// 所以只用于 Windowed/Thread 作用域、异步且吞键的绑定。
+	// Process 作用域只关心本进程的窗口，由每个界面线程上的线程钩子处理即可，
+	// 其他程序中的按键不会经过本进程
+	constexpr Route preferred_route(Scope scope, uint32_t key, bool swallow, bool synchronous) {
+		if ((scope == Windowed || scope == Thread) && swallow && !synchronous && native_expressible(key)) return Route::Accelerator;
+		if (scope == Windowed || scope == Thread || scope == Process) return Route::Hook;
+		if (scope == System && swallow && !synchronous && native_expressible(key)) return Route::Native;
+		return Route::LowLevelHook;
+	}
+
+	// 原生快捷键后端接口。Window.cpp 中的实现调用 RegisterHotKey/UnregisterHotKey
+	class NativeBackend {
+	public:
+		virtual ~NativeBackend() = default;
+		// 失败（例如组合键已被其他程序占用）时返回 false，调用者回退到低级钩子
+		virtual bool add(const void* target, int id, uint32_t key) = 0;
+		// 返回 true 表示已经同步注销，id 可以立即复用
+		virtual bool remove(const void* target, int id) = 0;
+	};
+
+	// 为绑定选择后端并分配 RegisterHotKey 的 id
+	class BackendSelector {
+	public:
+		explicit BackendSelector(NativeBackend& backend) : native(backend) {}
+
+		template <class Handler>
+		Route attach(uint32_t key, Binding<Handler>& binding) {
+			binding.native_id = 0;
+			Route route = preferred_route(binding.scope, key, binding.swallow, binding.synchronous);
+			binding.accelerator = (route == Route::Accelerator);
+			if (route != Route::Native) return route;
+			int id = allocate();
+			if (id && native.add(binding.target, id, key)) {
+				binding.native_id = id;
+				return Route::Native;
+			}
+			if (id) release(id);
+			return Route::LowLevelHook;
+		}
+		template <class Handler>
+		void detach(const Binding<Handler>& binding) {
+			if (!binding.native_id) return;
+			if (native.remove(binding.target, binding.native_id)) {
+				release(binding.native_id);
+			}
+		}
+	private:
+		// 应用程序可用的 id 范围是 0x0000 - 0xBFFF
+		static constexpr int max_id = 0xBFFF;
+		int allocate() {
+			if (!free_ids.empty()) {
+				int id = free_ids.back();
+				free_ids.pop_back();
+				return id;
+			}
+			if (next_id > max_id) return 0;
+			return next_id++;
+		}
+		void release(int id) {
+			free_ids.push_back(id);
+		}
+		NativeBackend& native;
+		std::vector<int> free_ids;
+		int next_id = 1;
+	};
+
+	// 与 <winuser.h> 中 ACCEL 结构的取值相同
+	namespace accel {
+		constexpr uint8_t VirtKey = 0x01, Shift = 0x04, Control = 0x08, Alt = 0x10; // FVIRTKEY, FSHIFT, FCONTROL, FALT
+		// 加速键的 WM_COMMAND id 保留范围；应用程序自己的命令 id 不要落在这里
+		constexpr uint16_t first_command = 0xA000;
+		constexpr uint16_t command_count = 0x1000;
+		constexpr bool is_command(uint32_t id) {
+			return id >= first_command && id < first_command + command_count;
+		}
+	}
+
+	struct AccelEntry {
+		uint8_t fVirt = 0;
+		uint16_t key = 0;
+		uint16_t cmd = 0;
+		bool operator==(const AccelEntry&) const = default;
+	};
+
+	// 某个顶层窗口的加速键表：entries[i] 的命令 id 为 accel::first_command + i，对应 bindings[i]
+	template <class Handler>
+	struct AcceleratorTable {
+		std::vector<AccelEntry> entries;
+		std::vector<Binding<Handler>> bindings;
+
+		const Binding<Handler>* command(uint32_t id) const {
+			if (!accel::is_command(id)) return nullptr;
+			size_t i = id - accel::first_command;
+			return i < bindings.size() ? &bindings[i] : nullptr;
+		}
+	};
+
+	// 把前台为 root（属于 thread 线程）时生效的加速键绑定编译成加速键表。
+	// 与 Table::match 的优先级一致：只有某个键上第一个生效的绑定是加速键绑定时才收录，
+	// 否则这个键仍由钩子处理。结果按键排序，输出是确定的
+	template <class Handler>
+	AcceleratorTable<Handler> compile_accelerators(const Table<Handler>& table, const void* root, uint32_t thread) {
+		std::vector<std::pair<uint32_t, const Binding<Handler>*>> picked;
+		table.for_each([&](uint32_t key, const typename Table<Handler>::list_type& list) {
+			for (auto& binding : list) {
+				if (binding.native_id) continue;
+				bool applies = binding.scope == Process || binding.scope == System
+					|| (binding.scope == Windowed && binding.window == root)
+					|| (binding.scope == Thread && binding.thread == thread);
+				if (!applies) continue;
+				if (binding.accelerator) picked.emplace_back(key, &binding);
+				break;
+			}
+		});
+		std::sort(picked.begin(), picked.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+		if (picked.size() > accel::command_count) picked.resize(accel::command_count);
+
+		AcceleratorTable<Handler> result;
+		result.entries.reserve(picked.size());
+		result.bindings.reserve(picked.size());
+		for (auto& [key, binding] : picked) {
+			uint32_t mods = key_modifiers(key);
+			AccelEntry entry;
+			entry.fVirt = accel::VirtKey
+				| ((mods & Mod_Ctrl) ? accel::Control : 0)
+				| ((mods & Mod_Shift) ? accel::Shift : 0)
+				| ((mods & Mod_Alt) ? accel::Alt : 0);
+			entry.key = static_cast<uint16_t>(key_vk(key));
+			entry.cmd = static_cast<uint16_t>(accel::first_command + result.entries.size());
+			result.entries.push_back(entry);
+			result.bindings.push_back(*binding);
+		}
+		return result;
+	}
+
+	// 钩子耗时统计：按微秒数的二进制位数分桶（桶 i 覆盖 [2^(i-1), 2^i) 微秒，桶 0 为 0 微秒），
+	// 记录一次只需几次 relaxed 原子操作，可以在钩子里直接调用，也可以被其他线程随时读取
+	constexpr size_t latency_bucket_count = 32;
+
+	constexpr size_t latency_bucket(uint64_t us) {
+		size_t bucket = static_cast<size_t>(std::bit_width(us));
+		return bucket < latency_bucket_count ? bucket : latency_bucket_count - 1;
+	}
+
+	struct LatencyStats {
+		uint64_t count = 0;
+		uint64_t total_us = 0;
+		uint64_t max_us = 0;
+		std::array<uint64_t, latency_bucket_count> buckets{};
+
+		uint64_t mean_us() const {
+			return count ? total_us / count : 0;
+		}
+		// 近似分位数（p 取 0 到 1）：返回所在桶的上界，不超过 max_us
+		uint64_t percentile(double p) const {
+			if (!count) return 0;
+			uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count - 1)) + 1;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < latency_bucket_count; ++i) {
+				seen += buckets[i];
+				if (seen >= rank) {
+					uint64_t upper = i ? (uint64_t(1) << i) - 1 : 0;
+					return (std::min)(upper, max_us);
+				}
+			}
+			return max_us;
+		}
+	};
+
+	class LatencyHistogram {
+	public:
+		void record(uint64_t us) {
+			buckets[latency_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			total_us.fetch_add(us, std::memory_order_relaxed);
+			uint64_t seen = max_us.load(std::memory_order_relaxed);
+			while (us > seen && !max_us.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {}
+		}
+		// 各个字段分别读取，并发记录时彼此之间可能相差几次，用于遥测足够了
+		LatencyStats stats() const {
+			LatencyStats result;
+			result.count = count.load(std::memory_order_relaxed);
+			result.total_us = total_us.load(std::memory_order_relaxed);
+			result.max_us = max_us.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < latency_bucket_count; ++i) {
+				result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+			}
+			return result;
+		}
+	private:
+		std::atomic<uint64_t> buckets[latency_bucket_count]{};
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> total_us{ 0 };
+		std::atomic<uint64_t> max_us{ 0 };
+	};
+
+	// 以 epoch 方式发布的只读快照（RCU）。
+	// 读者（钩子过程）从不阻塞：只需要两次原子计数，就能拿到一份不可变的表；
+	// 写者构造一份新表并发布，然后等待仍在读旧表的读者离开，再释放旧表。
+	// 注意：持有 Reader 期间不能发布新快照（会等待自己），
+	// 因此需要在回调之前把要用的数据复制出来并释放 Reader。
+	template <class T>
+	class Published {
+	public:
+		class Reader {
+		public:
+			Reader(const Reader&) = delete;
+			Reader& operator=(const Reader&) = delete;
+			~Reader() {
+				owner->readers[slot].fetch_sub(1, std::memory_order_release);
+			}
+			const T* get() const {
+				return value;
+			}
+			const T* operator->() const {
+				return value;
+			}
+		private:
+			friend class Published;
+			explicit Reader(const Published* published) : owner(published) {
+				for (;;) {
+					uint64_t epoch = owner->epoch.load(std::memory_order_acquire);
+					slot = static_cast<size_t>(epoch & 1);
+					owner->readers[slot].fetch_add(1, std::memory_order_seq_cst);
+					// 发布者可能刚好翻转了 epoch，这时退出重试，以免它看不到我们
+					if (owner->epoch.load(std::memory_order_seq_cst) == epoch) break;
+					owner->readers[slot].fetch_sub(1, std::memory_order_release);
+				}
+				value = owner->current.load(std::memory_order_acquire);
+			}
+			const Published* owner;
+			size_t slot = 0;
+			const T* value = nullptr;
+		};
+
+		Published() : current(new T()) {}
+		~Published() {
+			delete current.load();
+		}
+		Published(const Published&) = delete;
+		Published& operator=(const Published&) = delete;
+
+		Reader read() const {
+			return Reader(this);
+		}
+		// 每次发布加一。先读 generation() 再读快照，拿到的快照不会比它旧
+		uint64_t generation() const {
+			return epoch.load(std::memory_order_acquire);
+		}
+		void publish(std::unique_ptr<const T> next) {
+			std::lock_guard lock(writer);
+			const T* old = current.exchange(next.release(), std::memory_order_acq_rel);
+			uint64_t previous = epoch.fetch_add(1, std::memory_order_seq_cst);
+			auto& pending = readers[previous & 1];
+			while (pending.load(std::memory_order_acquire) != 0) {
+				std::this_thread::yield();
+			}
+			delete old;
+		}
+	private:
+		std::atomic<const T*> current;
+		std::atomic<uint64_t> epoch{ 0 };
+		mutable std::atomic<uint32_t> readers[2]{};
+		std::mutex writer;
+	};
+}
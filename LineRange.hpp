@@ -0,0 +1,107 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 按行读取文本控件：范围计算、逐行遍历和成块读取。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译、测试和做基准测试；
+// 行从哪里来由 Source 决定，foundation::Edit 用 EM_LINEINDEX / EM_LINELENGTH / EM_GETLINE 读取。
+// Source 需要提供 size_t get_line_into(int line, String& out)：把第 line 行写进 out（长度准确）并返回长度。
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace w32oop::text {
+	// 半开区间 [first, last)
+	struct LineSpan {
+		int first = 0;
+		int last = 0;
+		size_t size() const {
+			return (size_t)(last - first);
+		}
+	};
+
+	// 从 first 开始的 count 行限制到 total 行之内，count 为 -1 时到末尾
+	inline LineSpan clamp_lines(int total, int first, int count) {
+		if (total < 0) total = 0;
+		if (first < 0) first = 0;
+		if (first > total) first = total;
+		int last = (count < 0 || count > total - first) ? total : first + count;
+		return { first, last };
+	}
+
+	// 逐行遍历：for (const auto& line : range) ...
+	// 迭代器只持有一块缓冲区，解引用时才读取当前行；同一行多次解引用只读一次
+	template <class Source, class String = std::wstring>
+	class LineRange {
+	public:
+		class iterator {
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = String;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const String*;
+			using reference = const String&;
+
+			iterator() = default;
+			iterator(Source* lines, int index) : source(lines), line(index) {}
+			const String& operator*() const {
+				if (fetched != line) {
+					source->get_line_into(line, buffer);
+					fetched = line;
+				}
+				return buffer;
+			}
+			const String* operator->() const {
+				return &**this;
+			}
+			iterator& operator++() {
+				++line;
+				return *this;
+			}
+			void operator++(int) {
+				++line;
+			}
+			bool operator==(const iterator& other) const {
+				return line == other.line;
+			}
+			// 当前行号
+			int index() const {
+				return line;
+			}
+		private:
+			Source* source = nullptr;
+			int line = 0;
+			mutable int fetched = -1;
+			mutable String buffer;
+		};
+
+		LineRange(Source* lines, LineSpan range) : source(lines), span(range) {}
+		iterator begin() const {
+			return iterator(source, span.first);
+		}
+		iterator end() const {
+			return iterator(source, span.last);
+		}
+		size_t size() const {
+			return span.size();
+		}
+	private:
+		Source* source;
+		LineSpan span;
+	};
+
+	// 一次读取 span 中的所有行。out 里已有的字符串会被复用，返回读到的行数
+	template <class Source, class String>
+	size_t read_lines(Source& source, LineSpan span, std::vector<String>& out) {
+		size_t n = span.size();
+		out.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			source.get_line_into(span.first + (int)i, out[i]);
+		}
+		return n;
+	}
+}
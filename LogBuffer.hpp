@@ -0,0 +1,219 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 日志视图的数据部分：按行存储的环形缓冲区，以及跨线程攒批的待显示行。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译、测试和做基准测试；
+// foundation::LogView 只负责绘制和滚动。
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <utility>
+
+namespace w32oop::logging {
+	// 按行拆分文本，"\r\n" 和 "\n" 都算换行；结尾的换行不产生额外的空行，空文本算一行
+	template <class F>
+	inline void for_each_line(std::wstring_view text, F&& f) {
+		size_t start = 0;
+		do {
+			size_t end = text.find(L'\n', start);
+			size_t stop = end == std::wstring_view::npos ? text.size() : end;
+			size_t length = stop - start;
+			if (length && text[stop - 1] == L'\r') --length;
+			f(text.substr(start, length));
+			if (end == std::wstring_view::npos) break;
+			start = end + 1;
+		} while (start < text.size());
+	}
+
+	// 最多保存 capacity 行，写满后覆盖最早的行。
+	// 每个槽位的字符串在覆盖时复用自己的容量，稳定后追加不再分配内存；
+	// 超过 max_line_length 的行被截断，所以内存上限约为 capacity * max_line_length。
+	// 每行有一个单调递增的序号，视图用它定位，不受丢弃旧行的影响。不是线程安全的
+	class LineRing {
+	public:
+		explicit LineRing(size_t capacity = 10000, size_t max_line_length = 4096)
+			: cap(capacity ? capacity : 1), max_length(max_line_length ? max_line_length : 1) {}
+
+		void push(std::wstring_view line) {
+			slot().assign(line.substr(0, max_length));
+		}
+		// 交换进槽位，被覆盖的字符串换回 line，调用者可以继续复用它的容量
+		void push_swap(std::wstring& line) {
+			if (line.size() > max_length) line.resize(max_length);
+			slot().swap(line);
+		}
+		// 把 other 的所有行按顺序移进来，然后清空 other；两边的字符串都不重新分配
+		void take_from(LineRing& other) {
+			for (size_t i = 0; i < other.count; ++i) {
+				push_swap(other.at(i));
+			}
+			other.clear();
+		}
+		// 清空内容但保留槽位和序号
+		void clear() {
+			first = next_sequence;
+			head = 0;
+			count = 0;
+		}
+
+		// 0 为最早的一行
+		const std::wstring& operator[](size_t index) const {
+			return slots[(head + index) % slots.size()];
+		}
+		// 序号不在缓冲区内时返回 nullptr
+		const std::wstring* find(uint64_t sequence) const {
+			if (sequence < first || sequence >= next_sequence) return nullptr;
+			return &(*this)[(size_t)(sequence - first)];
+		}
+		size_t size() const {
+			return count;
+		}
+		bool empty() const {
+			return count == 0;
+		}
+		// 最早一行的序号
+		uint64_t first_sequence() const {
+			return first;
+		}
+		// 下一行的序号，也就是追加过的总行数
+		uint64_t end_sequence() const {
+			return next_sequence;
+		}
+
+		size_t capacity() const {
+			return cap;
+		}
+		// 缩小时只保留最新的行
+		void capacity(size_t capacity) {
+			if (!capacity) capacity = 1;
+			if (capacity == cap) return;
+			size_t keep = (std::min)(count, capacity);
+			std::vector<std::wstring> rebuilt;
+			rebuilt.reserve(keep);
+			for (size_t i = count - keep; i < count; ++i) {
+				rebuilt.push_back(std::move(at(i)));
+			}
+			slots = std::move(rebuilt);
+			cap = capacity;
+			first += count - keep;
+			head = 0;
+			count = keep;
+		}
+		size_t max_line_length() const {
+			return max_length;
+		}
+		void max_line_length(size_t length) {
+			max_length = length ? length : 1;
+		}
+
+	private:
+		std::vector<std::wstring> slots;
+		size_t cap;
+		size_t max_length;
+		// 没写满时 head 总是 0，新行写在 count 处；写满后 head 指向最早的一行
+		size_t head = 0;
+		size_t count = 0;
+		uint64_t first = 0;
+		uint64_t next_sequence = 0;
+
+		std::wstring& at(size_t index) {
+			return slots[(head + index) % slots.size()];
+		}
+		// 返回下一行要写入的槽位，并更新计数
+		std::wstring& slot() {
+			++next_sequence;
+			if (count < cap) {
+				if (count == slots.size()) slots.emplace_back();
+				return slots[count++];
+			}
+			std::wstring& oldest = slots[head];
+			head = (head + 1) % cap;
+			++first;
+			return oldest;
+		}
+	};
+
+	// 生产者可以在任何线程上 push，界面线程定期 drain 到显示用的 LineRing。
+	// 攒着的行同样有容量上限，消费跟不上时丢弃最早的行，内存不会无限增长。
+	// push 返回 true 表示这是上次 drain 之后的第一行，调用者应安排一次 drain（例如 PostMessage），
+	// 这样无论追加多快，每一批只通知一次
+	class LineBatch {
+	public:
+		explicit LineBatch(size_t capacity = 10000, size_t max_line_length = 4096)
+			: pending(capacity, max_line_length), spare(capacity, max_line_length) {}
+
+		bool push(std::wstring_view line) {
+			std::lock_guard lock(mutex);
+			put(line);
+			return signal();
+		}
+		// 按行拆分后一次加锁全部放入
+		bool push_text(std::wstring_view text) {
+			std::lock_guard lock(mutex);
+			for_each_line(text, [this](std::wstring_view line) { put(line); });
+			return signal();
+		}
+		// 只能由一个线程调用。交换缓冲区后在锁外移动，生产者只会被阻塞一次交换的时间。
+		// 返回移入的行数
+		size_t drain(LineRing& target) {
+			{
+				std::lock_guard lock(mutex);
+				std::swap(pending, spare);
+				signalled = false;
+			}
+			size_t moved = spare.size();
+			target.take_from(spare);
+			return moved;
+		}
+		// 安排 drain 失败时（例如 PostMessage 失败）调用，下一次 push 会重新返回 true
+		void rearm() {
+			std::lock_guard lock(mutex);
+			signalled = false;
+		}
+		size_t size() const {
+			std::lock_guard lock(mutex);
+			return pending.size();
+		}
+		// 从开始到现在因为来不及显示而丢弃的行数
+		uint64_t dropped() const {
+			std::lock_guard lock(mutex);
+			return dropped_lines;
+		}
+		// drain 会同时调整 spare，两边容量一致
+		void capacity(size_t capacity) {
+			std::lock_guard lock(mutex);
+			pending.capacity(capacity);
+			spare.capacity(capacity);
+		}
+		void max_line_length(size_t length) {
+			std::lock_guard lock(mutex);
+			pending.max_line_length(length);
+			spare.max_line_length(length);
+		}
+
+	private:
+		mutable std::mutex mutex;
+		LineRing pending;
+		LineRing spare;
+		bool signalled = false;
+		uint64_t dropped_lines = 0;
+
+		void put(std::wstring_view line) {
+			if (pending.size() == pending.capacity()) ++dropped_lines;
+			pending.push(line);
+		}
+		bool signal() {
+			if (signalled) return false;
+			signalled = true;
+			return true;
+		}
+	};
+}
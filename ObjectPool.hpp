@@ -0,0 +1,84 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 对象池的簿记：哪些对象在用、哪些空闲，以及空闲对象的上限。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译和测试；
+// 新建、重用和放回时对对象做什么由调用者决定，foundation::ControlPool 在这里创建、显示和隐藏控件。
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace w32oop::pool {
+	// 池拥有所有对象，不是线程安全的
+	template <class T>
+	class Recycler {
+	public:
+		explicit Recycler(size_t high_water) : limit(high_water) {}
+		Recycler(const Recycler&) = delete;
+		Recycler& operator=(const Recycler&) = delete;
+
+		// 有空闲对象时取最近放回的一个交给 reuse，否则调用 create 新建（返回 std::unique_ptr<T>）。
+		// create 或 reuse 抛出异常时池不变（reuse 的那个对象被销毁）
+		template <class Create, class Reuse>
+		T& acquire(Create&& create, Reuse&& reuse) {
+			std::unique_ptr<T> item;
+			if (!idle_items.empty()) {
+				item = std::move(idle_items.back());
+				idle_items.pop_back();
+				reuse(*item);
+			}
+			else {
+				item = create();
+			}
+			T& result = *item;
+			busy.emplace(&result, std::move(item));
+			return result;
+		}
+		// 对象不属于这个池（或已经放回）时返回 false。
+		// 空闲对象已达上限时直接销毁，否则交给 park 之后留作空闲
+		template <class Park>
+		bool release(T& item, Park&& park) {
+			auto it = busy.find(&item);
+			if (it == busy.end()) return false;
+			auto owned = std::move(it->second);
+			busy.erase(it);
+			if (idle_items.size() >= limit) return true;
+			park(*owned);
+			idle_items.push_back(std::move(owned));
+			return true;
+		}
+		template <class Park>
+		void release_all(Park&& park) {
+			while (!busy.empty()) release(*busy.begin()->first, park);
+		}
+		// 降低上限时立即销毁多余的空闲对象（先销毁最早放回的）
+		void high_water(size_t high_water) {
+			limit = high_water;
+			if (idle_items.size() > limit) {
+				idle_items.erase(idle_items.begin(), idle_items.end() - static_cast<std::ptrdiff_t>(limit));
+			}
+		}
+		size_t high_water() const {
+			return limit;
+		}
+		size_t idle() const {
+			return idle_items.size();
+		}
+		size_t in_use() const {
+			return busy.size();
+		}
+		bool owns(const T& item) const {
+			return busy.find(const_cast<T*>(&item)) != busy.end();
+		}
+	private:
+		size_t limit;
+		std::vector<std::unique_ptr<T>> idle_items;
+		std::unordered_map<T*, std::unique_ptr<T>> busy;
+	};
+}
@@ -0,0 +1,455 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 片段表（piece table）文本模型，用于编辑框装不下的大文档。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译、测试和做基准测试；
+// foundation::TextView 只负责绘制和滚动。
+//
+// 文档是一串片段，每个片段指向原始文本（通常是映射进内存的文件，不复制）
+// 或追加缓冲区中的一段。追加缓冲区分块分配，写过的内容不再移动也不再修改。
+// 片段保存在持久化的 treap 中：节点创建后不再修改，修改只复制从根到修改处的路径，
+// 所以插入、删除、按位置和按行定位都是期望 O(log n)，取快照是 O(1)，
+// 旧的快照在修改之后仍然有效，可以交给其他线程读取，也可以用来撤销。
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace w32oop::text {
+	template <class Unit>
+	class BasicPieceTable {
+	public:
+		using string_view_type = std::basic_string_view<Unit>;
+		using string_type = std::basic_string<Unit>;
+		static constexpr Unit line_feed = Unit('\n');
+		static constexpr Unit carriage_return = Unit('\r');
+		// 片段和追加缓冲区每块的最大长度。在片段中间拆开时要数前半段的换行，
+		// 限制片段长度就限制了这一步的开销
+		static constexpr size_t max_piece = 64 * 1024;
+
+	private:
+		struct Node;
+		using Ptr = std::shared_ptr<const Node>;
+		struct Node {
+			const Unit* data;
+			size_t length;
+			size_t line_feeds;
+			// 追加缓冲区的块；原始文本的片段为空，由调用者保证原始文本的生命周期
+			std::shared_ptr<const void> owner;
+			uint32_t priority;
+			Ptr left, right;
+			// 整棵子树的长度和换行数
+			size_t total_length;
+			size_t total_line_feeds;
+		};
+
+		static size_t length_of(const Ptr& t) {
+			return t ? t->total_length : 0;
+		}
+		static size_t line_feeds_of(const Ptr& t) {
+			return t ? t->total_line_feeds : 0;
+		}
+		static size_t count_line_feeds(const Unit* data, size_t length) {
+			return (size_t)std::count(data, data + length, line_feed);
+		}
+		static Ptr make(const Unit* data, size_t length, size_t line_feeds, std::shared_ptr<const void> owner,
+			uint32_t priority, Ptr left, Ptr right) {
+			auto node = std::make_shared<Node>();
+			node->total_length = length + length_of(left) + length_of(right);
+			node->total_line_feeds = line_feeds + line_feeds_of(left) + line_feeds_of(right);
+			node->data = data;
+			node->length = length;
+			node->line_feeds = line_feeds;
+			node->owner = std::move(owner);
+			node->priority = priority;
+			node->left = std::move(left);
+			node->right = std::move(right);
+			return node;
+		}
+		// 同一个片段，换上新的子树
+		static Ptr with(const Ptr& t, Ptr left, Ptr right) {
+			return make(t->data, t->length, t->line_feeds, t->owner, t->priority, std::move(left), std::move(right));
+		}
+		// 拆成前 pos 个单元和其余部分
+		static std::pair<Ptr, Ptr> split(const Ptr& t, size_t pos) {
+			if (!t || pos == 0) return { nullptr, t };
+			if (pos >= t->total_length) return { t, nullptr };
+			size_t left_length = length_of(t->left);
+			if (pos <= left_length) {
+				auto [a, b] = split(t->left, pos);
+				return { std::move(a), with(t, std::move(b), t->right) };
+			}
+			pos -= left_length;
+			if (pos >= t->length) {
+				auto [a, b] = split(t->right, pos - t->length);
+				return { with(t, t->left, std::move(a)), std::move(b) };
+			}
+			// 位置落在这个片段中间：拆成两个片段，各自作为一边的根，堆序不变
+			size_t head_line_feeds = count_line_feeds(t->data, pos);
+			return {
+				make(t->data, pos, head_line_feeds, t->owner, t->priority, t->left, nullptr),
+				make(t->data + pos, t->length - pos, t->line_feeds - head_line_feeds, t->owner, t->priority, nullptr, t->right),
+			};
+		}
+		static Ptr merge(const Ptr& a, const Ptr& b) {
+			if (!a) return b;
+			if (!b) return a;
+			if (a->priority >= b->priority) return with(a, a->left, merge(a->right, b));
+			return with(b, merge(a, b->left), b->right);
+		}
+
+	public:
+		// 只读的快照，复制的开销是一个 shared_ptr。可以在任何线程上读取
+		class Snapshot {
+		public:
+			Snapshot() = default;
+
+			size_t size() const {
+				return length_of(root);
+			}
+			bool empty() const {
+				return !root;
+			}
+			// 按 '\n' 分行，最后一个换行之后还有一行（可能为空），所以至少有一行
+			size_t line_count() const {
+				return line_feeds_of(root) + 1;
+			}
+			// 第 line 行第一个单元的位置；超出范围时返回 size()
+			size_t line_start(size_t line) const {
+				if (line == 0) return 0;
+				if (line >= line_count()) return size();
+				// 找第 line 个换行
+				size_t offset = 0;
+				const Node* t = root.get();
+				while (t) {
+					size_t left_line_feeds = line_feeds_of(t->left);
+					if (line <= left_line_feeds) {
+						t = t->left.get();
+						continue;
+					}
+					line -= left_line_feeds;
+					offset += length_of(t->left);
+					if (line <= t->line_feeds) {
+						const Unit* p = t->data;
+						for (;; ++p) {
+							if (*p == line_feed && --line == 0) return offset + (p - t->data) + 1;
+						}
+					}
+					line -= t->line_feeds;
+					offset += t->length;
+					t = t->right.get();
+				}
+				return size();
+			}
+			// pos 所在的行
+			size_t line_of(size_t pos) const {
+				if (pos >= size()) return line_count() - 1;
+				size_t line = 0;
+				const Node* t = root.get();
+				while (t) {
+					size_t left_length = length_of(t->left);
+					if (pos < left_length) {
+						t = t->left.get();
+						continue;
+					}
+					pos -= left_length;
+					line += line_feeds_of(t->left);
+					if (pos < t->length) return line + count_line_feeds(t->data, pos);
+					pos -= t->length;
+					line += t->line_feeds;
+					t = t->right.get();
+				}
+				return line;
+			}
+			Unit at(size_t pos) const {
+				const Node* t = root.get();
+				while (t) {
+					size_t left_length = length_of(t->left);
+					if (pos < left_length) {
+						t = t->left.get();
+						continue;
+					}
+					pos -= left_length;
+					if (pos < t->length) return t->data[pos];
+					pos -= t->length;
+					t = t->right.get();
+				}
+				return Unit();
+			}
+			// 按顺序访问 [pos, pos + count) 覆盖的每一段连续内存，不复制
+			template <class F>
+			void for_each_piece(size_t pos, size_t count, F&& f) const {
+				size_t end = count > size() - (std::min)(pos, size()) ? size() : pos + count;
+				visit(root.get(), 0, pos, end, [&](string_view_type piece) {
+					f(piece);
+					return true;
+				});
+			}
+			// 复制到 out，返回复制的单元数
+			size_t copy(size_t pos, size_t count, Unit* out) const {
+				size_t written = 0;
+				for_each_piece(pos, count, [&](string_view_type piece) {
+					std::copy(piece.begin(), piece.end(), out + written);
+					written += piece.size();
+				});
+				return written;
+			}
+			string_type substr(size_t pos = 0, size_t count = string_type::npos) const {
+				string_type result;
+				if (pos >= size()) return result;
+				result.resize((std::min)(count, size() - pos));
+				result.resize(copy(pos, result.size(), result.data()));
+				return result;
+			}
+			// 从第 first 行开始依次交出 count 行，不含换行和行尾的 '\r'。
+			// 超过 max_length 的行被截断，只有跨片段的行才需要复制
+			template <class F>
+			void for_each_line(size_t first, size_t count, size_t max_length, F&& f) const {
+				if (!count || first >= line_count()) return;
+				string_type scratch;
+				size_t units = 0; // 跨片段的行的实际长度，scratch 里最多保留 max_length + 1 个
+				size_t emitted = 0;
+				auto emit = [&](string_view_type line, size_t full_length) {
+					if (line.size() == full_length && !line.empty() && line.back() == carriage_return) {
+						line.remove_suffix(1);
+					}
+					f(line.substr(0, max_length));
+					return ++emitted < count;
+				};
+				auto keep = [&](string_view_type part) {
+					size_t room = max_length == string_type::npos ? part.size() : max_length + 1 - (std::min)(scratch.size(), max_length + 1);
+					scratch.append(part.substr(0, room));
+					units += part.size();
+				};
+				size_t begin = line_start(first);
+				bool more = visit(root.get(), 0, begin, size(), [&](string_view_type piece) {
+					while (true) {
+						size_t stop = piece.find(line_feed);
+						if (stop == string_view_type::npos) {
+							keep(piece);
+							return true;
+						}
+						if (!units) {
+							if (!emit(piece.substr(0, stop), stop)) return false;
+						}
+						else {
+							keep(piece.substr(0, stop));
+							bool go_on = emit(scratch, units);
+							scratch.clear();
+							units = 0;
+							if (!go_on) return false;
+						}
+						piece.remove_prefix(stop + 1);
+					}
+				});
+				// 最后一行后面没有换行
+				if (more) emit(scratch, units);
+			}
+			// 第 index 行，不含换行；超出范围时为空
+			string_type line(size_t index, size_t max_length = string_type::npos) const {
+				string_type result;
+				for_each_line(index, 1, max_length, [&](string_view_type text) { result.assign(text); });
+				return result;
+			}
+
+		private:
+			friend class BasicPieceTable;
+			Ptr root;
+
+			explicit Snapshot(Ptr tree) : root(std::move(tree)) {}
+
+			// 只进入和 [from, to) 相交的子树；f 返回 false 时停止，整个函数也返回 false
+			template <class F>
+			static bool visit(const Node* t, size_t offset, size_t from, size_t to, F&& f) {
+				if (!t || from >= to) return true;
+				size_t start = offset + length_of(t->left), stop = start + t->length;
+				if (from < start && !visit(t->left.get(), offset, from, to, f)) return false;
+				if (from < stop && to > start) {
+					size_t a = (std::max)(from, start), b = (std::min)(to, stop);
+					if (!f(string_view_type(t->data + (a - start), b - a))) return false;
+				}
+				if (to > stop) return visit(t->right.get(), stop, from, to, f);
+				return true;
+			}
+		};
+
+		BasicPieceTable() = default;
+		// 原始文本不会被复制，必须比这个对象和它的所有快照活得更久。
+		// 构造时需要数一遍换行，是对原始文本唯一的一次完整扫描
+		explicit BasicPieceTable(string_view_type original) {
+			std::vector<Piece> pieces;
+			pieces.reserve(original.size() / max_piece + 1);
+			for (size_t pos = 0; pos < original.size(); pos += max_piece) {
+				size_t length = (std::min)(max_piece, original.size() - pos);
+				pieces.push_back({ original.data() + pos, length, count_line_feeds(original.data() + pos, length) });
+			}
+			current = Snapshot(build(pieces, 0, pieces.size(), 0, depth_of(pieces.size())));
+		}
+
+		Snapshot snapshot() const {
+			return current;
+		}
+		// 回到之前的某个快照，用于撤销
+		void restore(const Snapshot& snapshot) {
+			current = snapshot;
+			typing_end = no_typing;
+		}
+		void clear() {
+			restore(Snapshot());
+		}
+
+		size_t size() const {
+			return current.size();
+		}
+		bool empty() const {
+			return current.empty();
+		}
+		size_t line_count() const {
+			return current.line_count();
+		}
+		size_t line_start(size_t line) const {
+			return current.line_start(line);
+		}
+		size_t line_of(size_t pos) const {
+			return current.line_of(pos);
+		}
+		string_type substr(size_t pos = 0, size_t count = string_type::npos) const {
+			return current.substr(pos, count);
+		}
+		string_type line(size_t index, size_t max_length = string_type::npos) const {
+			return current.line(index, max_length);
+		}
+
+		// pos 超出末尾时追加到末尾
+		void insert(size_t pos, string_view_type text) {
+			if (text.empty()) return;
+			pos = (std::min)(pos, size());
+			// 连续输入：接在上一次插入的后面，并且追加缓冲区也是接着写的，就直接加长上一个片段
+			if (pos == typing_end && block_used < max_piece && text.size() <= max_piece - block_used
+				&& grow_last_piece(pos, text)) return;
+			auto [left, right] = split(current.root, pos);
+			Ptr middle;
+			const Unit* last_end = nullptr;
+			size_t last_length = 0;
+			while (!text.empty()) {
+				if (!block || block_used == max_piece) {
+					block = std::shared_ptr<Unit[]>(new Unit[max_piece]);
+					block_used = 0;
+				}
+				size_t take = (std::min)(text.size(), max_piece - block_used);
+				Unit* data = block.get() + block_used;
+				std::copy(text.begin(), text.begin() + take, data);
+				block_used += take;
+				text.remove_prefix(take);
+				middle = merge(middle, make(data, take, count_line_feeds(data, take), block, next_priority(), nullptr, nullptr));
+				last_end = data + take;
+				last_length = take;
+			}
+			current.root = merge(merge(left, middle), right);
+			typing_end = pos + length_of(middle);
+			typing_data = last_end;
+			typing_length = last_length;
+		}
+		// 删除 [pos, pos + count)，超出末尾的部分忽略
+		void erase(size_t pos, size_t count) {
+			if (pos >= size() || !count) return;
+			count = (std::min)(count, size() - pos);
+			auto [left, rest] = split(current.root, pos);
+			auto [removed, right] = split(rest, count);
+			current.root = merge(left, right);
+			typing_end = no_typing;
+		}
+		void replace(size_t pos, size_t count, string_view_type text) {
+			erase(pos, count);
+			insert(pos, text);
+		}
+		void append(string_view_type text) {
+			insert(size(), text);
+		}
+
+		// 片段数，用于观察碎片化程度
+		size_t pieces() const {
+			return count_nodes(current.root.get());
+		}
+
+	private:
+		struct Piece {
+			const Unit* data;
+			size_t length;
+			size_t line_feeds;
+		};
+		static constexpr size_t no_typing = ~size_t(0);
+
+		Snapshot current;
+		std::shared_ptr<Unit[]> block;
+		size_t block_used = 0;
+		// 上一次插入结束的位置、最后一个片段的结尾和长度；其他修改之后失效
+		size_t typing_end = no_typing;
+		const Unit* typing_data = nullptr;
+		size_t typing_length = 0;
+		uint64_t seed = 0x9E3779B97F4A7C15ull;
+
+		uint32_t next_priority() {
+			// xorshift64*，只用来让 treap 保持平衡
+			seed ^= seed >> 12;
+			seed ^= seed << 25;
+			seed ^= seed >> 27;
+			return (uint32_t)((seed * 0x2545F4914F6CDD1Dull) >> 32);
+		}
+		bool grow_last_piece(size_t pos, string_view_type text) {
+			// 上一个片段必须刚好结束在追加缓冲区当前的末尾，而且长度还没有达到上限
+			if (typing_data != block.get() + block_used || typing_length + text.size() > max_piece) return false;
+			auto [left, right] = split(current.root, pos);
+			auto [before, last] = split(left, pos - typing_length);
+			if (!last || last->left || last->right || last->data + last->length != typing_data) {
+				// 片段已经被拆开或换掉了，按一般情况处理
+				typing_end = no_typing;
+				return false;
+			}
+			Unit* data = block.get() + block_used;
+			std::copy(text.begin(), text.end(), data);
+			block_used += text.size();
+			Ptr grown = make(last->data, last->length + text.size(), last->line_feeds + count_line_feeds(data, text.size()),
+				last->owner, last->priority, nullptr, nullptr);
+			current.root = merge(merge(before, grown), right);
+			typing_end = pos + text.size();
+			typing_data = data + text.size();
+			typing_length = grown->length;
+			return true;
+		}
+		static size_t depth_of(size_t count) {
+			size_t depth = 0;
+			while (count) {
+				++depth;
+				count >>= 1;
+			}
+			return depth;
+		}
+		// 从有序的片段直接建成平衡的树，O(n)。越靠近根的节点优先级所在的区间越高，
+		// 保证堆序；之后插入的节点取整个范围内的随机优先级
+		Ptr build(const std::vector<Piece>& pieces, size_t first, size_t last, size_t depth, size_t levels) {
+			if (first >= last) return nullptr;
+			size_t middle = first + (last - first) / 2;
+			Ptr left = build(pieces, first, middle, depth + 1, levels);
+			Ptr right = build(pieces, middle + 1, last, depth + 1, levels);
+			uint32_t band = (uint32_t)(0xFFFFFFFFull / (levels + 1));
+			uint32_t priority = (uint32_t)((levels - depth) * band + next_priority() % band);
+			const Piece& piece = pieces[middle];
+			return make(piece.data, piece.length, piece.line_feeds, nullptr, priority, std::move(left), std::move(right));
+		}
+		static size_t count_nodes(const Node* t) {
+			return t ? 1 + count_nodes(t->left.get()) + count_nodes(t->right.get()) : 0;
+		}
+	};
+
+	using PieceTable = BasicPieceTable<char>;
+	using WPieceTable = BasicPieceTable<wchar_t>;
+}
@@ -0,0 +1,326 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 会话日志：只追加的编辑记录，用于崩溃后恢复未保存的文本。
+// 这个头文件不依赖 <windows.h>，因此可以脱离 Win32 单独编译、测试（包括模拟写到一半崩溃）；
+// 文件的打开、追加和原子替换由调用者完成。
+//
+// 文件格式（整数都是小端序）：
+//   文件头  "W32J" + u32 版本
+//   记录    u32 负载长度 + u32 负载的 CRC-32 + 负载
+//   负载    u8 类型，后面的内容由类型决定：
+//     Snapshot  u32 路径长度 + 路径 + u64 文本长度 + 文本（都是 UTF-16 单元），丢弃之前的所有状态
+//     Replace   u64 位置 + u64 删除的单元数 + u64 插入的单元数 + 插入的文本
+//     Path      u32 路径长度 + 路径
+// 回放时遇到不完整或校验失败的记录就停止，结果是最后一条完整记录之后的状态。
+#include <cstdint>
+#include <cstddef>
+#include <cwchar>
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace w32oop::journal {
+	inline constexpr uint32_t version = 1;
+	inline constexpr size_t header_size = 8;
+
+	enum class RecordType : uint8_t {
+		Snapshot = 1,
+		Replace = 2,
+		Path = 3,
+	};
+
+	namespace detail {
+		inline constexpr std::array<uint32_t, 256> crc_table = [] {
+			std::array<uint32_t, 256> table{};
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+			return table;
+		}();
+
+		inline void put_u32(std::string& out, uint32_t value) {
+			for (int i = 0; i < 4; ++i) out.push_back(char((value >> (8 * i)) & 0xFF));
+		}
+		inline void put_u64(std::string& out, uint64_t value) {
+			for (int i = 0; i < 8; ++i) out.push_back(char((value >> (8 * i)) & 0xFF));
+		}
+		inline void put_units(std::string& out, std::u16string_view text) {
+			size_t at = out.size();
+			out.resize(at + text.size() * 2);
+			for (char16_t unit : text) {
+				out[at++] = char(unit & 0xFF);
+				out[at++] = char(unit >> 8);
+			}
+		}
+
+		// 按顺序读取负载，越界后 ok 变为 false，之后的读取都返回 0
+		class Reader {
+		public:
+			explicit Reader(std::string_view bytes) : data(bytes) {}
+			bool ok = true;
+			uint64_t get(int size) {
+				if (!ok || data.size() - pos < (size_t)size) return fail();
+				uint64_t value = 0;
+				for (int i = 0; i < size; ++i) value |= uint64_t((unsigned char)data[pos + i]) << (8 * i);
+				pos += size;
+				return value;
+			}
+			void units(std::u16string& out, uint64_t count) {
+				if (!ok || (data.size() - pos) / 2 < count) {
+					fail();
+					return;
+				}
+				out.resize((size_t)count);
+				for (size_t i = 0; i < count; ++i, pos += 2) {
+					out[i] = char16_t((unsigned char)data[pos] | ((unsigned char)data[pos + 1] << 8));
+				}
+			}
+			bool at_end() const {
+				return ok && pos == data.size();
+			}
+		private:
+			std::string_view data;
+			size_t pos = 0;
+			uint64_t fail() {
+				ok = false;
+				return 0;
+			}
+		};
+	}
+
+	inline uint32_t crc32(std::string_view bytes, uint32_t crc = 0) {
+		crc = ~crc;
+		for (char c : bytes) crc = detail::crc_table[(crc ^ (unsigned char)c) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	struct Document {
+		std::u16string path;
+		std::u16string text;
+	};
+
+	// 把 before 变成 after 的一次替换
+	struct Change {
+		size_t offset = 0;
+		size_t removed = 0;
+		std::u16string_view inserted;
+		bool empty() const {
+			return removed == 0 && inserted.empty();
+		}
+	};
+
+	// 去掉公共前缀和公共后缀，剩下的部分就是替换的范围。
+	// 两次自动保存之间的编辑通常集中在一处，记录的大小与编辑量成正比，而不是与文档大小成正比
+	inline Change diff(std::u16string_view before, std::u16string_view after) {
+		size_t limit = before.size() < after.size() ? before.size() : after.size();
+		size_t prefix = 0;
+		while (prefix < limit && before[prefix] == after[prefix]) ++prefix;
+		size_t suffix = 0;
+		limit -= prefix;
+		while (suffix < limit && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) ++suffix;
+		Change change;
+		change.offset = prefix;
+		change.removed = before.size() - prefix - suffix;
+		change.inserted = after.substr(prefix, after.size() - prefix - suffix);
+		return change;
+	}
+
+	inline void write_header(std::string& out) {
+		out.append("W32J", 4);
+		detail::put_u32(out, version);
+	}
+
+	namespace detail {
+		// 先占位，写完负载后回填长度和校验和
+		inline size_t begin_record(std::string& out, RecordType type) {
+			size_t at = out.size();
+			put_u32(out, 0);
+			put_u32(out, 0);
+			out.push_back(char(type));
+			return at;
+		}
+		inline void end_record(std::string& out, size_t at) {
+			std::string_view payload(out.data() + at + 8, out.size() - at - 8);
+			uint32_t length = (uint32_t)payload.size(), crc = crc32(payload);
+			for (int i = 0; i < 4; ++i) {
+				out[at + i] = char((length >> (8 * i)) & 0xFF);
+				out[at + 4 + i] = char((crc >> (8 * i)) & 0xFF);
+			}
+		}
+	}
+
+	inline void write_snapshot(std::string& out, std::u16string_view path, std::u16string_view text) {
+		size_t at = detail::begin_record(out, RecordType::Snapshot);
+		detail::put_u32(out, (uint32_t)path.size());
+		detail::put_units(out, path);
+		detail::put_u64(out, text.size());
+		detail::put_units(out, text);
+		detail::end_record(out, at);
+	}
+	inline void write_change(std::string& out, const Change& change) {
+		size_t at = detail::begin_record(out, RecordType::Replace);
+		detail::put_u64(out, change.offset);
+		detail::put_u64(out, change.removed);
+		detail::put_u64(out, change.inserted.size());
+		detail::put_units(out, change.inserted);
+		detail::end_record(out, at);
+	}
+	inline void write_path(std::string& out, std::u16string_view path) {
+		size_t at = detail::begin_record(out, RecordType::Path);
+		detail::put_u32(out, (uint32_t)path.size());
+		detail::put_units(out, path);
+		detail::end_record(out, at);
+	}
+
+	struct ReplayResult {
+		Document document;
+		// 文件头和完整记录的总长度，继续追加之前应当把文件截断到这里
+		size_t valid_bytes = 0;
+		size_t records = 0;
+		bool has_snapshot = false;
+		// 末尾有不完整、校验失败或无法应用的记录
+		bool truncated = false;
+	};
+
+	// 回放整个日志。文件头不对时 has_snapshot 为 false
+	inline ReplayResult replay(std::string_view bytes) {
+		ReplayResult result;
+		if (bytes.size() < header_size || bytes.substr(0, 4) != "W32J") {
+			result.truncated = !bytes.empty();
+			return result;
+		}
+		detail::Reader header(bytes.substr(4, 4));
+		if (header.get(4) != version) {
+			result.truncated = true;
+			return result;
+		}
+		size_t pos = header_size;
+		result.valid_bytes = pos;
+		Document& doc = result.document;
+		while (pos < bytes.size()) {
+			detail::Reader frame(bytes.substr(pos, 8));
+			uint64_t length = frame.get(4);
+			uint32_t crc = (uint32_t)frame.get(4);
+			if (!frame.ok || bytes.size() - pos - 8 < length || length == 0) break;
+			std::string_view payload = bytes.substr(pos + 8, (size_t)length);
+			if (crc32(payload) != crc) break;
+			detail::Reader in(payload);
+			auto type = RecordType(in.get(1));
+			bool applied = false;
+			if (type == RecordType::Snapshot) {
+				std::u16string path, text;
+				in.units(path, in.get(4));
+				in.units(text, in.get(8));
+				if (in.at_end()) {
+					doc.path = std::move(path);
+					doc.text = std::move(text);
+					result.has_snapshot = applied = true;
+				}
+			}
+			else if (type == RecordType::Replace) {
+				uint64_t offset = in.get(8), removed = in.get(8);
+				std::u16string inserted;
+				in.units(inserted, in.get(8));
+				// 替换之前必须有快照，并且范围在文本之内
+				if (in.at_end() && result.has_snapshot && offset <= doc.text.size() && removed <= doc.text.size() - offset) {
+					doc.text.replace((size_t)offset, (size_t)removed, inserted);
+					applied = true;
+				}
+			}
+			else if (type == RecordType::Path) {
+				std::u16string path;
+				in.units(path, in.get(4));
+				if (in.at_end() && result.has_snapshot) {
+					doc.path = std::move(path);
+					applied = true;
+				}
+			}
+			if (!applied) break;
+			pos += 8 + (size_t)length;
+			result.valid_bytes = pos;
+			++result.records;
+		}
+		result.truncated = result.valid_bytes != bytes.size();
+		return result;
+	}
+
+	// 写入端：保存上一次记录时的文档副本，每次只把差异编码成记录。
+	// 返回的字节由调用者追加到日志文件；日志相对文档过大时调用 compact 重写成一个快照
+	class Journal {
+	public:
+		// 日志超过 compact_ratio 倍的快照大小并且至少有 min_compact_bytes 时建议压缩
+		explicit Journal(size_t min_compact_bytes = 1 << 20, size_t compact_ratio = 2)
+			: min_compact(min_compact_bytes), ratio(compact_ratio) {}
+
+		// 新日志或压缩：文件头加一个快照，调用者用它替换整个文件
+		std::string_view compact(std::u16string_view path, std::u16string_view text) {
+			buffer.clear();
+			write_header(buffer);
+			write_snapshot(buffer, path, text);
+			shadow.path.assign(path);
+			shadow.text.assign(text);
+			snapshot_bytes = bytes = buffer.size();
+			return buffer;
+		}
+		// 返回需要追加的字节，没有变化时为空
+		std::string_view record(std::u16string_view path, std::u16string_view text) {
+			buffer.clear();
+			if (path != shadow.path) {
+				write_path(buffer, path);
+				shadow.path.assign(path);
+			}
+			Change change = diff(shadow.text, text);
+			if (!change.empty()) {
+				write_change(buffer, change);
+				shadow.text.replace(change.offset, change.removed, change.inserted);
+			}
+			bytes += buffer.size();
+			return buffer;
+		}
+		// 从回放结果继续，file_bytes 为截断后的文件长度
+		void resume(Document document, size_t file_bytes) {
+			shadow = std::move(document);
+			bytes = file_bytes;
+			snapshot_bytes = header_size + 8 + 1 + 4 + 8 + (shadow.path.size() + shadow.text.size()) * 2;
+		}
+		bool should_compact() const {
+			return bytes >= min_compact && bytes > snapshot_bytes * ratio;
+		}
+		// 日志文件当前的长度
+		size_t size() const {
+			return bytes;
+		}
+		const Document& document() const {
+			return shadow;
+		}
+
+#if WCHAR_MAX == 0xFFFF
+		// Windows 上 wchar_t 就是 UTF-16
+		std::string_view compact(std::wstring_view path, std::wstring_view text) {
+			return compact(units(path), units(text));
+		}
+		std::string_view record(std::wstring_view path, std::wstring_view text) {
+			return record(units(path), units(text));
+		}
+	private:
+		static std::u16string_view units(std::wstring_view text) {
+			return std::u16string_view(reinterpret_cast<const char16_t*>(text.data()), text.size());
+		}
+#endif
+
+	private:
+		Document shadow;
+		std::string buffer;
+		size_t bytes = 0;
+		size_t snapshot_bytes = 0;
+		size_t min_compact;
+		size_t ratio;
+	};
+}
@@ -0,0 +1,553 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// UTF-8 与 UTF-16 互相转换。
+// 与 HotKeyTable.hpp 一样不依赖 <windows.h>，可以脱离 Win32 单独编译、测试和做基准测试。
+// 连续的 ASCII 用 SIMD（AVX2 / SSE2 / NEON，都没有时按 8 字节一组）整段处理，其他字符逐个编解码。
+// 定义 W32OOP_UTF_NO_SIMD 时只用标量代码，测试用它与 SIMD 版本对照。
+// 非法输入按 Unicode 推荐的做法处理：每个最长的非法子序列替换成一个 U+FFFD，
+// 与 MultiByteToWideChar / WideCharToMultiByte 不带 MB_ERR_INVALID_CHARS 时的结果一致。
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cwchar>
+#include <bit>
+#include <string>
+#include <string_view>
+
+#if !defined(W32OOP_UTF_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define W32OOP_UTF_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define W32OOP_UTF_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define W32OOP_UTF_NEON 1
+#endif
+#endif
+
+namespace w32oop::utf {
+	inline constexpr char32_t replacement = 0xFFFD;
+
+	struct Result {
+		size_t read = 0;     // 消耗的输入单元数
+		size_t written = 0;  // 写出的输出单元数
+		size_t invalid = 0;  // 替换成 U+FFFD 的非法序列个数
+	};
+
+	namespace detail {
+		inline constexpr bool little_endian = std::endian::native == std::endian::little;
+
+		// 开头连续 ASCII 字节的个数
+		inline size_t ascii_prefix(const unsigned char* s, size_t n) {
+			size_t i = 0;
+#if W32OOP_UTF_AVX2
+			for (; i + 32 <= n; i += 32) {
+				unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(s + i)));
+				if (mask) return i + std::countr_zero(mask);
+			}
+#endif
+#if W32OOP_UTF_SSE2
+			for (; i + 16 <= n; i += 16) {
+				unsigned mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+				if (mask) return i + std::countr_zero(mask);
+			}
+#elif W32OOP_UTF_NEON
+			for (; i + 16 <= n; i += 16) {
+				if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80) break;
+			}
+#endif
+			if constexpr (little_endian) {
+				for (; i + 8 <= n; i += 8) {
+					uint64_t word;
+					std::memcpy(&word, s + i, 8);
+					word &= 0x8080808080808080ull;
+					if (word) return i + std::countr_zero(word) / 8;
+				}
+			}
+			for (; i < n; ++i) {
+				if (s[i] >= 0x80) return i;
+			}
+			return n;
+		}
+
+		// 开头连续 ASCII 单元的个数
+		inline size_t ascii_prefix(const char16_t* s, size_t n) {
+			size_t i = 0;
+#if W32OOP_UTF_SSE2
+			const __m128i high = _mm_set1_epi16((short)0xFF80);
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 8 <= n; i += 8) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+				unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high), zero));
+				if (mask != 0xFFFF) return i + std::countr_zero(~mask) / 2;
+			}
+#elif W32OOP_UTF_NEON
+			for (; i + 8 <= n; i += 8) {
+				if (vmaxvq_u16(vld1q_u16((const uint16_t*)(s + i))) >= 0x80) break;
+			}
+#endif
+			if constexpr (little_endian) {
+				for (; i + 4 <= n; i += 4) {
+					uint64_t word;
+					std::memcpy(&word, s + i, 8);
+					word &= 0xFF80FF80FF80FF80ull;
+					if (word) return i + std::countr_zero(word) / 16;
+				}
+			}
+			for (; i < n; ++i) {
+				if (s[i] >= 0x80) return i;
+			}
+			return n;
+		}
+
+		// ASCII 字节 -> UTF-16 单元
+		inline void widen_ascii(const unsigned char* in, size_t n, char16_t* out) {
+			size_t i = 0;
+#if W32OOP_UTF_AVX2
+			for (; i + 16 <= n; i += 16) {
+				__m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in + i)));
+				_mm256_storeu_si256((__m256i*)(out + i), v);
+			}
+#elif W32OOP_UTF_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= n; i += 16) {
+				__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpackhi_epi8(v, zero));
+			}
+#elif W32OOP_UTF_NEON
+			for (; i + 16 <= n; i += 16) {
+				uint8x16_t v = vld1q_u8(in + i);
+				vst1q_u16((uint16_t*)(out + i), vmovl_u8(vget_low_u8(v)));
+				vst1q_u16((uint16_t*)(out + i + 8), vmovl_high_u8(v));
+			}
+#endif
+			for (; i < n; ++i) out[i] = in[i];
+		}
+
+		// ASCII 单元 -> 字节
+		inline void narrow_ascii(const char16_t* in, size_t n, unsigned char* out) {
+			size_t i = 0;
+#if W32OOP_UTF_SSE2
+			for (; i + 16 <= n; i += 16) {
+				__m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+				__m128i b = _mm_loadu_si128((const __m128i*)(in + i + 8));
+				_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(a, b));
+			}
+#elif W32OOP_UTF_NEON
+			for (; i + 16 <= n; i += 16) {
+				uint16x8_t a = vld1q_u16((const uint16_t*)(in + i));
+				uint16x8_t b = vld1q_u16((const uint16_t*)(in + i + 8));
+				vst1q_u8(out + i, vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+			}
+#endif
+			for (; i < n; ++i) out[i] = (unsigned char)in[i];
+		}
+
+		// 解码从 s[0]（非 ASCII）开始的一个序列。
+		// 合法时返回序列长度；非法时返回最长非法子序列的长度（至少 1），cp 为 U+FFFD。
+		// 输入在一个合法前缀的中间结束时 truncated 为 true
+		inline size_t decode(const unsigned char* s, size_t n, char32_t& cp, bool& valid, bool& truncated) {
+			unsigned char b0 = s[0];
+			unsigned char lo = 0x80, hi = 0xBF;
+			size_t length;
+			valid = false;
+			truncated = false;
+			cp = replacement;
+			if (b0 >= 0xC2 && b0 <= 0xDF) {
+				length = 2;
+			}
+			else if (b0 >= 0xE0 && b0 <= 0xEF) {
+				length = 3;
+				if (b0 == 0xE0) lo = 0xA0;
+				else if (b0 == 0xED) hi = 0x9F;  // 代理区
+			}
+			else if (b0 >= 0xF0 && b0 <= 0xF4) {
+				length = 4;
+				if (b0 == 0xF0) lo = 0x90;
+				else if (b0 == 0xF4) hi = 0x8F;  // 超过 U+10FFFF
+			}
+			else {
+				return 1;
+			}
+			char32_t value = b0 & (0x7F >> length);
+			for (size_t k = 1; k < length; ++k) {
+				if (k >= n) {
+					truncated = true;
+					return k;
+				}
+				unsigned char b = s[k];
+				if (b < lo || b > hi) return k;
+				lo = 0x80;
+				hi = 0xBF;
+				value = (value << 6) | (b & 0x3F);
+			}
+			valid = true;
+			cp = value;
+			return length;
+		}
+
+		// final 为 false 时，末尾不完整的合法前缀不转换，留给下一块
+		template <bool Write>
+		inline Result utf8_to_utf16(const unsigned char* in, size_t n, char16_t* out, bool final) {
+			Result result;
+			size_t i = 0, o = 0;
+			while (i < n) {
+				if (in[i] < 0x80) {
+					size_t run = ascii_prefix(in + i, n - i);
+					if constexpr (Write) widen_ascii(in + i, run, out + o);
+					i += run;
+					o += run;
+					continue;
+				}
+				char32_t cp;
+				bool valid, truncated;
+				size_t used = decode(in + i, n - i, cp, valid, truncated);
+				if (truncated && !final) break;
+				if (!valid) ++result.invalid;
+				if (cp >= 0x10000) {
+					if constexpr (Write) {
+						out[o] = char16_t(0xD800 + ((cp - 0x10000) >> 10));
+						out[o + 1] = char16_t(0xDC00 + (cp & 0x3FF));
+					}
+					o += 2;
+				}
+				else {
+					if constexpr (Write) out[o] = char16_t(cp);
+					++o;
+				}
+				i += used;
+			}
+			result.read = i;
+			result.written = o;
+			return result;
+		}
+
+		// final 为 false 时，末尾落单的高代理不转换，留给下一块
+		template <bool Write>
+		inline Result utf16_to_utf8(const char16_t* in, size_t n, unsigned char* out, bool final) {
+			Result result;
+			size_t i = 0, o = 0;
+			while (i < n) {
+				char16_t u = in[i];
+				if (u < 0x80) {
+					size_t run = ascii_prefix(in + i, n - i);
+					if constexpr (Write) narrow_ascii(in + i, run, out + o);
+					i += run;
+					o += run;
+					continue;
+				}
+				char32_t cp = u;
+				size_t used = 1;
+				if (u >= 0xD800 && u <= 0xDFFF) {
+					if (u <= 0xDBFF && i + 1 < n && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF) {
+						cp = 0x10000 + ((char32_t(u) - 0xD800) << 10) + (char32_t(in[i + 1]) - 0xDC00);
+						used = 2;
+					}
+					else if (u <= 0xDBFF && i + 1 == n && !final) {
+						break;
+					}
+					else {
+						cp = replacement;
+						++result.invalid;
+					}
+				}
+				if (cp < 0x800) {
+					if constexpr (Write) {
+						out[o] = (unsigned char)(0xC0 | (cp >> 6));
+						out[o + 1] = (unsigned char)(0x80 | (cp & 0x3F));
+					}
+					o += 2;
+				}
+				else if (cp < 0x10000) {
+					if constexpr (Write) {
+						out[o] = (unsigned char)(0xE0 | (cp >> 12));
+						out[o + 1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+						out[o + 2] = (unsigned char)(0x80 | (cp & 0x3F));
+					}
+					o += 3;
+				}
+				else {
+					if constexpr (Write) {
+						out[o] = (unsigned char)(0xF0 | (cp >> 18));
+						out[o + 1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+						out[o + 2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+						out[o + 3] = (unsigned char)(0x80 | (cp & 0x3F));
+					}
+					o += 4;
+				}
+				i += used;
+			}
+			result.read = i;
+			result.written = o;
+			return result;
+		}
+
+		inline const unsigned char* bytes(const void* p) {
+			return static_cast<const unsigned char*>(p);
+		}
+		inline const char16_t* units(const void* p) {
+			return static_cast<const char16_t*>(p);
+		}
+	}
+
+	// 输出长度（包括替换字符），可以用来预先分配缓冲区
+	inline size_t utf16_length(std::string_view in) {
+		return detail::utf8_to_utf16<false>(detail::bytes(in.data()), in.size(), nullptr, true).written;
+	}
+	inline size_t utf16_length(std::u8string_view in) {
+		return detail::utf8_to_utf16<false>(detail::bytes(in.data()), in.size(), nullptr, true).written;
+	}
+	inline size_t utf8_length(std::u16string_view in) {
+		return detail::utf16_to_utf8<false>(in.data(), in.size(), nullptr, true).written;
+	}
+
+	inline bool is_valid(std::string_view in) {
+		return detail::utf8_to_utf16<false>(detail::bytes(in.data()), in.size(), nullptr, true).invalid == 0;
+	}
+	inline bool is_valid(std::u8string_view in) {
+		return detail::utf8_to_utf16<false>(detail::bytes(in.data()), in.size(), nullptr, true).invalid == 0;
+	}
+	inline bool is_valid(std::u16string_view in) {
+		return detail::utf16_to_utf8<false>(in.data(), in.size(), nullptr, true).invalid == 0;
+	}
+
+	// out 至少要有 utf16_length(in) 个单元（in.size() 个总是足够）
+	inline Result convert(std::string_view in, char16_t* out) {
+		return detail::utf8_to_utf16<true>(detail::bytes(in.data()), in.size(), out, true);
+	}
+	inline Result convert(std::u8string_view in, char16_t* out) {
+		return detail::utf8_to_utf16<true>(detail::bytes(in.data()), in.size(), out, true);
+	}
+	// out 至少要有 utf8_length(in) 个字节（in.size() * 3 个总是足够）
+	inline Result convert(std::u16string_view in, char* out) {
+		return detail::utf16_to_utf8<true>(in.data(), in.size(), (unsigned char*)out, true);
+	}
+	inline Result convert(std::u16string_view in, char8_t* out) {
+		return detail::utf16_to_utf8<true>(in.data(), in.size(), (unsigned char*)out, true);
+	}
+
+	// 转换到字符串。先按上界分配，转换后截到实际长度，只扫描一遍输入
+	template <class String16 = std::u16string, class View>
+	inline String16 to_utf16(View in) {
+		static_assert(sizeof(typename String16::value_type) == 2, "String16 must hold 16-bit units");
+		std::basic_string_view<typename View::value_type> view(in);
+		String16 out;
+		out.resize(view.size());
+		auto result = detail::utf8_to_utf16<true>(detail::bytes(view.data()), view.size(),
+			reinterpret_cast<char16_t*>(out.data()), true);
+		out.resize(result.written);
+		return out;
+	}
+	template <class String8 = std::string, class View>
+	inline String8 to_utf8(View in) {
+		static_assert(sizeof(typename String8::value_type) == 1, "String8 must hold bytes");
+		std::basic_string_view<typename View::value_type> view(in);
+		static_assert(sizeof(typename View::value_type) == 2, "input must be UTF-16");
+		String8 out;
+		out.resize(view.size() * 3);
+		auto result = detail::utf16_to_utf8<true>(detail::units(view.data()), view.size(),
+			(unsigned char*)out.data(), true);
+		out.resize(result.written);
+		return out;
+	}
+
+#if WCHAR_MAX == 0xFFFF
+	// Windows 上 wchar_t 就是 UTF-16
+	inline size_t utf8_length(std::wstring_view in) {
+		return utf8_length(std::u16string_view(detail::units(in.data()), in.size()));
+	}
+	inline bool is_valid(std::wstring_view in) {
+		return is_valid(std::u16string_view(detail::units(in.data()), in.size()));
+	}
+	inline Result convert(std::string_view in, wchar_t* out) {
+		return convert(in, reinterpret_cast<char16_t*>(out));
+	}
+	inline Result convert(std::u8string_view in, wchar_t* out) {
+		return convert(in, reinterpret_cast<char16_t*>(out));
+	}
+	inline Result convert(std::wstring_view in, char* out) {
+		return convert(std::u16string_view(detail::units(in.data()), in.size()), out);
+	}
+	inline Result convert(std::wstring_view in, char8_t* out) {
+		return convert(std::u16string_view(detail::units(in.data()), in.size()), out);
+	}
+#endif
+
+	enum class Encoding {
+		Unknown,
+		Utf8,
+		Utf16LE,
+		Utf16BE,
+		Ansi,  // 当前代码页，需要由 Win32 转换
+	};
+
+	// 开头的 BOM 对应的编码和长度；没有 BOM 时返回 Unknown 和 0
+	inline Encoding detect_bom(std::string_view bytes, size_t& length) {
+		auto b = detail::bytes(bytes.data());
+		size_t n = bytes.size();
+		length = 0;
+		if (n >= 3 && b[0] == 0xEF && b[1] == 0xBB && b[2] == 0xBF) {
+			length = 3;
+			return Encoding::Utf8;
+		}
+		if (n >= 2 && b[0] == 0xFF && b[1] == 0xFE) {
+			length = 2;
+			return Encoding::Utf16LE;
+		}
+		if (n >= 2 && b[0] == 0xFE && b[1] == 0xFF) {
+			length = 2;
+			return Encoding::Utf16BE;
+		}
+		return Encoding::Unknown;
+	}
+
+	// 判断文件内容的编码，只检查开头的 sample 个字节。
+	// 有 BOM 时以 BOM 为准；否则 0 字节集中在奇数（偶数）位置时认为是没有 BOM 的 UTF-16LE（BE），
+	// 合法的 UTF-8（包括纯 ASCII）认为是 UTF-8，其余按当前代码页处理。
+	// 这只是启发式判断，不含 0 字节的 UTF-16 文本会被当作 Ansi
+	inline Encoding detect_encoding(std::string_view bytes, size_t sample = 64 * 1024) {
+		size_t bom;
+		Encoding encoding = detect_bom(bytes, bom);
+		if (encoding != Encoding::Unknown) return encoding;
+		std::string_view head = bytes.substr(0, sample);
+		auto b = detail::bytes(head.data());
+		size_t pairs = head.size() / 2, even_zeros = 0, odd_zeros = 0;
+		for (size_t i = 0; i < pairs * 2; i += 2) {
+			even_zeros += b[i] == 0;
+			odd_zeros += b[i + 1] == 0;
+		}
+		if (pairs && odd_zeros * 4 >= pairs && even_zeros * 16 < pairs) return Encoding::Utf16LE;
+		if (pairs && even_zeros * 4 >= pairs && odd_zeros * 16 < pairs) return Encoding::Utf16BE;
+		// 样本可能在一个字符中间截断，末尾不完整的序列不算错误
+		bool complete = head.size() == bytes.size();
+		if (detail::utf8_to_utf16<false>(b, head.size(), nullptr, complete).invalid == 0) return Encoding::Utf8;
+		return Encoding::Ansi;
+	}
+
+	// 分块解码 UTF-8：块末尾不完整的序列留到下一块，最后一块传 final = true。
+	// out 至少要有 chunk.size() + 2 个单元
+	class Utf8Decoder {
+	public:
+		Result feed(std::string_view chunk, char16_t* out, bool final = false) {
+			return feed(detail::bytes(chunk.data()), chunk.size(), out, final);
+		}
+		Result feed(std::u8string_view chunk, char16_t* out, bool final = false) {
+			return feed(detail::bytes(chunk.data()), chunk.size(), out, final);
+		}
+#if WCHAR_MAX == 0xFFFF
+		Result feed(std::string_view chunk, wchar_t* out, bool final = false) {
+			return feed(detail::bytes(chunk.data()), chunk.size(), reinterpret_cast<char16_t*>(out), final);
+		}
+#endif
+		// 上一块留下的字节数
+		size_t pending() const {
+			return pending_size;
+		}
+		void reset() {
+			pending_size = 0;
+		}
+
+	private:
+		unsigned char buffer[4] = {};
+		size_t pending_size = 0;
+
+		Result feed(const unsigned char* in, size_t n, char16_t* out, bool final) {
+			Result result;
+			size_t consumed = 0;
+			if (pending_size) {
+				// 先用这一块开头的字节补全上一块留下的序列
+				unsigned char joined[8];
+				size_t take = n < 3 ? n : 3;
+				std::memcpy(joined, buffer, pending_size);
+				std::memcpy(joined + pending_size, in, take);
+				char32_t cp;
+				bool valid, truncated;
+				size_t used = detail::decode(joined, pending_size + take, cp, valid, truncated);
+				if (truncated && !final) {
+					// 这一块太短，仍然不完整
+					std::memcpy(buffer + pending_size, in, take);
+					pending_size += take;
+					result.read = n;
+					return result;
+				}
+				if (!valid) ++result.invalid;
+				if (cp >= 0x10000) {
+					out[0] = char16_t(0xD800 + ((cp - 0x10000) >> 10));
+					out[1] = char16_t(0xDC00 + (cp & 0x3FF));
+					result.written = 2;
+				}
+				else {
+					out[0] = char16_t(cp);
+					result.written = 1;
+				}
+				// pending 总是合法前缀，所以 used >= pending_size
+				consumed = used - pending_size;
+				pending_size = 0;
+			}
+			auto rest = detail::utf8_to_utf16<true>(in + consumed, n - consumed, out + result.written, final);
+			size_t left = n - consumed - rest.read;
+			std::memcpy(buffer, in + consumed + rest.read, left);
+			pending_size = left;
+			result.read = n;
+			result.written += rest.written;
+			result.invalid += rest.invalid;
+			return result;
+		}
+	};
+
+	// 分块编码 UTF-16：块末尾落单的高代理留到下一块，最后一块传 final = true。
+	// out 至少要有 chunk.size() * 3 + 4 个字节
+	class Utf16Encoder {
+	public:
+		Result feed(std::u16string_view chunk, char* out, bool final = false) {
+			return feed(chunk.data(), chunk.size(), (unsigned char*)out, final);
+		}
+		Result feed(std::u16string_view chunk, char8_t* out, bool final = false) {
+			return feed(chunk.data(), chunk.size(), (unsigned char*)out, final);
+		}
+#if WCHAR_MAX == 0xFFFF
+		Result feed(std::wstring_view chunk, char* out, bool final = false) {
+			return feed(detail::units(chunk.data()), chunk.size(), (unsigned char*)out, final);
+		}
+#endif
+		size_t pending() const {
+			return high ? 1 : 0;
+		}
+		void reset() {
+			high = 0;
+		}
+
+	private:
+		char16_t high = 0;
+
+		Result feed(const char16_t* in, size_t n, unsigned char* out, bool final) {
+			Result result;
+			size_t consumed = 0;
+			if (high) {
+				if (n == 0 && !final) return result;
+				char16_t pair[2] = { high, n ? in[0] : char16_t(0) };
+				bool paired = n && in[0] >= 0xDC00 && in[0] <= 0xDFFF;
+				auto first = detail::utf16_to_utf8<true>(pair, paired ? 2 : 1, out, true);
+				result.written = first.written;
+				result.invalid = first.invalid;
+				consumed = paired ? 1 : 0;
+				high = 0;
+			}
+			auto rest = detail::utf16_to_utf8<true>(in + consumed, n - consumed, out + result.written, final);
+			if (consumed + rest.read < n) high = in[n - 1];
+			result.read = n;
+			result.written += rest.written;
+			result.invalid += rest.invalid;
+			return result;
+		}
+	};
+}
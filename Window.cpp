@@ -1,18 +1,22 @@
 ﻿#include "Window.hpp"
+#pragma comment(lib, "advapi32.lib") // RegGetValueW
 using namespace w32oop;
 using namespace w32oop::util;
 wstring w32oop::util::s2ws(const string str) {
 	wstring result;
-	size_t len = MultiByteToWideChar(CP_ACP, 0, str.c_str(),
+	// 纯 ASCII（例如类型名）在任何代码页下都一样，直接展开，不用调用两次 MultiByteToWideChar
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str.data());
+	if (utf::detail::ascii_prefix(bytes, str.size()) == str.size()) {
+		result.resize(str.size());
+		utf::detail::widen_ascii(bytes, str.size(), reinterpret_cast<char16_t*>(result.data()));
+		return result;
+	}
+	int len = MultiByteToWideChar(CP_ACP, 0, str.c_str(),
 		(int)(str.size()), NULL, 0);
-	if (len < 0) return result;
-	wchar_t* buffer = new wchar_t[len + 1];
-	if (buffer == NULL) return result;
+	if (len <= 0) return result;
+	result.resize((size_t)len);
 	MultiByteToWideChar(CP_ACP, 0, str.c_str(), (int)(str.size()),
-		buffer, (int)len);
-	buffer[len] = '\0';
-	result.append(buffer);
-	delete[] buffer;
+		result.data(), len);
 	return result;
 }
 static BOOL CALLBACK GetAllChildWindows__EnumChildProc(HWND hwndChild, LPARAM lParam) {
@@ -26,14 +30,356 @@ std::vector<HWND> w32oop::util::GetAllChildWindows(HWND hParent) {
 	return childHandles;
 }
 
+util::MappedFile& util::MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+		std::swap(view, other.view);
+		std::swap(length, other.length);
+		std::swap(last_error, other.last_error);
+	}
+	return *this;
+}
+
+bool util::MappedFile::open(const std::wstring& path) {
+	close();
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		last_error = GetLastError();
+		return false;
+	}
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(file, &file_size)) {
+		last_error = GetLastError();
+		close();
+		return false;
+	}
+	// 空文件不能创建映射，当作内容为空
+	if (file_size.QuadPart == 0) return true;
+	if ((unsigned long long)file_size.QuadPart > (size_t)-1) {
+		last_error = ERROR_FILE_TOO_LARGE;
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping) view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!view) {
+		last_error = GetLastError();
+		close();
+		return false;
+	}
+	length = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void util::MappedFile::close() {
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	view = nullptr;
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+	length = 0;
+}
+
+util::AsyncFileWriter::~AsyncFileWriter() {
+	{
+		lock_guard lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_one();
+	if (worker.joinable()) worker.join();
+}
+
+LPARAM util::AsyncFileWriter::save(std::wstring path, std::wstring text) {
+	LPARAM id;
+	{
+		lock_guard lock(mutex);
+		id = ++next_id;
+		// 同一路径还没开始写入的请求直接换成新的内容
+		auto it = std::find_if(pending.begin(), pending.end(), [&](const Request& r) { return r.path == path; });
+		if (it != pending.end()) {
+			post(Superseded, 0, it->id);
+			it->id = id;
+			it->text = std::move(text);
+		}
+		else {
+			pending.push_back(Request{ id, std::move(path), std::move(text) });
+		}
+		if (!worker.joinable()) worker = std::thread(&AsyncFileWriter::run, this);
+	}
+	wakeup.notify_one();
+	return id;
+}
+
+bool util::AsyncFileWriter::busy() const {
+	lock_guard lock(mutex);
+	return writing || !pending.empty();
+}
+
+void util::AsyncFileWriter::run() {
+	unique_lock lock(mutex);
+	while (true) {
+		wakeup.wait(lock, [this] { return stopping || !pending.empty(); });
+		// 停止前先写完剩下的请求
+		if (pending.empty()) return;
+		Request request = std::move(pending.front());
+		pending.pop_front();
+		writing = true;
+		lock.unlock();
+		DWORD error = write(request);
+		// 先清除 writing 再通知，收到结果时 busy() 已经反映这次写入结束
+		lock.lock();
+		writing = false;
+		post(error ? Failed : Succeeded, error, request.id);
+	}
+}
+
+DWORD util::AsyncFileWriter::write(const Request& request) {
+	// 临时文件必须和目标在同一个卷上才能原子替换
+	wstring directory = L".";
+	size_t slash = request.path.find_last_of(L"\\/");
+	if (slash != wstring::npos) directory = request.path.substr(0, slash + 1);
+	wchar_t temp[MAX_PATH + 1]{};
+	if (!GetTempFileNameW(directory.c_str(), L"w32", 0, temp)) return GetLastError();
+	HANDLE file = CreateFileW(temp, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		DWORD error = GetLastError();
+		DeleteFileW(temp);
+		return error;
+	}
+	// 分块编码，缓冲区大小固定，不需要整个 UTF-8 副本
+	constexpr size_t chunk_units = 1 << 20;
+	std::string buffer(chunk_units * 3 + 4, '\0');
+	utf::Utf16Encoder encoder;
+	const size_t total = request.text.size();
+	DWORD error = 0;
+	int reported = -1;
+	for (size_t pos = 0; pos < total || pos == 0; ) {
+		size_t take = (std::min)(chunk_units, total - pos);
+		bool last = pos + take == total;
+		auto result = encoder.feed(std::wstring_view(request.text).substr(pos, take), buffer.data(), last);
+		DWORD written = 0;
+		if (result.written && (!WriteFile(file, buffer.data(), (DWORD)result.written, &written, nullptr)
+			|| written != result.written)) {
+			error = GetLastError();
+			if (!error) error = ERROR_WRITE_FAULT;
+			break;
+		}
+		pos += take;
+		int percent = total ? (int)(pos * 100 / total) : 100;
+		if (percent != reported) {
+			reported = percent;
+			post(Progress, (DWORD)percent, request.id);
+		}
+		if (last) break;
+	}
+	if (!error && !FlushFileBuffers(file)) error = GetLastError();
+	CloseHandle(file);
+	if (!error) {
+		// ReplaceFileW 保留原文件的属性和安全描述符；目标不存在时退回到 MoveFileExW
+		if (!ReplaceFileW(request.path.c_str(), temp, nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr)) {
+			error = GetLastError();
+			if (error == ERROR_FILE_NOT_FOUND
+				&& MoveFileExW(temp, request.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+				error = 0;
+			}
+			else if (error == ERROR_FILE_NOT_FOUND) {
+				error = GetLastError();
+			}
+		}
+	}
+	if (error) DeleteFileW(temp);
+	return error;
+}
+
+util::TextDecoder::TextDecoder(std::string_view bytes, utf::Encoding encoding, UINT ansi_code_page) : input(bytes), enc(encoding), code_page(ansi_code_page) {
+	size_t bom = 0;
+	utf::Encoding marked = utf::detect_bom(bytes, bom);
+	if (enc == utf::Encoding::Unknown) enc = marked != utf::Encoding::Unknown ? marked : utf::detect_encoding(bytes);
+	// 指定的编码与 BOM 不符时不跳过，BOM 按内容解码
+	if (marked == enc) pos = bom;
+}
+
+bool util::TextDecoder::next(std::wstring& out, size_t chunk_bytes) {
+	out.clear();
+	if (finished) return false;
+	if (chunk_bytes < 16) chunk_bytes = 16;
+	size_t take = (std::min)(chunk_bytes, input.size() - pos);
+	const char* chunk = input.data() + pos;
+	bool last = pos + take == input.size();
+	switch (enc) {
+	case utf::Encoding::Utf16LE:
+	case utf::Encoding::Utf16BE: {
+		// 只在偶数字节处分块；代理对被分开也没关系，拼接后仍然完整
+		if (!last) take &= ~(size_t)1;
+		size_t units = take / 2;
+		out.resize(units + (take & 1));
+		std::memcpy(out.data(), chunk, units * 2);
+		if (enc == utf::Encoding::Utf16BE) {
+			for (size_t i = 0; i < units; ++i) out[i] = (wchar_t)(((out[i] & 0xFF) << 8) | ((out[i] >> 8) & 0xFF));
+		}
+		// 文件末尾多出的单个字节
+		if (take & 1) out[units] = (wchar_t)utf::replacement;
+		break;
+	}
+	case utf::Encoding::Ansi: {
+		if (!last) {
+			// 双字节代码页的尾字节不会是 '\n'，在最后一个换行之后分块就不会切开字符
+			size_t cut = std::string_view(chunk, take).rfind('\n');
+			if (cut != std::string_view::npos) take = cut + 1;
+			else {
+				// 没有换行（单行或压缩过的文件）：尾字节也可能落在前导字节的范围内，
+				// 只能从块首（上一块已经保证是字符边界）向后数到最后一个完整的字符
+				size_t boundary = 0;
+				while (boundary < take) {
+					size_t step = IsDBCSLeadByteEx(code_page, (BYTE)chunk[boundary]) ? 2 : 1;
+					if (boundary + step > take) break;
+					boundary += step;
+				}
+				take = boundary;
+			}
+		}
+		int length = MultiByteToWideChar(code_page, 0, chunk, (int)take, nullptr, 0);
+		out.resize((size_t)(length > 0 ? length : 0));
+		if (length > 0) MultiByteToWideChar(code_page, 0, chunk, (int)take, out.data(), length);
+		break;
+	}
+	default: {
+		// 上一块留下的不完整序列最多 3 个字节，再加上代理对需要的空间
+		out.resize(take + 2);
+		auto result = utf8.feed(std::string_view(chunk, take), out.data(), last);
+		out.resize(result.written);
+		break;
+	}
+	}
+	pos += take;
+	finished = pos == input.size();
+	return true;
+}
+
+
+// 缓存必须先于持有 GdiHandle 的静态对象构造、后于它们析构
+unordered_map<string, GdiCache::Entry> GdiCache::entries;
+std::mutex GdiCache::entries_mutex;
+
+GdiCache::Entry* GdiCache::acquire(const string& key, function<HGDIOBJ()> create) {
+	lock_guard lock(entries_mutex);
+	auto it = entries.find(key);
+	if (it == entries.end()) {
+		HGDIOBJ handle = create();
+		if (!handle) return nullptr;
+		it = entries.emplace(key, Entry{}).first;
+		it->second.handle = handle;
+		it->second.key = &it->first;
+	}
+	++it->second.refs;
+	return &it->second;
+}
+
+void GdiCache::retain(Entry* entry) {
+	if (!entry) return;
+	lock_guard lock(entries_mutex);
+	++entry->refs;
+}
+
+void GdiCache::release(Entry* entry) {
+	if (!entry) return;
+	lock_guard lock(entries_mutex);
+	if (--entry->refs) return;
+	DeleteObject(entry->handle);
+	entries.erase(*entry->key);
+}
+
+template <class... Fields>
+static string gdi_cache_key(char kind, const Fields&... fields) {
+	string key(1, kind);
+	(key.append(reinterpret_cast<const char*>(&fields), sizeof(fields)), ...);
+	return key;
+}
+
+GdiBrush GdiCache::brush(COLORREF color) {
+	return GdiBrush(acquire(gdi_cache_key('B', color), [color] {
+		return (HGDIOBJ)CreateSolidBrush(color);
+	}));
+}
+
+GdiPen GdiCache::pen(int style, int width, COLORREF color) {
+	return GdiPen(acquire(gdi_cache_key('P', style, width, color), [=] {
+		return (HGDIOBJ)CreatePen(style, width, color);
+	}));
+}
+
+GdiFont GdiCache::font(const LOGFONTW& logfont, UINT dpi) {
+	// 字体名后面的内容不确定，规范化后再作为键
+	LOGFONTW normalized = logfont;
+	std::fill(std::begin(normalized.lfFaceName), std::end(normalized.lfFaceName), L'\0');
+	wcsncpy_s(normalized.lfFaceName, logfont.lfFaceName, _TRUNCATE);
+	return GdiFont(acquire(gdi_cache_key('F', normalized, dpi), [normalized, dpi] {
+		LOGFONTW scaled = normalized;
+		scaled.lfHeight = MulDiv(scaled.lfHeight, dpi, 96);
+		scaled.lfWidth = MulDiv(scaled.lfWidth, dpi, 96);
+		return (HGDIOBJ)CreateFontIndirectW(&scaled);
+	}));
+}
+
+GdiFont GdiCache::font(const wstring& face, int height, int width, int weight, BYTE quality, UINT dpi) {
+	LOGFONTW logfont{};
+	logfont.lfHeight = height;
+	logfont.lfWidth = width;
+	logfont.lfWeight = weight;
+	logfont.lfCharSet = DEFAULT_CHARSET;
+	logfont.lfOutPrecision = OUT_CHARACTER_PRECIS;
+	logfont.lfClipPrecision = CLIP_CHARACTER_PRECIS;
+	logfont.lfQuality = quality;
+	logfont.lfPitchAndFamily = FF_DONTCARE;
+	wcsncpy_s(logfont.lfFaceName, face.c_str(), _TRUNCATE);
+	return font(logfont, dpi);
+}
+
+GdiFont GdiCache::adopt(HFONT font) {
+	return GdiFont(acquire(gdi_cache_key('H', font), [font] { return (HGDIOBJ)font; }));
+}
+
+size_t GdiCache::size() {
+	lock_guard lock(entries_mutex);
+	return entries.size();
+}
+
 
 unordered_map<HWND, Window*> Window::managed;
 map<Window::GlobalOptions, long long> Window::global_options;
-HFONT Window::default_font;
+unordered_map<type_index, ATOM> Window::class_atoms;
+shared_mutex Window::class_atoms_mutex;
+unordered_map<const Window*, vector<Window*>> Window::deferred_children;
+GdiFont Window::default_font;
 std::recursive_mutex Window::default_font_mutex;
-map<Window::HotKeyOptions, function<void(Window::HotKeyProcData&)>> Window::hotkey_handlers;
+vector<GdiBrush> Window::class_brushes;
+Window::HotKeyTable Window::hotkey_handlers;
+hotkey::Published<Window::HotKeyTable> Window::hotkey_snapshot;
+Window::HotKeySequenceTable Window::hotkey_sequences;
+hotkey::Published<Window::HotKeySequenceTrie> Window::hotkey_sequence_snapshot;
 std::recursive_mutex Window::hotkey_handlers_mutex;
+size_t Window::hotkey_batch_depth;
+bool Window::hotkey_table_dirty;
+bool Window::hotkey_sequences_dirty;
 std::atomic<size_t> Window::hotkey_global_count;
+thread_local Window::HotKeyProcInternal* Window::hotkey_thread_hook;
+thread_local Window::HotKeyProcInternal* Window::hotkey_global_hook;
+thread_local const Window::HotKeyAccelerators* Window::hotkey_translating;
+thread_local const MSG* Window::hotkey_translating_msg;
+UINT Window::hotkey_dispatch_message;
+Window::HotKeyNativeBackend Window::hotkey_native_backend;
+hotkey::BackendSelector Window::hotkey_backends(Window::hotkey_native_backend);
+hotkey::LatencyHistogram Window::hotkey_latency_low_level;
+hotkey::LatencyHistogram Window::hotkey_latency_thread;
+std::atomic<uint64_t> Window::hotkey_reinstalls;
+std::atomic<uint64_t> Window::hotkey_slow_threshold_us;
+function<void(const Window::HotKeyLatencyEvent&)> Window::hotkey_latency_callback;
+std::mutex Window::hotkey_latency_mutex;
 std::atomic<unsigned long long> BaseSystemWindow::ctlid_generator;
 
 
@@ -52,19 +398,16 @@ const wstring Window::get_class_name() const
 }
 
 void Window::set_default_font(HFONT font) {
-	default_font_mutex.lock();
-	if (default_font) DeleteObject(default_font);
-	default_font = font;
-	default_font_mutex.unlock();
+	set_default_font(GdiCache::adopt(font));
 }
 
 void Window::set_default_font(wstring font_name) {
-	default_font_mutex.lock();
-	if (default_font) DeleteObject(default_font);
-	default_font = CreateFontW(-14, -7, 0, 0, FW_NORMAL, 0, 0, 0, DEFAULT_CHARSET,
-		OUT_CHARACTER_PRECIS, CLIP_CHARACTER_PRECIS, DEFAULT_QUALITY, FF_DONTCARE,
-		font_name.c_str());
-	default_font_mutex.unlock();
+	set_default_font(GdiCache::font(font_name, -14, -7));
+}
+
+void Window::set_default_font(GdiFont font) {
+	lock_guard lock(default_font_mutex);
+	default_font = std::move(font);
 }
 
 void Window::set_accelerator(HACCEL accelerator) {
@@ -84,20 +427,46 @@ void Window::register_class_if_needed() {
 		wcex.hIcon = wcex.hIconSm = get_window_icon();
 		wcex.hCursor = LoadCursor(nullptr, IDC_ARROW);
 		//wcex.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
-		wcex.hbrBackground = CreateSolidBrush(get_window_background_color());
+		// 窗口类存在期间画刷必须有效，由 class_brushes 持有
+		GdiBrush background = GdiCache::brush(get_window_background_color());
+		wcex.hbrBackground = background;
 		wcex.lpszMenuName = NULL;
+		wstring class_name = get_class_name();
 		wcex.lpszClassName = class_name.c_str();
 
 		if (!RegisterClassExW(&wcex)) {
 			throw window_class_registration_failure_exception();
 		}
+		class_brushes.push_back(std::move(background));
 	}
 }
 
+ATOM Window::resolve_class_atom() {
+	type_index type(typeid(*this));
+	{
+		shared_lock lock(class_atoms_mutex);
+		auto it = class_atoms.find(type);
+		if (it != class_atoms.end()) return it->second;
+	}
+	// 注册也在独占锁内完成，多个线程同时第一次创建同一类型的窗口时只注册一次
+	unique_lock lock(class_atoms_mutex);
+	auto it = class_atoms.find(type);
+	if (it != class_atoms.end()) return it->second;
+	register_class_if_needed();
+	WNDCLASSEXW wc{};
+	wc.cbSize = sizeof(WNDCLASSEXW);
+	ATOM atom = (ATOM)GetClassInfoExW(GetModuleHandleW(NULL), get_class_name().c_str(), &wc);
+	// 系统控件类可能稍后才注册（例如公共控件），查不到时不缓存，下次再查
+	if (atom) class_atoms.emplace(type, atom);
+	return atom;
+}
+
 HWND Window::new_window() {
+	wstring class_name;
+	if (!class_atom) class_name = get_class_name();
 	return CreateWindowExW(
 		setup_info->styleEx,
-		class_name.c_str(),
+		class_atom ? MAKEINTATOM(class_atom) : class_name.c_str(),
 		setup_info->title.c_str(),
 		setup_info->style,
 		setup_info->x, setup_info->y,
@@ -107,7 +476,7 @@ HWND Window::new_window() {
 }
 
 Window::Window(const std::wstring& title, int width, int height, int x, int y, LONG style, LONG styleEx, HMENU hMenu) {
-	setup_info = new setup_info_class();
+	setup_info = make_unique<setup_info_class>();
 	setup_info->title = title;
 	setup_info->width = width;
 	setup_info->height = height;
@@ -117,23 +486,24 @@ Window::Window(const std::wstring& title, int width, int height, int x, int y, L
 	setup_info->hMenu = hMenu;
 }
 
-Window::Window() {
-	setup_info = nullptr;
-}
+Window::Window() {}
 
 Window& Window::operator=(Window&& other) noexcept {
 	// 检查自赋值
 	if (this != &other) {
+		// 原来推迟创建的窗口不会再被创建
+		if (deferred()) unlist_deferred();
+		abandon_deferred_children();
 		// 转移所有权
 		hwnd = other.hwnd;
 		_created = other._created;
-		setup_info = other.setup_info;
+		setup_info = std::move(other.setup_info);
 		//notification_router = other.notification_router;
 
 		// 重置源对象
 		other.hwnd = nullptr;
 		other._created = false;
-		other.setup_info = nullptr;
+		other.setup_info.reset();
 		//other.notification_router = nullptr;
 
 		// 更新窗口的用户数据指针
@@ -141,10 +511,23 @@ Window& Window::operator=(Window&& other) noexcept {
 			SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
 			managed[hwnd] = this;
 		}
+		relink_deferred(&other);
 	}
 	return *this;
 }
 
+void Window::relink_deferred(const Window* from) {
+	// 自己推迟创建：父窗口列表中的这一项
+	if (deferred()) deferred_children[setup_info->deferred_parent][setup_info->deferred_slot] = this;
+	// 推迟创建、等待自己的子窗口：换成以新对象为键
+	auto it = deferred_children.find(from);
+	if (it == deferred_children.end()) return;
+	auto children = std::move(it->second);
+	deferred_children.erase(it);
+	for (auto child : children) child->setup_info->deferred_parent = this;
+	deferred_children[this] = std::move(children);
+}
+
 void Window::create() {
 	if (_created) throw window_already_initialized_exception();
 	if (!setup_info) throw window_illegal_state_exception();
@@ -155,37 +538,81 @@ void Window::create() {
 	catch (std::exception&) {
 		throw;
 	}
-	class_name = get_class_name();
-	register_class_if_needed();
+	class_atom = resolve_class_atom();
+	_created = true;
+	// 父窗口隐藏时推迟创建，等父窗口显示或第一次用到 HWND 时再创建。
+	// 只有父窗口经过 StaticWndProc 时才能收到它显示的通知。
+	// 父窗口自己还在推迟时总是跟着推迟，父窗口创建后再决定
+	Window* parent = creation_parent_window();
+	if (!parent && creation_parent()) {
+		auto it = managed.find(creation_parent());
+		if (it != managed.end()) parent = it->second;
+	}
+	bool defer = parent && parent->deferred();
+	if (!defer && parent && parent->hwnd && get_global_option(Option_DeferHiddenControls)) {
+		defer = !(GetWindowLongPtr(parent->hwnd, GWL_STYLE) & WS_VISIBLE)
+			&& GetWindowLongPtr(parent->hwnd, GWLP_USERDATA) == reinterpret_cast<LONG_PTR>(parent);
+	}
+	if (defer) {
+		auto& list = deferred_children[parent];
+		setup_info->deferred_parent = parent;
+		setup_info->deferred_slot = list.size();
+		list.push_back(this);
+		return;
+	}
+	materialize();
+}
+
+void Window::materialize() {
+	Window* waited = setup_info->deferred_parent;
+	if (waited) unlist_deferred();
+	// 父窗口还没有 HWND：先创建它（已经创建则直接取得句柄）
+	if (!creation_parent()) {
+		Window* parent = waited ? waited : creation_parent_window();
+		if (parent) resolve_creation_parent(*parent);
+	}
 	if (get_global_option(Option_DebugMode)) {
 		fwprintf(stdout, L"[w32oop::Window]: Creating window `%s` with style `%d` and title `%s`\n",
-			class_name.c_str(), int(setup_info->style), setup_info->title.c_str());
+			get_class_name().c_str(), int(setup_info->style), setup_info->title.c_str());
 		fflush(stdout);
 	}
 	hwnd = new_window();
 	if (!hwnd) {
 		if (get_global_option(Option_DebugMode)) {
 			fprintf(stderr, "[w32oop::Window]: Cannot create window!! %d [where] CLASS_NAME = ", GetLastError());
-			fwprintf(stderr, L"%ls\n", class_name.c_str());
+			fwprintf(stderr, L"%ls\n", get_class_name().c_str());
 		}
+		_created = false;
 		throw window_creation_failure_exception();
 	}
 	try {
-		delete setup_info;
-		setup_info = nullptr;
+		// 推迟创建期间设置的字体在默认字体之后应用
+		HFONT queued_font = setup_info->font;
+		GdiFont queued_font_ref = std::move(setup_info->font_ref);
+		setup_info.reset();
 		managed[hwnd] = this;
 		m_onCreated();
+		if (queued_font) {
+			SendMessageW(hwnd, WM_SETFONT, (WPARAM)queued_font, 0);
+			font_ref = std::move(queued_font_ref);
+		}
 		onCreated();
-		_created = true;
 	}
 	catch (std::exception& exc) {
 		DestroyWindow(hwnd);
 		hwnd = nullptr;
+		_created = false;
 		if (get_global_option(Option_DebugMode)) {
 			fprintf(stderr, "Cannot create window!! %s\n", exc.what());
 		}
 		throw;
 	}
+	// 推迟期间挂在自己下面的子窗口：自己已经可见，或者收不到显示的通知时，现在就创建
+	if (deferred_children.contains(this)
+		&& ((GetWindowLongPtr(hwnd, GWL_STYLE) & WS_VISIBLE)
+			|| GetWindowLongPtr(hwnd, GWLP_USERDATA) != reinterpret_cast<LONG_PTR>(this))) {
+		materialize_deferred_children();
+	}
 }
 
 void Window::create(
@@ -193,7 +620,7 @@ void Window::create(
 	LONG style, LONG styleEx, HMENU hMenu
 ) {
 	if (_created) throw window_already_initialized_exception();
-	if (!setup_info) setup_info = new setup_info_class();
+	if (!setup_info) setup_info = make_unique<setup_info_class>();
 	setup_info->title = title;
 	setup_info->width = width;
 	setup_info->height = height;
@@ -204,10 +631,112 @@ void Window::create(
 	return create();
 }
 
+void Window::create(
+	std::u8string_view title, int width, int height, int x, int y,
+	LONG style, LONG styleEx, HMENU hMenu
+) {
+	return create(util::u8ws(title), width, height, x, y, style, styleEx, hMenu);
+}
+
 bool Window::created() {
 	return _created;
 }
 
+void Window::unlist_deferred() {
+	auto it = deferred_children.find(setup_info->deferred_parent);
+	if (it != deferred_children.end()) {
+		auto& list = it->second;
+		size_t slot = setup_info->deferred_slot;
+		list[slot] = list.back();
+		list[slot]->setup_info->deferred_slot = slot;
+		list.pop_back();
+		if (list.empty()) deferred_children.erase(it);
+	}
+	setup_info->deferred_parent = nullptr;
+}
+
+void Window::materialize_deferred_children() {
+	auto it = deferred_children.find(this);
+	if (it == deferred_children.end()) return;
+	auto children = std::move(it->second);
+	deferred_children.erase(it);
+	for (auto child : children) {
+		child->setup_info->deferred_parent = nullptr;
+		if (!child->creation_parent()) child->resolve_creation_parent(hwnd);
+	}
+	for (auto child : children) child->materialize();
+}
+
+void Window::abandon_deferred_children() {
+	auto it = deferred_children.find(this);
+	if (it == deferred_children.end()) return;
+	// 父窗口没有显示过就被销毁，这些控件（以及挂在它们下面的控件）不会再被创建
+	auto children = std::move(it->second);
+	deferred_children.erase(it);
+	for (auto child : children) {
+		child->setup_info->deferred_parent = nullptr;
+		child->_created = false;
+		child->abandon_deferred_children();
+	}
+}
+
+void Window::create_controls(const vector<ControlDescriptor>& controls) {
+	validate_hwnd();
+	size_t count = 0;
+	auto count_all = [&count](auto& self, const vector<ControlDescriptor>& list) -> void {
+		for (auto& item : list) {
+			++count;
+			self(self, item.children);
+		}
+	};
+	count_all(count_all, controls);
+	// 一次性预留空间，避免逐个插入时反复 rehash
+	managed.reserve(managed.size() + count);
+	vector<Window*> created;
+	created.reserve(count);
+
+	// 不可见的窗口本来就不会绘制；对它发送 WM_SETREDRAW TRUE 反而会把它设为可见
+	bool visible = IsWindowVisible(hwnd);
+	if (visible) SendMessage(hwnd, WM_SETREDRAW, FALSE, 0);
+	util::WindowRAIIHelper redraw([this, visible] {
+		if (!visible) return;
+		SendMessage(hwnd, WM_SETREDRAW, TRUE, 0);
+		RedrawWindow(hwnd, NULL, NULL, RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+	});
+	// 所有控件都创建好以后再设置字体，默认字体的锁只取一次
+	auto apply_fonts = [&created] {
+		lock_guard lock(default_font_mutex);
+		for (auto control : created) {
+			// 推迟创建的控件在创建时自己设置字体
+			if (!control->hwnd) continue;
+			HFONT font = control->get_font();
+			if (font == default_font.get()) control->font_ref = default_font;
+			SendMessageW(control->hwnd, WM_SETFONT, (WPARAM)font, FALSE);
+		}
+	};
+	// 以 Window& 传递父窗口：推迟创建的控件不会因为要取父窗口的 HWND 而被创建，子控件跟着推迟
+	auto create_all = [&created](auto& self, Window& parent, const vector<ControlDescriptor>& list) -> void {
+		for (auto& item : list) {
+			if (!item.control) continue;
+			Window* control = item.control;
+			item.control->set_parent(parent);
+			control->defer_font = true;
+			util::WindowRAIIHelper restore([control] { control->defer_font = false; });
+			control->create(item.text, item.width, item.height, item.x, item.y, item.style);
+			created.push_back(control);
+			if (!item.children.empty()) self(self, *control, item.children);
+		}
+	};
+	try {
+		create_all(create_all, *this, controls);
+	}
+	catch (...) {
+		apply_fonts();
+		throw;
+	}
+	apply_fonts();
+}
+
 bool Window::force_focus(DWORD timeout) {
 	HWND fg = GetForegroundWindow();
 	if (!fg) return focus(); // fallback to normal focus
@@ -286,16 +815,92 @@ HMENU Window::sysmenu() const {
 }
 
 wstring Window::text() const {
+	wstring text;
+	text_into(text);
+	return text;
+}
+
+size_t Window::text_length() const {
+	if (deferred()) return setup_info->title.size();
+	validate_hwnd();
+	return (size_t)SendMessageW(hwnd, WM_GETTEXTLENGTH, 0, 0);
+}
+
+void Window::text_into(wstring& out) const {
+	if (deferred()) {
+		out.assign(setup_info->title);
+		return;
+	}
+	size_t length = text_length();
+	out.resize(length);
+	// WM_GETTEXT 会写入结尾的 0，正好落在 wstring 自带的结尾位置上
+	LRESULT copied = SendMessageW(hwnd, WM_GETTEXT, length + 1, (LPARAM)out.data());
+	// WM_GETTEXTLENGTH 可能比实际长度大
+	out.resize((size_t)copied);
+}
+
+size_t Window::text_into(span<wchar_t> buffer) const {
+	if (buffer.empty()) return 0;
+	if (deferred()) {
+		size_t copied = (std::min)(setup_info->title.size(), buffer.size() - 1);
+		std::copy_n(setup_info->title.data(), copied, buffer.data());
+		buffer[copied] = L'\0';
+		return copied;
+	}
+	validate_hwnd();
+	return (size_t)SendMessageW(hwnd, WM_GETTEXT, buffer.size(), (LPARAM)buffer.data());
+}
+
+void Window::text(wstring_view text, bool skip_if_unchanged) {
+	if (deferred()) {
+		setup_info->title.assign(text);
+		return;
+	}
 	validate_hwnd();
-	LRESULT len = SendMessageW(hwnd, WM_GETTEXTLENGTH, 0, 0);
-	wchar_t* buffer = new wchar_t[len + 1];
-	SendMessageW(hwnd, WM_GETTEXT, len + 1, (LPARAM)buffer);
-	wstring text(buffer);
-	delete[] buffer;
+	// 每个线程复用同一块缓冲区，容量够用以后不再分配
+	thread_local wstring scratch;
+	if (skip_if_unchanged && text_length() == text.size()) {
+		text_into(scratch);
+		if (scratch == text) return;
+	}
+	scratch.assign(text);
+	DWORD result = 0;
+	DWORD_PTR pResult = DWORD_PTR(&result);
+	SendMessageTimeoutW(hwnd, WM_SETTEXT, 0, (LPARAM)scratch.c_str(), SMTO_ERRORONEXIT, 500, &pResult);
+}
+
+void Window::text(std::u8string_view text) {
+	// 转换结果直接交给 WM_SETTEXT；每个线程复用同一块缓冲区
+	thread_local wstring converted;
+	if (deferred()) {
+		setup_info->title = util::u8ws(text);
+		return;
+	}
+	converted.resize(text.size());
+	auto result = utf::convert(text, converted.data());
+	converted.resize(result.written);
+	this->text(converted);
+}
+
+void Window::text_into(std::u8string& out) const {
+	thread_local wstring wide;
+	text_into(wide);
+	out.resize(wide.size() * 3);
+	auto result = utf::convert(wide, out.data());
+	out.resize(result.written);
+}
+
+std::u8string Window::u8text() const {
+	std::u8string text;
+	text_into(text);
 	return text;
 }
 
 void Window::text(const std::wstring& text) {
+	if (deferred()) {
+		setup_info->title = text;
+		return;
+	}
 	validate_hwnd();
 	DWORD result = 0;
 	DWORD_PTR pResult = DWORD_PTR(&result);
@@ -303,44 +908,86 @@ void Window::text(const std::wstring& text) {
 }
 
 HFONT Window::font() const {
+	if (deferred()) return setup_info->font;
 	return reinterpret_cast<HFONT>(SendMessage(hwnd, WM_GETFONT, 0, 0));
 }
 
 void Window::font(HFONT font) {
+	if (deferred()) {
+		setup_info->font = font;
+		setup_info->font_ref.reset();
+		return;
+	}
 	validate_hwnd();
 	SendMessage(hwnd, WM_SETFONT, (WPARAM)font, TRUE);
+	font_ref.reset();
+}
+
+void Window::font(GdiFont font) {
+	if (deferred()) {
+		setup_info->font = font;
+		setup_info->font_ref = std::move(font);
+		return;
+	}
+	validate_hwnd();
+	SendMessage(hwnd, WM_SETFONT, (WPARAM)font.get(), TRUE);
+	font_ref = std::move(font);
 }
 
 void Window::add_style(LONG_PTR style) {
+	if (deferred()) {
+		setup_info->style |= (LONG)style;
+		return;
+	}
 	validate_hwnd();
 	LONG_PTR currentStyle = GetWindowLongPtr(hwnd, GWL_STYLE);
 	SetWindowLongPtr(hwnd, GWL_STYLE, currentStyle | style);
 }
 
 void Window::remove_style(LONG_PTR style) {
+	if (deferred()) {
+		setup_info->style &= ~(LONG)style;
+		return;
+	}
 	validate_hwnd();
 	LONG_PTR currentStyle = GetWindowLongPtr(hwnd, GWL_STYLE);
 	SetWindowLongPtr(hwnd, GWL_STYLE, currentStyle & ~style);
 }
 
 void Window::add_style_ex(LONG_PTR styleEx) {
+	if (deferred()) {
+		setup_info->styleEx |= (LONG)styleEx;
+		return;
+	}
 	validate_hwnd();
 	LONG_PTR currentStyleEx = GetWindowLongPtr(hwnd, GWL_EXSTYLE);
 	SetWindowLongPtr(hwnd, GWL_EXSTYLE, currentStyleEx | styleEx);
 }
 
 void Window::remove_style_ex(LONG_PTR styleEx) {
+	if (deferred()) {
+		setup_info->styleEx &= ~(LONG)styleEx;
+		return;
+	}
 	validate_hwnd();
 	LONG_PTR currentStyleEx = GetWindowLongPtr(hwnd, GWL_EXSTYLE);
 	SetWindowLongPtr(hwnd, GWL_EXSTYLE, currentStyleEx & ~styleEx);
 }
 
 void Window::override_style(LONG_PTR style) {
+	if (deferred()) {
+		setup_info->style = (LONG)style;
+		return;
+	}
 	validate_hwnd();
 	SetWindowLongPtr(hwnd, GWL_STYLE, style);
 }
 
 void Window::override_style_ex(LONG_PTR styleEx) {
+	if (deferred()) {
+		setup_info->styleEx = (LONG)styleEx;
+		return;
+	}
 	validate_hwnd();
 	SetWindowLongPtr(hwnd, GWL_EXSTYLE, styleEx);
 }
@@ -382,6 +1029,11 @@ LRESULT Window::WndProc(UINT msg, WPARAM wParam, LPARAM lParam) {
 		// 窗口被销毁
 		return destroy_handler_internal(wParam, lParam);
 	}
+	// 即将显示：创建推迟的子窗口。SetWindowPos(SWP_SHOWWINDOW) 不发送 WM_SHOWWINDOW
+	if ((msg == WM_SHOWWINDOW && wParam)
+		|| (msg == WM_WINDOWPOSCHANGING && (reinterpret_cast<WINDOWPOS*>(lParam)->flags & SWP_SHOWWINDOW))) {
+		materialize_deferred_children();
+	}
 	// 处理窗口消息
 	// 首先判断特殊的窗口消息，检查源窗口到底是哪个
 	if (msg == WM_COMMAND || msg == WM_NOTIFY) {
@@ -481,9 +1133,9 @@ LRESULT Window::dispatchEvent(EventData& data, bool isTrusted, bool shouldBubble
 }
 
 void Window::dispatchEventForWindow(EventData& data) {
-	if (!router.contains(data.message)) return;
+	if (!router || !router->contains(data.message)) return;
 	try {
-		auto& handlers = router.at(data.message);
+		auto& handlers = router->at(data.message);
 		for (auto& handler : handlers) {
 			try {
 				handler(data);
@@ -514,10 +1166,8 @@ void Window::dispatchEventForWindow(EventData& data) {
 }
 
 Window::~Window() {
-	if (setup_info) {
-		delete setup_info;
-		setup_info = nullptr;
-	}
+	if (deferred()) unlist_deferred();
+	abandon_deferred_children();
 	if (!hwnd) return;
 	if (managed.contains(hwnd)) {
 		managed.erase(hwnd);
@@ -525,80 +1175,70 @@ Window::~Window() {
 	destroy();
 }
 
-HOOKPROC Window::make_hHook_proc(MyHookProc pfn, long long userdata) {
-	void* memory = VirtualAlloc(NULL, 4096, MEM_COMMIT, PAGE_READWRITE); // 4096是最小的了
-	if (!memory) throw std::bad_alloc();
-	const auto fail = [&](const char* reason) {
-		VirtualFree(memory, 0, MEM_RELEASE);
-		throw std::runtime_error(reason);
-	};
-
-	// 向 memory 写入我们的x86_64代码
-#ifdef _WIN64
-#if 0
-	; x64机器码 - __stdcall函数转发器
-	; 函数签名: LRESULT __stdcall function_name(int nCode, WPARAM wParam, LPARAM lParam)
-	; 转发到: LRESULT __stdcall procname(int nCode, WPARAM wParam, LPARAM lParam, long long userdata)
-#endif
-	static const unsigned char payload[] = {
-		0x53,                               // push rbx
-		0x56,                               // push rsi
-		0x57,                               // push rdi
-		0x55,                               // push rbp
-		0x48, 0x83, 0xEC, 0x28,             // sub rsp, 28h (对齐栈)
-		// 保存参数（注意：lParam 已经在 R8 中！）
-		0x48, 0x89, 0xCB,                   // mov rbx, rcx   ; 保存 nCode
-		0x48, 0x89, 0xD6,                   // mov rsi, rdx   ; 保存 wParam
-		//; lParam 已在 R8
-		// 加载函数指针和用户数据
-		0x48, 0xB8, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, // mov rax, [func_ptr]
-		0x49, 0xB9, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, // mov r9, [userdata]
-		// 设置调用参数
-		0x48, 0x89, 0xD9,                   // mov rcx, rbx   ; 恢复 nCode
-		0x48, 0x89, 0xF2,                   // mov rdx, rsi   ; 恢复 wParam
-		0xFF, 0xD0,                         // call rax
-		// 恢复寄存器
-		0x48, 0x83, 0xC4, 0x28,             // add rsp, 28h
-		0x5D,                               // pop rbp
-		0x5F,                               // pop rdi
-		0x5E,                               // pop rsi
-		0x5B,                               // pop rbx
-		0xC3                                // ret
-	};
-
-	size_t written = 0;
-	if (0 == WriteProcessMemory(GetCurrentProcess(), memory, &payload, sizeof(payload), &written) || written != sizeof(payload))
-		fail("Failed to write memory");
-
-	// 写入placeholder
-	// 函数指针（占位符 8 字节）
-	if (!WriteProcessMemory(GetCurrentProcess(), (char*)memory + 16, &pfn, 8, &written) || written != 8)
-		fail("Failed to write function pointer");
-
-	// userdata（占位符 8 字节）
-	if (!WriteProcessMemory(GetCurrentProcess(), (char*)memory + 26, &userdata, 8, &written) || written != 8)
-		fail("Failed to write userdata");
-#else
-#error "Platform is not supported; the library will not work well!"
-#endif
+bool Window::HotKeyHook::install(HotKeyProcInternal*& slot, int idHook, HOOKPROC proc, DWORD dwThreadId) {
+	if (slot) {
+		data = slot;
+		return data->hHook != NULL;
+	}
+	data = new HotKeyProcInternal();
+	data->thread_id = GetCurrentThreadId();
+	// 先登记上下文：SetWindowsHookExW 返回前钩子就可能被调用
+	slot = data;
+	this->slot = &slot;
+	data->want_hook = true;
+	data->hHook = SetWindowsHookExW(idHook, proc, GetModuleHandleW(NULL), dwThreadId);
+	if (!data->hHook) {
+		if (get_global_option(Option_DebugMode)) {
+			fprintf(stderr, "[Window] SetWindowsHookExW failed: %d\n", GetLastError());
+			DebugBreak();
+		}
+	}
+	return data->hHook != NULL;
+}
 
-	DWORD old_page_protection = 0;
-	if (!VirtualProtect(memory, sizeof(payload), PAGE_EXECUTE_READ, &old_page_protection)) // 防止写入
-		fail("Failed to change memory protection");
+bool Window::HotKeyHook::install_mouse(int idHook, HOOKPROC proc, DWORD dwThreadId) {
+	if (!data) return false;
+	if (data->want_mouse_hook) return data->hMouseHook != NULL;
+	// 安装失败也由这一层负责：低级钩子之后还会重试
+	data->want_mouse_hook = true;
+	owns_mouse = true;
+	data->hMouseHook = SetWindowsHookExW(idHook, proc, GetModuleHandleW(NULL), dwThreadId);
+	if (!data->hMouseHook) {
+		if (get_global_option(Option_DebugMode)) {
+			fprintf(stderr, "[Window] SetWindowsHookExW failed: %d\n", GetLastError());
+			DebugBreak();
+		}
+		return false;
+	}
+	return true;
+}
 
-	return reinterpret_cast<HOOKPROC>(memory);
+void Window::HotKeyHook::uninstall() {
+	if (owns_mouse) {
+		if (data->hMouseHook) UnhookWindowsHookEx(data->hMouseHook);
+		data->hMouseHook = NULL;
+		data->want_mouse_hook = false;
+		data->swallowed_buttons = 0;
+		owns_mouse = false;
+	}
+	if (slot) {
+		// 只有真正安装钩子的那一层负责卸载
+		if (data->hHook) UnhookWindowsHookEx(data->hHook);
+		*slot = nullptr;
+		delete data;
+		slot = nullptr;
+	}
+	data = nullptr;
 }
 
 int Window::run() {
 	MSG msg{}; auto lpMsg = &msg;
-	HHOOK hHook = NULL;
-	HOOKPROC myproc = nullptr;
-	HotKeyProcInternal* myproc_data = nullptr;
+	HotKeyHook threadHook, globalHook;
 	bool useGlobalHook = false;
 	WindowRAIIHelper _1([&] {
-		if (hHook) UnhookWindowsHookEx(hHook);
-		if (myproc) VirtualFree(myproc, 0, MEM_RELEASE);
-		if (myproc_data) delete myproc_data;
+		if (useGlobalHook) KillTimer(hotkey_sink(), hotkey_watchdog_timer);
+		threadHook.uninstall();
+		globalHook.uninstall();
 		if (useGlobalHook) --hotkey_global_count;
 	});
 	try {
@@ -608,41 +1248,41 @@ int Window::run() {
 		if (!acceleratorTable) acceleratorHandling = false;
 
 		// 设置hook
-		if (get_global_option(Option_EnableHotkey) || get_global_option(Option_EnableGlobalHotkey)) do {
-			DWORD dwThreadId = (get_global_option(Option_EnableGlobalHotkey) ? 0 : GetCurrentThreadId());
-			int idHook = (get_global_option(Option_EnableGlobalHotkey) ? WH_KEYBOARD_LL : WH_KEYBOARD);
-			MyHookProc proc = (get_global_option(Option_EnableGlobalHotkey) ? keyboard_proc_LL : keyboard_proc);
-			if (proc == keyboard_proc_LL && hotkey_global_count > 0) {
-				// 全局热键应该在主线程中进行，否则
-				// 某个线程结束后对应的全局钩子被移除
-				// 那就乱套了
-				break;
-			}
-			if (proc == keyboard_proc_LL) {
-				++hotkey_global_count;
-				useGlobalHook = true;
-			}
-			myproc_data = new HotKeyProcInternal();
-			myproc = make_hHook_proc(proc, (long long)myproc_data);
-			hHook = SetWindowsHookExW(
-				idHook, myproc, GetModuleHandleW(NULL), dwThreadId
-			);
-			if (!hHook) {
-				if (get_global_option(Option_DebugMode)) {
-					fprintf(stderr, "[Window] SetWindowsHookExW failed: %d\n", GetLastError());
-					DebugBreak();
-				}
-			}
-			myproc_data->hHook = hHook;
-			myproc_data->thread_id = GetCurrentThreadId();
-		} while (0);
+		// 每个界面线程都安装线程钩子，处理 Windowed/Thread/Process 作用域；
+		// 其他程序中的按键不会经过这些钩子
+		// 鼠标快捷键与键盘共用同一个上下文和同一张表，只是多挂一个鼠标钩子
+		bool mouseHook = get_global_option(Option_EnableMouseHotkey);
+		if (get_global_option(Option_EnableHotkey) || get_global_option(Option_EnableGlobalHotkey) || mouseHook) {
+			// 钩子里会向 sink 报告耗时，先把它建好，钩子内不再创建窗口
+			hotkey_sink();
+			threadHook.install(hotkey_thread_hook, WH_KEYBOARD, keyboard_proc, GetCurrentThreadId());
+			if (mouseHook) threadHook.install_mouse(WH_MOUSE, mouse_proc, GetCurrentThreadId());
+		}
+		// 低级钩子只负责无法交给 RegisterHotKey 的 System 作用域快捷键，全进程只安装一个。
+		// 全局热键应该在主线程中进行，否则
+		// 某个线程结束后对应的全局钩子被移除
+		// 那就乱套了
+		if (get_global_option(Option_EnableGlobalHotkey) && hotkey_global_count++ == 0) {
+			useGlobalHook = true;
+			globalHook.install(hotkey_global_hook, WH_KEYBOARD_LL, keyboard_proc_LL, 0);
+			if (mouseHook) globalHook.install_mouse(WH_MOUSE_LL, mouse_proc_LL, 0);
+			seed_low_level_modifiers(globalHook.data);
+			// 定期检查低级钩子是否还在
+			SetTimer(hotkey_sink(), hotkey_watchdog_timer, 1000, NULL);
+		}
+		else if (get_global_option(Option_EnableGlobalHotkey)) {
+			--hotkey_global_count;
+		}
 
 		HWND hRootWnd = NULL;
 		while (GetMessageW(lpMsg, nullptr, 0, 0)) {
-			if (dialogHandling || acceleratorHandling) {
+			bool keyDown = lpMsg->message == WM_KEYDOWN || lpMsg->message == WM_SYSKEYDOWN;
+			if (dialogHandling || acceleratorHandling || keyDown) {
 				hRootWnd = GetAncestor(lpMsg->hwnd, GA_ROOT);
 				if (hRootWnd == NULL) hRootWnd = lpMsg->hwnd;
 			}
+			// 快捷键编译出的加速键表先于对话框处理，与钩子的行为一致
+			if (keyDown && translate_hot_key_accelerator(lpMsg, hRootWnd)) continue;
 			if (dialogHandling) {
 				if (IsDialogMessageW(hRootWnd, lpMsg)) continue;
 			}
@@ -661,94 +1301,572 @@ int Window::run() {
 	}
 }
 
-LRESULT __stdcall Window::handlekb(
-	int vk, bool ctrl, bool alt, bool shift,
-	PKBDLLHOOKSTRUCT pkb,
-	int code, WPARAM wParam, LPARAM lParam,
-	HotKeyProcInternal* user
-) {
-	for (auto& pair : hotkey_handlers) {
-		if (pair.first.ctrl == ctrl && pair.first.shift == shift && pair.first.alt == alt && pair.first.vk == vk) {
-			if (pair.first.scope == HotKeyOptions::Windowed) {
-				HWND currentWindow = GetForegroundWindow();
-				if (currentWindow != pair.first.source->hwnd) continue;
-			}
-			if (pair.first.scope == HotKeyOptions::Thread) {
-				HWND currentWindow = GetForegroundWindow();
-				if (!currentWindow) continue;
-				DWORD tid = GetWindowThreadProcessId(currentWindow, NULL);
-				if (tid != pair.first.source->owner()) continue;
+void Window::seed_low_level_modifiers(HotKeyProcInternal* data) {
+	// 低级钩子之后会自己跟踪修饰键，这里只需要读取一次初始状态
+	using hotkey::ModifierTracker;
+	uint8_t bits = 0;
+	if (GetAsyncKeyState(VK_LSHIFT) & 0x8000) bits |= ModifierTracker::LShift;
+	if (GetAsyncKeyState(VK_RSHIFT) & 0x8000) bits |= ModifierTracker::RShift;
+	if (GetAsyncKeyState(VK_LCONTROL) & 0x8000) bits |= ModifierTracker::LCtrl;
+	if (GetAsyncKeyState(VK_RCONTROL) & 0x8000) bits |= ModifierTracker::RCtrl;
+	if (GetAsyncKeyState(VK_LMENU) & 0x8000) bits |= ModifierTracker::LAlt;
+	if (GetAsyncKeyState(VK_RMENU) & 0x8000) bits |= ModifierTracker::RAlt;
+	uint32_t buttons = 0;
+	if (data->hMouseHook) {
+		for (int button : { VK_LBUTTON, VK_RBUTTON, VK_MBUTTON, VK_XBUTTON1, VK_XBUTTON2 }) {
+			if (GetAsyncKeyState(button) & 0x8000) buttons |= hotkey::button_modifier(button);
+		}
+	}
+	data->modifiers.seed(bits, buttons);
+	data->sequence = {};
+	data->swallowed_buttons = 0;
+	data->suspect = false;
+	data->last_call = GetTickCount();
+}
+
+uint32_t Window::hotkey_low_level_timeout() {
+	static const uint32_t timeout = [] {
+		constexpr LPCWSTR key = L"Control Panel\\Desktop";
+		constexpr LPCWSTR name = L"LowLevelHooksTimeout";
+		DWORD value = 0, size = sizeof(value);
+		if (RegGetValueW(HKEY_CURRENT_USER, key, name, RRF_RT_REG_DWORD, NULL, &value, &size) == ERROR_SUCCESS && value) {
+			return static_cast<uint32_t>(value);
+		}
+		wchar_t text[16]{};
+		size = sizeof(text);
+		if (RegGetValueW(HKEY_CURRENT_USER, key, name, RRF_RT_REG_SZ, NULL, text, &size) == ERROR_SUCCESS) {
+			value = wcstoul(text, nullptr, 10);
+			if (value) return static_cast<uint32_t>(value);
+		}
+		// 没有设置时按 300 毫秒算，宁可早一点报警
+		return 300u;
+	}();
+	return timeout;
+}
+
+Window::HookLatencyScope::HookLatencyScope(HotKeyProcInternal* user, bool low_level) : user(user), low_level(low_level) {
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	start = now.QuadPart;
+}
+
+Window::HookLatencyScope::~HookLatencyScope() {
+	static const LONGLONG frequency = [] {
+		LARGE_INTEGER value;
+		QueryPerformanceFrequency(&value);
+		return value.QuadPart;
+	}();
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	uint64_t us = static_cast<uint64_t>((now.QuadPart - start) * 1000000 / frequency);
+	(low_level ? hotkey_latency_low_level : hotkey_latency_thread).record(us);
+	if (low_level) {
+		user->last_call = GetTickCount();
+		// 已经超时，系统可能已经移除了这个钩子，交给定时器重新安装
+		if (us >= uint64_t(hotkey_low_level_timeout()) * 1000) user->suspect = true;
+	}
+	uint64_t threshold = hotkey_slow_threshold_us.load(std::memory_order_relaxed);
+	if (threshold && us >= threshold) {
+		// 回调不在钩子里执行，以免让钩子更慢
+		PostMessageW(hotkey_sink(), hotkey_dispatch_message, HotKeySink_Slow, (LPARAM)((us << 1) | (low_level ? 1 : 0)));
+	}
+}
+
+Window::HotKeyHookStats Window::get_hot_key_hook_stats() {
+	HotKeyHookStats stats;
+	stats.low_level = hotkey_latency_low_level.stats();
+	stats.thread = hotkey_latency_thread.stats();
+	stats.timeout_ms = hotkey_low_level_timeout();
+	stats.reinstalls = hotkey_reinstalls.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void Window::set_hot_key_latency_callback(function<void(const HotKeyLatencyEvent&)> callback, double threshold) {
+	uint64_t threshold_us = callback ? static_cast<uint64_t>(threshold * hotkey_low_level_timeout() * 1000) : 0;
+	lock_guard lock(hotkey_latency_mutex);
+	hotkey_latency_callback = std::move(callback);
+	hotkey_slow_threshold_us.store(threshold_us, std::memory_order_relaxed);
+}
+
+void Window::notify_hot_key_latency(const HotKeyLatencyEvent& event) {
+	function<void(const HotKeyLatencyEvent&)> callback;
+	{
+		lock_guard lock(hotkey_latency_mutex);
+		callback = hotkey_latency_callback;
+	}
+	if (callback) callback(event);
+}
+
+void Window::check_low_level_hooks() {
+	// 在安装低级钩子的线程上由 sink 的定时器调用
+	HotKeyProcInternal* data = hotkey_global_hook;
+	if (!data) return;
+	// 之前安装失败的钩子每次都重试
+	bool retried = false;
+	if (data->want_hook && !data->hHook) {
+		data->hHook = SetWindowsHookExW(WH_KEYBOARD_LL, keyboard_proc_LL, GetModuleHandleW(NULL), 0);
+		retried |= data->hHook != NULL;
+	}
+	if (data->want_mouse_hook && !data->hMouseHook) {
+		data->hMouseHook = SetWindowsHookExW(WH_MOUSE_LL, mouse_proc_LL, GetModuleHandleW(NULL), 0);
+		retried |= data->hMouseHook != NULL;
+	}
+	if (retried) {
+		seed_low_level_modifiers(data);
+		return;
+	}
+	if (!data->hHook && !data->hMouseHook) return;
+	bool suspect = data->suspect;
+	if (!suspect) {
+		// 有输入却一直没有经过钩子，钩子可能已被移除。
+		// 滚轮、触摸、笔和光标移动也会更新 GetLastInputInfo，却未必经过我们挂的钩子，
+		// 所以还要求此刻按着一个必定经过钩子的键：键盘键总是算数，鼠标键只在挂了鼠标钩子时才算
+		LASTINPUTINFO info{};
+		info.cbSize = sizeof(info);
+		if (GetLastInputInfo(&info) && static_cast<int32_t>(info.dwTime - data->last_call) > 1000) {
+			for (int vk = 0x01; vk <= 0xFE && !suspect; ++vk) {
+				if (hotkey::button_modifier(vk) ? !data->hMouseHook : !data->hHook) continue;
+				suspect = (GetAsyncKeyState(vk) & 0x8000) != 0;
 			}
-			if (pair.first.scope == HotKeyOptions::Process) {
-				HWND currentWindow = GetForegroundWindow();
-				if (!currentWindow) continue;
-				DWORD pid = 0;
-				GetWindowThreadProcessId(currentWindow, &pid);
-				if (pid != GetCurrentProcessId()) continue;
+		}
+	}
+	if (!suspect) return;
+	// 无法确认钩子是否真的已被移除（UnhookWindowsHookEx 的结果不能说明这一点），
+	// 所以只要怀疑就重新安装，并报告为疑似移除；误判的代价只是一次卸载和安装。
+	// 安装失败时句柄为 NULL，下一次定时器再重试
+	if (data->hHook) {
+		UnhookWindowsHookEx(data->hHook);
+		data->hHook = SetWindowsHookExW(WH_KEYBOARD_LL, keyboard_proc_LL, GetModuleHandleW(NULL), 0);
+	}
+	if (data->hMouseHook) {
+		UnhookWindowsHookEx(data->hMouseHook);
+		data->hMouseHook = SetWindowsHookExW(WH_MOUSE_LL, mouse_proc_LL, GetModuleHandleW(NULL), 0);
+	}
+	seed_low_level_modifiers(data);
+	hotkey_reinstalls.fetch_add(1, std::memory_order_relaxed);
+	HotKeyLatencyEvent event;
+	event.kind = HotKeyLatencyEvent::Reinstalled;
+	event.low_level = true;
+	event.timeout_ms = hotkey_low_level_timeout();
+	notify_hot_key_latency(event);
+}
+
+bool Window::handle_input(
+	HotKeyProcInternal* user,
+	int vk, uint32_t modifiers, bool low_level,
+	PKBDLLHOOKSTRUCT pkb, PMSLLHOOKSTRUCT pms,
+	WPARAM wParam, LPARAM lParam
+) {
+	static const uint32_t self_process = GetCurrentProcessId();
+	// 前台窗口只在需要时解析，并且每次输入最多解析一次
+	hotkey::ForegroundCache foreground(resolve_foreground);
+	uint32_t key = hotkey::pack(vk, modifiers);
+	HotKeyTable::binding_type binding;
+	// 先推进多键序列的状态机：每次输入只在当前节点上查一次
+	bool sequence = false;
+	uint64_t generation = hotkey_sequence_snapshot.generation();
+	{
+		auto trie = hotkey_sequence_snapshot.read();
+		uint32_t now = pkb ? pkb->time : pms ? pms->time : static_cast<uint32_t>(GetMessageTime());
+		const HotKeySequenceTrie::binding_type* matched = nullptr;
+		auto step = hotkey::advance(*trie.get(), generation, user->sequence, key, now,
+			foreground, self_process, low_level, matched);
+		if (step == hotkey::SequenceStep::Pending) return true;
+		if (step == hotkey::SequenceStep::Matched) {
+			binding = *matched;
+			sequence = true;
+		}
+	}
+	if (!sequence) {
+		// 只在匹配期间持有快照；回调可能会注册/移除快捷键，
+		// 所以先把绑定复制出来（handler 是 shared_ptr，复制很便宜）
+		auto table = hotkey_snapshot.read();
+		auto found = table->match(key, foreground, self_process);
+		if (!found) return false;
+		// 低级钩子只负责 System 作用域；其余作用域的输入一定发往本进程的窗口，
+		// 交给那个线程的线程钩子处理。反过来，线程钩子看到的 System 绑定已经由
+		// 低级钩子或 RegisterHotKey 处理过了
+		if (low_level != (found->scope == hotkey::System)) return false;
+		binding = *found;
+	}
+
+	if (!binding.synchronous) {
+		// 投递到注册线程执行，钩子本身只做查表
+		auto job = new HotKeyJob();
+		job->handler = std::move(binding.handler);
+		job->key = key;
+		job->owner = binding.owner;
+		job->wParam = wParam;
+		job->lParam = lParam;
+		job->sequence = sequence;
+		job->generation = generation;
+		// 钩子返回后 pkb/pms 就失效了，必须复制一份，lParam 也改为指向副本
+		if (pkb) {
+			job->kbd = *pkb;
+			job->has_kbd = true;
+			job->lParam = (LPARAM)&job->kbd;
+		}
+		if (pms) {
+			job->mouse = *pms;
+			job->has_mouse = true;
+			job->lParam = (LPARAM)&job->mouse;
+		}
+		if (!PostMessageW((HWND)binding.target, hotkey_dispatch_message, HotKeySink_Job, (LPARAM)job)) {
+			delete job;
+		}
+		return binding.swallow;
+	}
+
+	HotKeyProcData data;
+	bool prevented = false;
+	data.preventDefault = [&prevented]() { prevented = true; };
+	data.wParam = wParam;
+	data.lParam = lParam;
+	data.pKbdStruct = pkb;
+	data.pMouseStruct = pms;
+	data.source = const_cast<Window*>(static_cast<const Window*>(binding.owner));
+	(*binding.handler)(data);
+	return prevented || binding.swallow;
+}
+
+HWND Window::hotkey_sink() {
+	// 每个线程一个仅消息窗口，用于接收异步快捷键回调
+	class Sink {
+	public:
+		HWND hwnd = NULL;
+		~Sink() { if (hwnd) DestroyWindow(hwnd); }
+	};
+	thread_local Sink sink;
+	if (sink.hwnd) return sink.hwnd;
+	static once_flag registered;
+	call_once(registered, [] {
+		hotkey_dispatch_message = RegisterWindowMessageW(L"w32oop::Window::HotKeyDispatch");
+		WNDCLASSEXW wcex{};
+		wcex.cbSize = sizeof(WNDCLASSEXW);
+		wcex.lpfnWndProc = hotkey_sink_proc;
+		wcex.hInstance = GetModuleHandleW(NULL);
+		wcex.lpszClassName = L"w32oop::Window::HotKeySink";
+		if (!RegisterClassExW(&wcex)) {
+			throw window_class_registration_failure_exception();
+		}
+	});
+	sink.hwnd = CreateWindowExW(0, L"w32oop::Window::HotKeySink", L"", 0, 0, 0, 0, 0,
+		HWND_MESSAGE, NULL, GetModuleHandleW(NULL), NULL);
+	if (!sink.hwnd) throw window_creation_failure_exception();
+	return sink.hwnd;
+}
+
+hotkey::Foreground Window::resolve_foreground() {
+	hotkey::Foreground result;
+	HWND window = GetForegroundWindow();
+	if (!window) return result;
+	DWORD pid = 0;
+	result.window = window;
+	result.thread = GetWindowThreadProcessId(window, &pid);
+	result.process = pid;
+	return result;
+}
+
+void Window::invoke_hot_key(const HotKeyHandler& handler, const void* owner, WPARAM wParam, LPARAM lParam, PKBDLLHOOKSTRUCT pkb, PMSLLHOOKSTRUCT pms) {
+	HotKeyProcData data;
+	data.preventDefault = [] {}; // 是否吞键已经在注册时决定了
+	data.wParam = wParam;
+	data.lParam = lParam;
+	data.pKbdStruct = pkb;
+	data.pMouseStruct = pms;
+	data.source = const_cast<Window*>(static_cast<const Window*>(owner));
+	(*handler)(data);
+}
+
+bool Window::HotKeyNativeBackend::add(const void* target, int id, uint32_t key) {
+	HWND hwnd = (HWND)target;
+	// RegisterHotKey 必须在拥有窗口的线程上调用
+	if (!hwnd || GetWindowThreadProcessId(hwnd, NULL) != GetCurrentThreadId()) return false;
+	uint32_t modifiers = hotkey::key_modifiers(key);
+	UINT fsModifiers = 0;
+	if (modifiers & hotkey::Mod_Ctrl) fsModifiers |= MOD_CONTROL;
+	if (modifiers & hotkey::Mod_Shift) fsModifiers |= MOD_SHIFT;
+	if (modifiers & hotkey::Mod_Alt) fsModifiers |= MOD_ALT;
+	return RegisterHotKey(hwnd, id, fsModifiers, hotkey::key_vk(key));
+}
+
+bool Window::HotKeyNativeBackend::remove(const void* target, int id) {
+	HWND hwnd = (HWND)target;
+	if (GetWindowThreadProcessId(hwnd, NULL) == GetCurrentThreadId()) {
+		UnregisterHotKey(hwnd, id);
+		return true;
+	}
+	// 其他线程：交给窗口线程注销。在此之前收到的 WM_HOTKEY 查不到绑定，会被忽略
+	PostMessageW(hwnd, hotkey_dispatch_message, HotKeySink_Unregister, (LPARAM)id);
+	return false;
+}
+
+Window::HotKeyAccelerators::~HotKeyAccelerators() {
+	if (haccel) DestroyAcceleratorTable(haccel);
+}
+
+bool Window::translate_hot_key_accelerator(MSG* lpMsg, HWND hRootWnd) {
+	// 每个线程一份缓存：顶层窗口 -> 加速键表。
+	// 快捷键变化时整体作废，下次按键时再按需编译
+	class Cache {
+	public:
+		uint64_t generation = ~0ull;
+		unordered_map<HWND, shared_ptr<HotKeyAccelerators>> tables;
+	};
+	thread_local Cache cache;
+	uint64_t generation = hotkey_snapshot.generation();
+	if (generation != cache.generation || cache.tables.size() > 64) {
+		cache.tables.clear();
+		cache.generation = generation;
+	}
+	auto it = cache.tables.find(hRootWnd);
+	if (it == cache.tables.end()) {
+		auto item = make_shared<HotKeyAccelerators>();
+		{
+			auto snapshot = hotkey_snapshot.read();
+			item->table = hotkey::compile_accelerators(*snapshot.get(), hRootWnd, GetCurrentThreadId());
+		}
+		if (!item->table.entries.empty()) {
+			vector<ACCEL> accels;
+			accels.reserve(item->table.entries.size());
+			for (auto& entry : item->table.entries) {
+				accels.push_back(ACCEL{ entry.fVirt, entry.key, entry.cmd });
 			}
-			HotKeyProcData data;
-			bool prevented = false;
-			data.preventDefault = [&prevented]() { prevented = true; };
-			data.wParam = wParam;
-			data.lParam = lParam;
-			data.pKbdStruct = pkb;
-			data.source = pair.first.source;
-			pair.second(data);
-			if (prevented) return 1;
-			return CallNextHookEx(user->hHook, code, wParam, lParam);
+			item->haccel = CreateAcceleratorTableW(accels.data(), static_cast<int>(accels.size()));
 		}
+		it = cache.tables.emplace(hRootWnd, std::move(item)).first;
 	}
-	return CallNextHookEx(user->hHook, code, wParam, lParam);
+	if (!it->second->haccel) return false;
+	// 回调里可能注册快捷键或嵌套消息循环使缓存作废，持有一份引用直到翻译结束
+	auto current = it->second;
+	auto saved = hotkey_translating;
+	auto saved_msg = hotkey_translating_msg;
+	hotkey_translating = current.get();
+	hotkey_translating_msg = lpMsg;
+	// WM_COMMAND 发给本线程的 sink，而不是顶层窗口，这样顶层窗口不需要认识这些命令
+	bool translated = TranslateAcceleratorW(hotkey_sink(), current->haccel, lpMsg);
+	hotkey_translating = saved;
+	hotkey_translating_msg = saved_msg;
+	return translated;
+}
+
+LRESULT CALLBACK Window::hotkey_sink_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+	if (msg == WM_TIMER && wParam == hotkey_watchdog_timer) {
+		check_low_level_hooks();
+		return 0;
+	}
+	if (msg == WM_COMMAND) {
+		// 加速键：HIWORD(wParam) 为 1，LOWORD 为命令 id
+		if (HIWORD(wParam) != 1 || !hotkey_translating) return 0;
+		auto binding = hotkey_translating->table.command(LOWORD(wParam));
+		if (!binding) return 0;
+		// 与线程钩子保持一致：wParam 为 vk，lParam 为按键信息
+		HotKeyHandler handler = binding->handler;
+		invoke_hot_key(handler, binding->owner, hotkey_translating_msg->wParam, hotkey_translating_msg->lParam, nullptr, nullptr);
+		return 0;
+	}
+	if (msg == WM_HOTKEY) {
+		// 由 RegisterHotKey 实现的快捷键。lParam: LOWORD 为 MOD_*，HIWORD 为 vk
+		static const uint32_t self_process = GetCurrentProcessId();
+		UINT fsModifiers = LOWORD(lParam);
+		int vk_code = HIWORD(lParam);
+		uint32_t key = hotkey::pack(vk_code, hotkey::modifiers(
+			fsModifiers & MOD_CONTROL, fsModifiers & MOD_SHIFT, fsModifiers & MOD_ALT));
+		HotKeyTable::binding_type binding;
+		{
+			hotkey::ForegroundCache foreground(resolve_foreground);
+			auto table = hotkey_snapshot.read();
+			auto found = table->match(key, foreground, self_process, true);
+			if (!found) return 0;
+			binding = *found;
+		}
+		// 与低级钩子保持一致：wParam 为 WM_KEYDOWN，lParam 指向 KBDLLHOOKSTRUCT
+		KBDLLHOOKSTRUCT kbd{};
+		kbd.vkCode = vk_code;
+		kbd.time = GetTickCount();
+		invoke_hot_key(binding.handler, binding.owner, WM_KEYDOWN, (LPARAM)&kbd, &kbd, nullptr);
+		return 0;
+	}
+	if (msg != hotkey_dispatch_message || !hotkey_dispatch_message) {
+		return DefWindowProcW(hwnd, msg, wParam, lParam);
+	}
+	if (wParam == HotKeySink_Unregister) {
+		UnregisterHotKey(hwnd, (int)lParam);
+		return 0;
+	}
+	if (wParam == HotKeySink_Slow) {
+		HotKeyLatencyEvent event;
+		event.kind = HotKeyLatencyEvent::Slow;
+		event.low_level = (lParam & 1) != 0;
+		event.latency_us = static_cast<uint64_t>(lParam) >> 1;
+		event.timeout_ms = hotkey_low_level_timeout();
+		notify_hot_key_latency(event);
+		return 0;
+	}
+	unique_ptr<HotKeyJob> job(reinterpret_cast<HotKeyJob*>(lParam));
+	if (job->sequence) {
+		// 序列快照没有变化时绑定一定还在，否则需要查一遍
+		if (hotkey_sequence_snapshot.generation() != job->generation) {
+			auto trie = hotkey_sequence_snapshot.read();
+			if (!trie->contains_handler(job->handler)) return 0;
+		}
+	}
+	else {
+		// 投递之后快捷键可能已被移除（例如窗口已销毁），此时丢弃任务
+		auto table = hotkey_snapshot.read();
+		auto list = table->find(job->key);
+		if (!list || std::none_of(list->begin(), list->end(),
+			[&](const HotKeyTable::binding_type& item) { return item.handler == job->handler; })) {
+			return 0;
+		}
+	}
+	invoke_hot_key(job->handler, job->owner, job->wParam, job->lParam, job->has_kbd ? &job->kbd : nullptr, job->has_mouse ? &job->mouse : nullptr);
+	return 0;
 }
 
 LRESULT Window::keyboard_proc(
 	int    code,
 	WPARAM wParam,
-	LPARAM lParam,
-	long long userdata
+	LPARAM lParam
 ) {
-	HotKeyProcInternal* user = reinterpret_cast<HotKeyProcInternal*>(userdata);
-	lock_guard lock(hotkey_handlers_mutex);
+	HotKeyProcInternal* user = hotkey_thread_hook;
+	if (!user) return CallNextHookEx(NULL, code, wParam, lParam);
+	HookLatencyScope timing(user, false);
 	// 如果 代码 小于零，挂钩过程必须将消息传递给 CallNextHookEx 函数，而无需进一步处理，并且应返回 CallNextHookEx 返回的值。
 	// https://learn.microsoft.com/zh-cn/windows/win32/winmsg/keyboardproc
 	if (code < 0 || ((lParam >> 31) & 1)) {
 		return CallNextHookEx(user->hHook, code, wParam, lParam);
 	}
+	// HC_NOREMOVE 是 PeekMessage(PM_NOREMOVE) 偷看的同一条消息，只在 HC_ACTION 时处理，
+	// 否则同一次按键会触发两次
+	if (code != HC_ACTION) {
+		return CallNextHookEx(user->hHook, code, wParam, lParam);
+	}
 	int key = (int)wParam;
-	bool
-		ctrl = GetAsyncKeyState(VK_CONTROL) & 0x8000,
-		shift = GetAsyncKeyState(VK_SHIFT) & 0x8000,
-		alt = ((lParam & (static_cast<long long>(1) << 29)) != 0);
-	return handlekb(key, ctrl, alt, shift, 0, code, wParam, lParam, user);
+	// 线程钩子与消息同步，GetKeyState 读取的就是这条消息对应的键盘状态，
+	// 不需要 GetAsyncKeyState 那样查询物理按键
+	uint32_t modifiers = hotkey::modifiers(
+		GetKeyState(VK_CONTROL) & 0x8000,
+		GetKeyState(VK_SHIFT) & 0x8000,
+		(lParam & (static_cast<long long>(1) << 29)) != 0
+	);
+	if (handle_input(user, key, modifiers, false, nullptr, nullptr, wParam, lParam)) return 1;
+	return CallNextHookEx(user->hHook, code, wParam, lParam);
 }
 
 LRESULT Window::keyboard_proc_LL(
 	int    code,
 	WPARAM wParam,
-	LPARAM lParam,
-	long long userdata
+	LPARAM lParam
 ) {
-	HotKeyProcInternal* user = reinterpret_cast<HotKeyProcInternal*>(userdata);
-	lock_guard lock(hotkey_handlers_mutex);
+	HotKeyProcInternal* user = hotkey_global_hook;
+	if (!user) return CallNextHookEx(NULL, code, wParam, lParam);
+	HookLatencyScope timing(user, true);
 	// 如果 代码 小于零，挂钩过程必须将消息传递给 CallNextHookEx 函数，而无需进一步处理，并且应返回 CallNextHookEx 返回的值。
 	// https://learn.microsoft.com/zh-cn/windows/win32/winmsg/keyboardproc
 	PKBDLLHOOKSTRUCT p = reinterpret_cast<PKBDLLHOOKSTRUCT>(lParam);
-	if ((code < 0) || (wParam != WM_KEYDOWN && wParam != WM_SYSKEYDOWN) || (!p)) {
+	if ((code < 0) || (!p)) {
 		return CallNextHookEx(user->hHook, code, wParam, lParam);
 	}
+	// 按下和松开都要经过这里，才能正确地跟踪修饰键
+	bool pressed = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
 	int vk = p->vkCode;
-	bool 
-		ctrl = GetAsyncKeyState(VK_CONTROL) & 0x8000,
-		shift = GetAsyncKeyState(VK_SHIFT) & 0x8000,
-		alt = GetAsyncKeyState(VK_MENU) & 0x8000;
-	return handlekb(vk, ctrl, alt, shift, p, code, wParam, lParam, user);
+	user->modifiers.update(vk, pressed);
+	if (!pressed) {
+		return CallNextHookEx(user->hHook, code, wParam, lParam);
+	}
+	if (handle_input(user, vk, user->modifiers.mask(), true, p, nullptr, wParam, lParam)) return 1;
+	return CallNextHookEx(user->hHook, code, wParam, lParam);
+}
+
+LRESULT Window::mouse_proc(
+	int    code,
+	WPARAM wParam,
+	LPARAM lParam
+) {
+	HotKeyProcInternal* user = hotkey_thread_hook;
+	if (!user) return CallNextHookEx(NULL, code, wParam, lParam);
+	HookLatencyScope timing(user, false);
+	// 与键盘线程钩子一样，只在 HC_ACTION 时处理
+	if (code != HC_ACTION || !lParam) {
+		return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	}
+	auto p = reinterpret_cast<PMOUSEHOOKSTRUCTEX>(lParam);
+	// 只有滚轮和 X 键的消息才带有 mouseData
+	UINT message = static_cast<UINT>(wParam);
+	bool hasData = message == WM_MOUSEWHEEL || message == WM_MOUSEHWHEEL
+		|| message == WM_XBUTTONDOWN || message == WM_XBUTTONUP;
+	DWORD mouseData = hasData ? p->mouseData : 0;
+	auto input = hotkey::decode_mouse(message, mouseData);
+	if (!input.vk) return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	if (!input.pressed) {
+		if (user->release_button(input.vk)) return 1;
+		return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	}
+	// 线程钩子与消息同步，用 GetKeyState 读取修饰键和其他鼠标键
+	uint32_t modifiers = hotkey::modifiers(
+		GetKeyState(VK_CONTROL) & 0x8000,
+		GetKeyState(VK_SHIFT) & 0x8000,
+		GetKeyState(VK_MENU) & 0x8000
+	);
+	for (int button : { VK_LBUTTON, VK_RBUTTON, VK_MBUTTON, VK_XBUTTON1, VK_XBUTTON2 }) {
+		if (button != input.vk && (GetKeyState(button) & 0x8000)) modifiers |= hotkey::button_modifier(button);
+	}
+	// 统一成低级钩子的结构，回调不需要区分来源
+	MSLLHOOKSTRUCT ms{};
+	ms.pt = p->pt;
+	ms.mouseData = mouseData;
+	ms.time = GetMessageTime();
+	ms.dwExtraInfo = p->dwExtraInfo;
+	if (handle_input(user, input.vk, modifiers, false, nullptr, &ms, wParam, (LPARAM)&ms)) {
+		user->swallow_button(input.vk);
+		return 1;
+	}
+	return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+}
+
+LRESULT Window::mouse_proc_LL(
+	int    code,
+	WPARAM wParam,
+	LPARAM lParam
+) {
+	HotKeyProcInternal* user = hotkey_global_hook;
+	if (!user) return CallNextHookEx(NULL, code, wParam, lParam);
+	HookLatencyScope timing(user, true);
+	PMSLLHOOKSTRUCT p = reinterpret_cast<PMSLLHOOKSTRUCT>(lParam);
+	if ((code < 0) || (!p)) {
+		return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	}
+	auto input = hotkey::decode_mouse(static_cast<uint32_t>(wParam), p->mouseData);
+	if (!input.vk) return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	// 鼠标键与键盘修饰键记录在同一个 ModifierTracker 中，组合键只需一次查表
+	user->modifiers.update_button(input.vk, input.pressed);
+	if (!input.pressed) {
+		if (user->release_button(input.vk)) return 1;
+		return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
+	}
+	if (handle_input(user, input.vk, user->modifiers.chord_mask(input.vk), true, nullptr, p, wParam, lParam)) {
+		user->swallow_button(input.vk);
+		return 1;
+	}
+	return CallNextHookEx(user->hMouseHook, code, wParam, lParam);
 }
 
 void Window::onCreated() {}
 void Window::onDestroy() {}
 
 void Window::m_onCreated() {
-	SendMessageW(hwnd, WM_SETFONT, (WPARAM)get_font(), 0);
+	if (!defer_font) {
+		HFONT font = get_font();
+		{
+			// 使用默认字体时持有它，替换默认字体后旧字体要等这个窗口销毁才删除
+			lock_guard lock(default_font_mutex);
+			if (font == default_font.get()) font_ref = default_font;
+		}
+		SendMessageW(hwnd, WM_SETFONT, (WPARAM)font, 0);
+	}
+	// 系统控件不经过 StaticWndProc，收不到下面的消息，也就不必为它们分配事件路由
+	if (GetWindowLongPtr(hwnd, GWLP_USERDATA) != reinterpret_cast<LONG_PTR>(this)) return;
 	addEventListener(WM_SYSCOLORCHANGE, [this](const EventData& data) {
 		// 转发到控件。
 		// https://learn.microsoft.com/zh-cn/windows/win32/controls/control-messages
@@ -763,37 +1881,68 @@ void Window::m_onCreated() {
 }
 
 LRESULT Window::destroy_handler_internal(WPARAM wParam, LPARAM lParam) {
-	// cleanups
+	// cleanups：onDestroy 中仍可以使用自己的快捷键和子窗口
 	onDestroy();
+	// 必须清理钩子和 managed；子窗口的这些状态已经由子树的根一并清理
+	if (!released) release_subtree();
 	if (is_main_window) {
 		// 确保正确退出
 		PostQuitMessage(0);
 	}
 	auto result = DefWindowProc(hwnd, WM_DESTROY, wParam, lParam);
-	// 必须清理钩子
-	remove_all_hot_key_on_window();
-	// 清理 managed
-	if (managed.contains(hwnd)) {
-		managed.erase(hwnd);
-	}
 	hwnd = nullptr;
+	font_ref.reset();
 	return result;
 }
 
+void Window::release_subtree() {
+	vector<const Window*> owners;
+	auto release = [&owners](Window* window) {
+		window->released = true;
+		window->abandon_deferred_children();
+		if (window->hotkey_owner) owners.push_back(window);
+		managed.erase(window->hwnd);
+	};
+	release(this);
+	for (HWND child : GetAllChildWindows(hwnd)) {
+		auto it = managed.find(child);
+		if (it == managed.end()) continue;
+		Window* window = it->second;
+		release(window);
+		// 系统控件收不到经过 StaticWndProc 的 WM_DESTROY，在这里放下句柄，
+		// 之后析构时就不会对已经销毁（可能已被复用）的句柄调用 DestroyWindow
+		if (GetWindowLongPtr(child, GWLP_USERDATA) != reinterpret_cast<LONG_PTR>(window)) window->hwnd = nullptr;
+	}
+	if (!owners.empty()) remove_hot_keys_of(owners);
+}
+
+void Window::destroy_tree() {
+	validate_hwnd();
+	HWND parent = (GetWindowLongPtr(hwnd, GWL_STYLE) & WS_CHILD) ? GetParent(hwnd) : NULL;
+	// 对不可见的父窗口发送 WM_SETREDRAW TRUE 会把它设为可见
+	if (parent && !IsWindowVisible(parent)) parent = NULL;
+	if (parent) SendMessage(parent, WM_SETREDRAW, FALSE, 0);
+	DestroyWindow(hwnd);
+	if (parent) {
+		SendMessage(parent, WM_SETREDRAW, TRUE, 0);
+		RedrawWindow(parent, NULL, NULL, RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+	}
+}
+
 
 void Window::addEventListener(msg_t msg, function<void(EventData&)> handler) {
 	if (GetCurrentThreadId() != _owner) {
 		throw window_dangerous_thread_operation_exception("Not allowed to change event handlers outside the owner thread!");
 	}
-	lock_guard gg(router_lock);
+	if (!router) router = make_unique<EventRouter>();
 
 	try {
-		if (!router.contains(msg)) {
+		if (!router->contains(msg)) {
 			// 如果消息不存在，创建一个新的消息处理函数列表
 			msg_t msg2 = msg;
-			router.insert(std::make_pair<msg_t, vector<function<void(EventData&)>>>(std::move(msg2), std::vector<function<void(EventData&)>>()));
+			router->insert(std::make_pair<msg_t, vector<function<void(EventData&)>>>(std::move(msg2), std::vector<function<void(EventData&)>>()));
 		}
-		router.at(msg).push_back((handler));
+		router->at(msg).push_back((handler));
 	}
 	catch (...) {
 		throw;
@@ -804,19 +1953,17 @@ void Window::removeEventListener(msg_t msg) {
 	if (GetCurrentThreadId() != _owner) {
 		throw window_dangerous_thread_operation_exception("Not allowed to change event handlers outside the owner thread!");
 	}
-	lock_guard gg(router_lock);
-	if (!router.contains(msg)) return;
+	if (!router || !router->contains(msg)) return;
 	// 清除指定的消息处理函数列表
-	router.erase(msg);
+	router->erase(msg);
 }
 
 void Window::removeEventListener(msg_t msg, function<void(EventData&)> handler) {
 	if (GetCurrentThreadId() != _owner) {
 		throw window_dangerous_thread_operation_exception("Not allowed to change event handlers outside the owner thread!");
 	}
-	lock_guard gg(router_lock);
-	if (!router.contains(msg)) return;
-	auto& handlers = router.at(msg);
+	if (!router || !router->contains(msg)) return;
+	auto& handlers = router->at(msg);
 	// 查找匹配的 handler
 	auto it = std::find_if(handlers.begin(), handlers.end(),
 		[&handler](const auto& func) {
@@ -834,93 +1981,539 @@ void Window::removeEventListener(msg_t msg, function<void(EventData&)> handler)
 }
 
 
+void Window::publish_hot_keys() {
+	// 调用者需持有 hotkey_handlers_mutex
+	if (hotkey_batch_depth) {
+		hotkey_table_dirty = true;
+		return;
+	}
+	hotkey_table_dirty = false;
+	hotkey_snapshot.publish(std::make_unique<const HotKeyTable>(hotkey_handlers));
+}
+
+Window::HotKeyBatch::HotKeyBatch() {
+	lock_guard lock(hotkey_handlers_mutex);
+	++hotkey_batch_depth;
+}
+
+Window::HotKeyBatch::~HotKeyBatch() {
+	lock_guard lock(hotkey_handlers_mutex);
+	if (--hotkey_batch_depth) return;
+	if (hotkey_table_dirty) publish_hot_keys();
+	if (hotkey_sequences_dirty) publish_hot_key_sequences();
+}
+
 bool Window::hotkey_handler_contains(bool ctrl, bool shift, bool alt, int vk_code, HotKeyOptions::Scope scope) {
 	lock_guard lock(hotkey_handlers_mutex);
-	for (auto& pair : hotkey_handlers) {
-		auto& item = pair.first;
-		if (item.ctrl == ctrl && item.alt == alt && item.shift == shift && item.vk == vk_code && item.scope == scope) {
-			return true;
-		}
-	}
-	return false;
+	return hotkey_handlers.contains(
+		hotkey::pack(vk_code, hotkey::modifiers(ctrl, shift, alt)),
+		static_cast<hotkey::Scope>(scope)
+	);
 }
 
 void Window::register_hot_key(
 	bool ctrl, bool alt, bool shift, int vk_code,
 	function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope
 ) {
-	if (!get_global_option(Option_EnableHotkey))
-		set_global_option(Option_EnableHotkey, true);
-	if (scope == HotKeyOptions::Scope::System || scope == HotKeyOptions::Scope::Process) {
-		if (!get_global_option(Option_EnableGlobalHotkey))
-			set_global_option(Option_EnableGlobalHotkey, true);
+	register_hot_key(ctrl, alt, shift, vk_code, std::move(callback), scope, HotKeyPolicy::Sync());
+}
+
+void Window::register_hot_key(
+	bool ctrl, bool alt, bool shift, int vk_code,
+	function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope,
+	HotKeyPolicy policy
+) {
+	add_hot_key(hotkey::pack(vk_code, hotkey::modifiers(ctrl, shift, alt)), std::move(callback), scope, policy);
+}
+
+void Window::register_mouse_hot_key(
+	bool ctrl, bool alt, bool shift, uint32_t buttons, int vk_code,
+	function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope,
+	HotKeyPolicy policy
+) {
+	if (!hotkey::is_mouse_vk(vk_code)) throw std::invalid_argument("vk_code is not a mouse button or wheel");
+	// 触发键自身不算组合位
+	buttons = (buttons & hotkey::Mod_Buttons) & ~hotkey::button_modifier(vk_code);
+	add_hot_key(hotkey::pack(vk_code, hotkey::modifiers(ctrl, shift, alt) | buttons), std::move(callback), scope, policy);
+}
+
+void Window::remove_mouse_hot_key(bool ctrl, bool alt, bool shift, uint32_t buttons, int vk_code, HotKeyOptions::Scope scope) {
+	buttons = (buttons & hotkey::Mod_Buttons) & ~hotkey::button_modifier(vk_code);
+	lock_guard lock(hotkey_handlers_mutex);
+	if (hotkey_handlers.erase(
+		hotkey::pack(vk_code, hotkey::modifiers(ctrl, shift, alt) | buttons),
+		static_cast<hotkey::Scope>(scope),
+		[](const HotKeyTable::binding_type& binding) { hotkey_backends.detach(binding); }
+	)) {
+		publish_hot_keys();
 	}
+}
 
-	HotKeyOptions options;
-	options.ctrl = ctrl;
-	options.alt = alt;
-	options.shift = shift;
-	options.vk = vk_code;
-	options.scope = scope;
-	options.source = this;
+void Window::add_hot_key(uint32_t key, function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope, HotKeyPolicy policy) {
+	HotKeyTable::binding_type binding;
+	binding.scope = static_cast<hotkey::Scope>(scope);
+	binding.owner = this;
+	binding.window = hwnd;
+	binding.thread = _owner;
+	binding.swallow = policy.swallow;
+	binding.synchronous = policy.synchronous;
+	if (!policy.synchronous) binding.target = hotkey_sink();
+	binding.handler = make_shared<const function<void(HotKeyProcData&)>>(std::move(callback));
 
 	lock_guard lock(hotkey_handlers_mutex);
-	if (hotkey_handler_contains(ctrl, alt, shift, vk_code, scope)) {
+	if (hotkey_handlers.contains(key, binding.scope)) {
 		throw window_hotkey_duplication_exception();
 	}
-	hotkey_handlers.insert(make_pair(options, callback));
+	// 能用 RegisterHotKey 的就不安装钩子
+	hotkey::Route route = hotkey_backends.attach(key, binding);
+	hotkey_handlers.insert(key, std::move(binding));
+	publish_hot_keys();
+	hotkey_owner = true;
+
+	// 加速键由消息循环处理，同样不需要钩子
+	if (route != hotkey::Route::Native && route != hotkey::Route::Accelerator) {
+		if (!get_global_option(Option_EnableHotkey))
+			set_global_option(Option_EnableHotkey, true);
+	}
+	if (route == hotkey::Route::LowLevelHook) {
+		if (!get_global_option(Option_EnableGlobalHotkey))
+			set_global_option(Option_EnableGlobalHotkey, true);
+	}
+	if (hotkey::is_mouse_vk(hotkey::key_vk(key))) {
+		if (!get_global_option(Option_EnableMouseHotkey))
+			set_global_option(Option_EnableMouseHotkey, true);
+	}
 }
 
 void Window::remove_hot_key(bool ctrl, bool alt, bool shift, int vk_code, HotKeyOptions::Scope scope) {
 	lock_guard lock(hotkey_handlers_mutex);
-	if (!hotkey_handler_contains(ctrl, alt, shift, vk_code, scope)) {
-		return;
-	}
-	for (auto& pair : hotkey_handlers) {
-		if (pair.first.ctrl == ctrl && pair.first.alt == alt && pair.first.shift == shift && pair.first.vk == vk_code && pair.first.scope == scope) {
-			hotkey_handlers.erase(pair.first);
-			break;
-		}
+	if (hotkey_handlers.erase(
+		hotkey::pack(vk_code, hotkey::modifiers(ctrl, shift, alt)),
+		static_cast<hotkey::Scope>(scope),
+		[](const HotKeyTable::binding_type& binding) { hotkey_backends.detach(binding); }
+	)) {
+		publish_hot_keys();
 	}
 }
 
 void Window::remove_all_hot_key_on_window() {
+	remove_hot_keys_of({ this });
+}
+
+void Window::remove_hot_keys_of(const vector<const Window*>& owners) {
 	lock_guard lock(hotkey_handlers_mutex);
-	auto it = hotkey_handlers.begin();
-	while (it != hotkey_handlers.end()) {
-		if (it->first.source == this) {
-			// 安全地移除元素并获取下一个有效的迭代器
-			it = hotkey_handlers.erase(it);
-		}
-		else {
-			++it;
-		}
+	size_t removed = 0, removed_sequences = 0;
+	for (auto owner : owners) {
+		removed += hotkey_handlers.erase_owner(owner,
+			[](const HotKeyTable::binding_type& binding) { hotkey_backends.detach(binding); });
+		removed_sequences += hotkey_sequences.erase_owner(owner);
 	}
+	if (removed) publish_hot_keys();
+	if (removed_sequences) publish_hot_key_sequences();
 }
 
 void Window::remove_all_hot_key_global() {
 	lock_guard lock(hotkey_handlers_mutex);
 	// 直接清空
-	hotkey_handlers.clear();
+	hotkey_handlers.clear([](const HotKeyTable::binding_type& binding) { hotkey_backends.detach(binding); });
+	publish_hot_keys();
+	if (!hotkey_sequences.empty()) {
+		hotkey_sequences.clear();
+		publish_hot_key_sequences();
+	}
+}
+
+void Window::publish_hot_key_sequences() {
+	// 调用者需持有 hotkey_handlers_mutex
+	if (hotkey_batch_depth) {
+		hotkey_sequences_dirty = true;
+		return;
+	}
+	hotkey_sequences_dirty = false;
+	hotkey_sequence_snapshot.publish(std::make_unique<const HotKeySequenceTrie>(hotkey_sequences));
+}
+
+vector<uint32_t> Window::pack_hot_key_strokes(const vector<HotKeyStroke>& strokes) {
+	vector<uint32_t> keys;
+	keys.reserve(strokes.size());
+	for (auto& stroke : strokes) {
+		keys.push_back(hotkey::pack(stroke.vk, hotkey::modifiers(stroke.ctrl, stroke.shift, stroke.alt)));
+	}
+	return keys;
+}
+
+void Window::register_hot_key_sequence(
+	const vector<HotKeyStroke>& strokes,
+	function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope,
+	HotKeyPolicy policy, uint32_t timeout_ms
+) {
+	if (strokes.size() < 2) throw std::invalid_argument("A hot key sequence needs at least two strokes");
+	HotKeySequenceTable::binding_type binding;
+	binding.scope = static_cast<hotkey::Scope>(scope);
+	binding.owner = this;
+	binding.window = hwnd;
+	binding.thread = _owner;
+	binding.swallow = policy.swallow;
+	binding.synchronous = policy.synchronous;
+	if (!policy.synchronous) binding.target = hotkey_sink();
+	binding.handler = make_shared<const function<void(HotKeyProcData&)>>(std::move(callback));
+
+	lock_guard lock(hotkey_handlers_mutex);
+	if (!hotkey_sequences.insert(pack_hot_key_strokes(strokes), std::move(binding), timeout_ms)) {
+		throw window_hotkey_duplication_exception();
+	}
+	publish_hot_key_sequences();
+	hotkey_owner = true;
+
+	// 序列只能由钩子逐键识别
+	if (scope == HotKeyOptions::Scope::System) {
+		if (!get_global_option(Option_EnableGlobalHotkey))
+			set_global_option(Option_EnableGlobalHotkey, true);
+	}
+	else {
+		if (!get_global_option(Option_EnableHotkey))
+			set_global_option(Option_EnableHotkey, true);
+	}
+}
+
+void Window::remove_hot_key_sequence(const vector<HotKeyStroke>& strokes, HotKeyOptions::Scope scope) {
+	lock_guard lock(hotkey_handlers_mutex);
+	if (hotkey_sequences.erase(pack_hot_key_strokes(strokes), static_cast<hotkey::Scope>(scope))) {
+		publish_hot_key_sequences();
+	}
 }
 
 
 #pragma region My Foundation Classes
 
 HWND BaseSystemWindow::new_window() {
-	auto cls = get_class_name();
+	return create_window(nullptr);
+}
+
+HWND BaseSystemWindow::create_window(LPVOID param) {
+	wstring cls;
+	if (!class_atom) cls = get_class_name();
 	return CreateWindowExW(
 		setup_info->styleEx,
-		cls.c_str(),
+		class_atom ? MAKEINTATOM(class_atom) : cls.c_str(),
 		setup_info->title.c_str(),
 		setup_info->style,
 		setup_info->x, setup_info->y,
 		setup_info->width, setup_info->height,
 		parent, // 必须提供，否则会失败（逆天Windows控件库。。。）并且不可以变化，否则丢消息。。。
-		(HMENU)(LONG_PTR)(ctlid), GetModuleHandle(NULL), nullptr
+		(HMENU)(LONG_PTR)(ctlid), GetModuleHandle(NULL), param
 	);
 }
 
+HWND foundation::ScrollView::new_window() {
+	return create_window(this);
+}
+
+void foundation::ScrollView::onCreated() {
+	BaseSystemWindow::onCreated();
+	measure();
+	fit();
+	update_scrollbar();
+}
+
+int foundation::ScrollView::rows() const {
+	RECT client{};
+	GetClientRect(hwnd, &client);
+	int count = (client.bottom - client.top) / line_height;
+	return count > 0 ? count : 1;
+}
+
+uint64_t foundation::ScrollView::max_top() const {
+	size_t count = line_count(), visible = (size_t)rows();
+	return first_line() + (count > visible ? count - visible : 0);
+}
+
+void foundation::ScrollView::scroll_to(uint64_t line) {
+	line = (std::min)((std::max)(line, first_line()), max_top());
+	if (line == top) return;
+	top = line;
+	if (!hwnd) return;
+	update_scrollbar();
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::ScrollView::fit() {
+	top = (std::min)((std::max)(top, first_line()), max_top());
+}
+
+void foundation::ScrollView::scroll_by(long long delta) {
+	if (delta < 0 && (uint64_t)(-delta) > top) return scroll_to(0);
+	scroll_to(top + delta);
+}
+
+size_t foundation::ScrollView::scroll_scale() const {
+	return line_count() / INT_MAX + 1;
+}
+
+void foundation::ScrollView::update_scrollbar() {
+	size_t count = line_count(), scale = scroll_scale();
+	SCROLLINFO si{};
+	si.cbSize = sizeof(si);
+	si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
+	si.nMin = 0;
+	si.nMax = count ? (int)((count - 1) / scale) : 0;
+	si.nPage = (UINT)(std::max)((size_t)rows() / scale, (size_t)1);
+	si.nPos = (int)((top - first_line()) / scale);
+	SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+}
+
+void foundation::ScrollView::measure() {
+	HDC hdc = GetDC(hwnd);
+	HGDIOBJ old = view_font ? SelectObject(hdc, view_font) : NULL;
+	TEXTMETRICW tm{};
+	GetTextMetricsW(hdc, &tm);
+	if (old) SelectObject(hdc, old);
+	ReleaseDC(hwnd, hdc);
+	line_height = tm.tmHeight + tm.tmExternalLeading;
+	if (line_height <= 0) line_height = 16;
+}
+
+void foundation::ScrollView::onSize(EventData& data) {
+	fit();
+	update_scrollbar();
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::ScrollView::onVScroll(EventData& data) {
+	long long page = rows();
+	switch (LOWORD(data.wParam)) {
+	case SB_LINEUP: scroll_by(-1); break;
+	case SB_LINEDOWN: scroll_by(1); break;
+	case SB_PAGEUP: scroll_by(-page); break;
+	case SB_PAGEDOWN: scroll_by(page); break;
+	case SB_TOP: scroll_to(0); break;
+	case SB_BOTTOM: scroll_to(max_top()); break;
+	case SB_THUMBTRACK:
+	case SB_THUMBPOSITION: {
+		// HIWORD 只有 16 位，行数多时必须读 nTrackPos
+		SCROLLINFO si{};
+		si.cbSize = sizeof(si);
+		si.fMask = SIF_TRACKPOS;
+		GetScrollInfo(hwnd, SB_VERT, &si);
+		scroll_to(first_line() + (uint64_t)si.nTrackPos * scroll_scale());
+		break;
+	}
+	}
+	data.returnValue(0);
+}
+
+void foundation::ScrollView::onMouseWheel(EventData& data) {
+	// 高精度滚轮每次的增量小于 WHEEL_DELTA，累积到一格再滚动
+	wheel_delta += GET_WHEEL_DELTA_WPARAM(data.wParam);
+	int notches = wheel_delta / WHEEL_DELTA;
+	wheel_delta %= WHEEL_DELTA;
+	if (notches) scroll_by(-3LL * notches);
+	data.returnValue(0);
+}
+
+void foundation::ScrollView::onKeyDown(EventData& data) {
+	long long page = rows();
+	switch (data.wParam) {
+	case VK_UP: scroll_by(-1); break;
+	case VK_DOWN: scroll_by(1); break;
+	case VK_PRIOR: scroll_by(-page); break;
+	case VK_NEXT: scroll_by(page); break;
+	case VK_HOME: scroll_to(0); break;
+	case VK_END: scroll_to(max_top()); break;
+	default: return;
+	}
+	data.returnValue(0);
+}
+
+void foundation::ScrollView::onSetFont(EventData& data) {
+	view_font = (HFONT)data.wParam;
+	measure();
+	fit();
+	update_scrollbar();
+	if (LOWORD(data.lParam)) InvalidateRect(hwnd, NULL, FALSE);
+	data.returnValue(0);
+}
+
+void foundation::ScrollView::setup_event_handlers() {
+	WINDOW_EVENT_HANDLER_SUPER(BaseSystemWindow);
+	WINDOW_add_handler(WM_SIZE, onSize);
+	WINDOW_add_handler(WM_VSCROLL, onVScroll);
+	WINDOW_add_handler(WM_MOUSEWHEEL, onMouseWheel);
+	WINDOW_add_handler(WM_KEYDOWN, onKeyDown);
+	WINDOW_add_handler(WM_SETFONT, onSetFont);
+	addEventListener(WM_GETFONT, [this](EventData& data) {
+		if (data.hwnd != this->hwnd) return;
+		data.returnValue((LRESULT)view_font);
+	});
+	// 派生类绘制每行时已经擦除背景
+	addEventListener(WM_ERASEBKGND, [this](EventData& data) {
+		if (data.hwnd != this->hwnd) return;
+		data.returnValue(1);
+	});
+	// 点击后获得焦点，才能收到滚轮和按键
+	addEventListener(WM_LBUTTONDOWN, [this](EventData& data) {
+		if (data.hwnd != this->hwnd) return;
+		SetFocus(hwnd);
+	});
+	// 消息循环用 IsDialogMessageW 处理 Tab 导航，不声明的话方向键会被它拿去切换焦点
+	addEventListener(WM_GETDLGCODE, [this](EventData& data) {
+		if (data.hwnd != this->hwnd) return;
+		data.returnValue(DLGC_WANTARROWS);
+	});
+}
+
+void foundation::LogView::onCreated() {
+	ScrollView::onCreated();
+	// 创建之前追加的行没有投递过消息
+	flush();
+}
+
+void foundation::LogView::append(wstring_view text) {
+	if (batch.push_text(text)) signal();
+}
+
+void foundation::LogView::append(std::u8string_view text) {
+	thread_local wstring converted;
+	converted.resize(text.size());
+	converted.resize(utf::convert(text, converted.data()).written);
+	append(wstring_view(converted));
+}
+
+void foundation::LogView::signal() {
+	HWND target = hwnd;
+	// 还没有创建时由 onCreated 处理；投递失败时重新允许通知，避免之后再也不刷新
+	if (!target || !PostMessageW(target, flush_message, 0, 0)) batch.rearm();
+}
+
+void foundation::LogView::flush() {
+	batch.drain(lines);
+	if (!hwnd) return;
+	if (follow || top < lines.first_sequence()) {
+		top = follow ? max_top() : lines.first_sequence();
+	}
+	update_scrollbar();
+	// 只标记无效，连续多批之间系统只生成一次 WM_PAINT
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::LogView::clear() {
+	batch.drain(lines);
+	lines.clear();
+	top = lines.first_sequence();
+	follow = true;
+	if (!hwnd) return;
+	update_scrollbar();
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::LogView::capacity(size_t capacity) {
+	batch.capacity(capacity);
+	lines.capacity(capacity);
+	if (!hwnd) return;
+	if (top < lines.first_sequence()) top = lines.first_sequence();
+	update_scrollbar();
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::LogView::scroll_to_end() {
+	follow = true;
+	scroll_to(max_top());
+}
+
+void foundation::LogView::scroll_to(uint64_t sequence) {
+	ScrollView::scroll_to(sequence);
+	follow = top == max_top();
+}
+
+void foundation::LogView::fit() {
+	if (follow) top = max_top();
+	else {
+		ScrollView::fit();
+		follow = top == max_top();
+	}
+}
+
+void foundation::LogView::onFlush(EventData& data) {
+	flush();
+	data.returnValue(0);
+}
+
+void foundation::LogView::onPaint(EventData& data) {
+	data.preventDefault();
+	PAINTSTRUCT ps;
+	HDC hdc = BeginPaint(hwnd, &ps);
+	RECT client;
+	GetClientRect(hwnd, &client);
+	HGDIOBJ old = view_font ? SelectObject(hdc, view_font) : NULL;
+	SetBkColor(hdc, GetSysColor(COLOR_WINDOW));
+	SetTextColor(hdc, GetSysColor(COLOR_WINDOWTEXT));
+	// 只画与无效区域相交的行，每行用 ETO_OPAQUE 同时擦除背景
+	int first_row = ps.rcPaint.top / line_height;
+	int last_row = (ps.rcPaint.bottom + line_height - 1) / line_height;
+	for (int row = first_row; row < last_row; ++row) {
+		RECT rc{ client.left, row * line_height, client.right, (row + 1) * line_height };
+		const wstring* line = lines.find(top + row);
+		ExtTextOutW(hdc, rc.left + 2, rc.top, ETO_OPAQUE | ETO_CLIPPED, &rc,
+			line ? line->data() : L"", line ? (UINT)line->size() : 0, NULL);
+	}
+	if (old) SelectObject(hdc, old);
+	EndPaint(hwnd, &ps);
+}
+
+void foundation::LogView::setup_event_handlers() {
+	WINDOW_EVENT_HANDLER_SUPER(ScrollView);
+	WINDOW_add_handler(flush_message, onFlush);
+	WINDOW_add_handler(WM_PAINT, onPaint);
+}
+
+void foundation::TextView::document(text::PieceTable::Snapshot snapshot) {
+	doc = std::move(snapshot);
+	if (!hwnd) return;
+	fit();
+	update_scrollbar();
+	InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::TextView::max_line_length(size_t length) {
+	max_length = length ? length : 1;
+	if (hwnd) InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void foundation::TextView::onPaint(EventData& data) {
+	data.preventDefault();
+	PAINTSTRUCT ps;
+	HDC hdc = BeginPaint(hwnd, &ps);
+	RECT client;
+	GetClientRect(hwnd, &client);
+	HGDIOBJ old = view_font ? SelectObject(hdc, view_font) : NULL;
+	SetBkColor(hdc, GetSysColor(COLOR_WINDOW));
+	SetTextColor(hdc, GetSysColor(COLOR_WINDOWTEXT));
+	// 只取与无效区域相交的行，一次定位后顺序读出；每行用 ETO_OPAQUE 同时擦除背景
+	int first_row = ps.rcPaint.top / line_height;
+	int last_row = (ps.rcPaint.bottom + line_height - 1) / line_height;
+	int row = first_row;
+	doc.for_each_line(top + first_row, last_row - first_row, max_length, [&](std::string_view line) {
+		// UTF-8 解码后的单元数不会多于字节数
+		decoded.resize(line.size());
+		decoded.resize(utf::convert(line, decoded.data()).written);
+		RECT rc{ client.left, row * line_height, client.right, (row + 1) * line_height };
+		ExtTextOutW(hdc, rc.left + 2, rc.top, ETO_OPAQUE | ETO_CLIPPED, &rc, decoded.data(), (UINT)decoded.size(), NULL);
+		++row;
+	});
+	// 文档结束之后只擦除背景
+	for (; row < last_row; ++row) {
+		RECT rc{ client.left, row * line_height, client.right, (row + 1) * line_height };
+		ExtTextOutW(hdc, rc.left + 2, rc.top, ETO_OPAQUE | ETO_CLIPPED, &rc, L"", 0, NULL);
+	}
+	if (old) SelectObject(hdc, old);
+	EndPaint(hwnd, &ps);
+}
+
+void foundation::TextView::setup_event_handlers() {
+	WINDOW_EVENT_HANDLER_SUPER(ScrollView);
+	WINDOW_add_handler(WM_PAINT, onPaint);
+}
+
 #pragma endregion
 
 const char* version_string() {
@@ -15,8 +15,22 @@ THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR I
 #include <map>
 #include <functional>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <shared_mutex>
+#include <typeindex>
+#include <optional>
+#include <span>
+#include <iterator>
 #include <windows.h>
 #include <windowsx.h>
+#include "HotKeyTable.hpp"
+#include "Utf.hpp"
+#include "LogBuffer.hpp"
+#include "PieceTable.hpp"
+#include "LineRange.hpp"
+#include "ObjectPool.hpp"
 #define package namespace
 #define declare {
 #define endpackage }
@@ -36,7 +50,16 @@ THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR I
 #endif
 
 
-namespace w32oop::util { std::wstring s2ws(const std::string str); }
+namespace w32oop::util {
+	std::wstring s2ws(const std::string str);
+	// UTF-8 与 UTF-16 互转，非法序列替换为 U+FFFD
+	inline std::wstring u8ws(std::u8string_view str) {
+		return utf::to_utf16<std::wstring>(str);
+	}
+	inline std::u8string ws2u8(std::wstring_view str) {
+		return utf::to_utf8<std::u8string>(str);
+	}
+}
 namespace w32oop::util {
 	class WindowRAIIHelper {
 	private:
@@ -49,6 +72,137 @@ namespace w32oop::util {
 namespace w32oop::util {
 	std::vector<HWND> GetAllChildWindows(HWND hParent);
 }
+namespace w32oop::util {
+	// 只读映射整个文件，不把内容复制到堆上；页面按需读入，内存紧张时可以直接丢弃。
+	// 打开失败时 data() 为空，error() 为 GetLastError 的值
+	class MappedFile {
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::wstring& path) {
+			open(path);
+		}
+		~MappedFile() {
+			close();
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept {
+			*this = std::move(other);
+		}
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool open(const std::wstring& path);
+		void close();
+		const char* data() const {
+			return view;
+		}
+		size_t size() const {
+			return length;
+		}
+		std::string_view bytes() const {
+			return std::string_view(view ? view : "", length);
+		}
+		DWORD error() const {
+			return last_error;
+		}
+		bool is_open() const {
+			return file != INVALID_HANDLE_VALUE;
+		}
+
+	private:
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+		const char* view = nullptr;
+		size_t length = 0;
+		DWORD last_error = 0;
+	};
+
+	// 把文件内容按块解码成 UTF-16，每块大约 chunk_bytes 个输入字节，
+	// 调用者可以每解码一块就显示一块，不需要先得到整个文件的副本。
+	// 块边界不会切开 UTF-8 序列或 Ansi 的双字节字符。bytes 必须在解码期间有效
+	class TextDecoder {
+	public:
+		// encoding 为 Unknown 时自动检测；开头的 BOM 会被跳过。ansi_code_page 是 Ansi 文本使用的代码页
+		explicit TextDecoder(std::string_view bytes, utf::Encoding encoding = utf::Encoding::Unknown, UINT ansi_code_page = CP_ACP);
+		utf::Encoding encoding() const {
+			return enc;
+		}
+		// 解码下一块到 out（覆盖原内容，复用容量）。已经全部解码时返回 false
+		bool next(std::wstring& out, size_t chunk_bytes = 1 << 20);
+		bool done() const {
+			return finished;
+		}
+		// 已经处理的字节数，用于显示进度
+		size_t position() const {
+			return pos;
+		}
+		size_t size() const {
+			return input.size();
+		}
+
+	private:
+		std::string_view input;
+		size_t pos = 0;
+		utf::Encoding enc;
+		UINT code_page;
+		utf::Utf8Decoder utf8;
+		bool finished = false;
+	};
+
+	// 在后台线程上把文本编码成 UTF-8 并写入文件，界面线程只负责交出文本的快照。
+	// 先写同一目录下的临时文件，写完并刷新后用 ReplaceFileW（目标不存在时用 MoveFileExW）替换，
+	// 任何时刻失败或崩溃都不会留下写了一半的目标文件。
+	// 同一路径的请求在开始写入之前会被合并，只写最新的一份。
+	// 进度和结果投递给 notify 窗口的 message 消息：LOWORD(wParam) 为 Notification，
+	// HIWORD(wParam) 对 Progress 是百分比，对 Failed 是错误码（系统错误码都小于 0x10000）；
+	// lParam 总是 save 返回的序号，多个请求同时进行时据此区分。
+	// 析构时等待所有请求写完
+	class AsyncFileWriter {
+	public:
+		enum Notification : WPARAM {
+			Progress,
+			Succeeded,
+			Failed,
+			// 还没开始写入就被同一路径的新请求取代，之后不会再有这个序号的通知
+			Superseded,
+		};
+
+		AsyncFileWriter(HWND notify, UINT message) : notify(notify), message(message) {}
+		~AsyncFileWriter();
+		AsyncFileWriter(const AsyncFileWriter&) = delete;
+		AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+		// 返回请求的序号，与通知的 lParam 比较就知道是哪一次保存的进度或结果。
+		// 同一路径还在排队的请求直接换成新的内容，旧的序号收到 Superseded 后结束。
+		// 序号与 lParam 同宽，32 位程序中保存超过 2^31 次后才会回绕
+		LPARAM save(std::wstring path, std::wstring text);
+		// 还有请求在排队或正在写入
+		bool busy() const;
+
+	private:
+		struct Request {
+			LPARAM id;
+			std::wstring path;
+			std::wstring text;
+		};
+		HWND notify;
+		UINT message;
+		mutable std::mutex mutex;
+		std::condition_variable wakeup;
+		std::deque<Request> pending;
+		std::thread worker;
+		LPARAM next_id = 0;
+		bool writing = false;
+		bool stopping = false;
+
+		void run();
+		// 成功时返回 0，否则返回错误码
+		DWORD write(const Request& request);
+		void post(Notification kind, DWORD detail, LPARAM id) const {
+			PostMessageW(notify, message, MAKEWPARAM(kind, detail), id);
+		}
+	};
+}
 
 package w32oop declare;
 
@@ -66,7 +220,77 @@ declare_exception(window_has_no_parent);
 declare_exception(window_dangerous_thread_operation);
 declare_exception(window_hotkey_duplication);
 
+template <class Handle> class GdiHandle;
+using GdiBrush = GdiHandle<HBRUSH>;
+using GdiPen = GdiHandle<HPEN>;
+using GdiFont = GdiHandle<HFONT>;
+
+// 进程范围的 GDI 对象缓存：描述相同的画刷、画笔、字体只创建一次，
+// 由 GdiHandle 引用计数，最后一个引用释放时立即 DeleteObject。可以在任何线程上调用
+class GdiCache final {
+public:
+	GdiCache() = delete;
+	static GdiBrush brush(COLORREF color);
+	static GdiPen pen(int style, int width, COLORREF color);
+	// lfHeight/lfWidth 按 96 DPI 给出，创建时按 dpi 缩放；不同 dpi 是不同的对象
+	static GdiFont font(const LOGFONTW& logfont, UINT dpi = 96);
+	static GdiFont font(const wstring& face, int height, int width = 0,
+		int weight = FW_NORMAL, BYTE quality = DEFAULT_QUALITY, UINT dpi = 96);
+	// 接管一个已经创建好的对象（不参与共享），最后一个引用释放时删除它
+	static GdiFont adopt(HFONT font);
+	// 当前存活的对象数量
+	static size_t size();
+
+private:
+	template <class Handle> friend class GdiHandle;
+	struct Entry {
+		HGDIOBJ handle = NULL;
+		size_t refs = 0;
+		const string* key = nullptr;
+	};
+	static Entry* acquire(const string& key, function<HGDIOBJ()> create);
+	static void retain(Entry* entry);
+	static void release(Entry* entry);
+	static unordered_map<string, Entry> entries;
+	static std::mutex entries_mutex;
+};
+
+template <class Handle>
+class GdiHandle final {
+public:
+	GdiHandle() = default;
+	GdiHandle(const GdiHandle& other) : entry(other.entry) {
+		GdiCache::retain(entry);
+	}
+	GdiHandle(GdiHandle&& other) noexcept : entry(std::exchange(other.entry, nullptr)) {}
+	GdiHandle& operator=(GdiHandle other) noexcept {
+		std::swap(entry, other.entry);
+		return *this;
+	}
+	~GdiHandle() {
+		GdiCache::release(entry);
+	}
+	Handle get() const {
+		return entry ? static_cast<Handle>(entry->handle) : NULL;
+	}
+	operator Handle() const {
+		return get();
+	}
+	explicit operator bool() const {
+		return get() != NULL;
+	}
+	void reset() {
+		GdiCache::release(std::exchange(entry, nullptr));
+	}
+
+private:
+	friend class GdiCache;
+	explicit GdiHandle(GdiCache::Entry* entry) : entry(entry) {}
+	GdiCache::Entry* entry = nullptr;
+};
+
 class Window;
+class BaseSystemWindow;
 
 class EventData final {
 public:
@@ -128,6 +352,8 @@ public:
 		Option_HACCEL,
 		Option_EnableHotkey,
 		Option_EnableGlobalHotkey,
+		Option_EnableMouseHotkey, // 额外安装鼠标钩子（注册鼠标快捷键时自动设置）
+		Option_DeferHiddenControls, // 父窗口隐藏时推迟创建控件的 HWND
 	};
 	using msg_t = ULONGLONG;
 protected:
@@ -138,10 +364,10 @@ protected:
 		bool alt = false;
 		int vk = 0;
 		enum Scope {
-			Windowed,
-			Thread,
-			Process,
-			System
+			Windowed = hotkey::Windowed,
+			Thread = hotkey::Thread,
+			Process = hotkey::Process,
+			System = hotkey::System
 		};
 		Scope scope = Thread;
 		bool operator<(const HotKeyOptions& other) const {
@@ -161,15 +387,72 @@ protected:
 		WPARAM wParam = 0;
 		LPARAM lParam = 0;
 		PKBDLLHOOKSTRUCT pKbdStruct = nullptr;
+		PMSLLHOOKSTRUCT pMouseStruct = nullptr; // 鼠标快捷键：wParam 为鼠标消息，lParam 指向它
 		Window* source = nullptr;
 	};
+	// 多键序列中的一步，例如 { true, false, false, 'K' } 表示 Ctrl+K
+	class HotKeyStroke {
+	public:
+		bool ctrl = false;
+		bool alt = false;
+		bool shift = false;
+		int vk = 0;
+	};
+	// 快捷键的分发策略，在注册时声明。
+	// - swallow: 命中后是否吞掉按键，由钩子直接查表决定
+	// - synchronous: 是否在钩子过程内直接调用回调。
+	//   默认为否：回调被投递到注册快捷键的线程上执行，此时可以直接操作界面，
+	//   也不需要再自己开线程；钩子过程的耗时与回调的轻重无关。
+	//   同步模式下回调仍可调用 preventDefault 来决定是否吞键，但回调必须足够快。
+	class HotKeyPolicy {
+	public:
+		bool swallow = true;
+		bool synchronous = false;
+		static HotKeyPolicy Async(bool swallow = true) {
+			HotKeyPolicy policy;
+			policy.swallow = swallow;
+			return policy;
+		}
+		static HotKeyPolicy Sync() {
+			HotKeyPolicy policy;
+			policy.swallow = false;
+			policy.synchronous = true;
+			return policy;
+		}
+	};
 private:
 	static unordered_map<HWND, Window*> managed; // Internal -- DO NOT access it
 	static recursive_mutex default_font_mutex;
-	static HFONT default_font;
+	static GdiFont default_font;
+	// 每个窗口类持有它的背景画刷，颜色相同的类共用一个
+	static vector<GdiBrush> class_brushes;
 	static map<GlobalOptions, long long> global_options;
-	static map<HotKeyOptions, function<void(HotKeyProcData&)>> hotkey_handlers;
+	// 每个窗口类型对应的窗口类 ATOM，第一次创建时填入；之后创建只需一次哈希查找
+	static unordered_map<type_index, ATOM> class_atoms;
+	static shared_mutex class_atoms_mutex;
+	// 父窗口 -> 等它显示时才创建的子窗口。以对象为键：父窗口自己也可能还没有 HWND
+	static unordered_map<const Window*, vector<Window*>> deferred_children;
+	using HotKeyHandler = shared_ptr<const function<void(HotKeyProcData&)>>;
+	using HotKeyTable = hotkey::Table<HotKeyHandler>;
+	// hotkey_handlers 是写者持有的主表（受 hotkey_handlers_mutex 保护），
+	// 每次修改后（批量修改时在 HotKeyBatch 结束时）复制一份发布到 hotkey_snapshot，钩子过程只读快照，不加锁
+	static HotKeyTable hotkey_handlers;
+	static hotkey::Published<HotKeyTable> hotkey_snapshot;
 	static std::recursive_mutex hotkey_handlers_mutex;
+	static void publish_hot_keys();
+	// 多键序列：同样由 hotkey_handlers_mutex 保护，修改后编译成前缀树发布
+	using HotKeySequenceTable = hotkey::SequenceTable<HotKeyHandler>;
+	using HotKeySequenceTrie = hotkey::SequenceTrie<HotKeyHandler>;
+	static HotKeySequenceTable hotkey_sequences;
+	static hotkey::Published<HotKeySequenceTrie> hotkey_sequence_snapshot;
+	static void publish_hot_key_sequences();
+	// 一次移除多个窗口的快捷键和序列，每张表最多发布一次
+	static void remove_hot_keys_of(const vector<const Window*>& owners);
+	static vector<uint32_t> pack_hot_key_strokes(const vector<HotKeyStroke>& strokes);
+	// HotKeyBatch 的嵌套层数；大于 0 时发布推迟到最外层结束，只记下哪张表需要发布
+	static size_t hotkey_batch_depth;
+	static bool hotkey_table_dirty;
+	static bool hotkey_sequences_dirty;
 
 protected:
 	HWND hwnd = nullptr; // 窗口句柄
@@ -185,6 +468,33 @@ public:
 		return 0;
 	}
 
+	// 快捷键钩子的耗时监控。
+	// 低级钩子处理一次输入的时间超过 LowLevelHooksTimeout 时，系统会悄悄移除它；
+	// 框架统计每次钩子调用的耗时，并在检测到低级钩子可能被移除后重新安装
+	class HotKeyLatencyEvent {
+	public:
+		enum Kind {
+			Slow,        // 一次钩子调用超过了阈值
+			Reinstalled, // 低级钩子疑似被系统移除，已重新安装
+		};
+		Kind kind = Slow;
+		bool low_level = false;
+		uint64_t latency_us = 0; // Slow: 这次调用的耗时
+		uint32_t timeout_ms = 0; // LowLevelHooksTimeout
+	};
+	class HotKeyHookStats {
+	public:
+		hotkey::LatencyStats low_level; // WH_KEYBOARD_LL / WH_MOUSE_LL
+		hotkey::LatencyStats thread;    // WH_KEYBOARD / WH_MOUSE
+		uint32_t timeout_ms = 0;        // LowLevelHooksTimeout
+		uint64_t reinstalls = 0;        // 疑似被系统移除而重新安装的次数
+	};
+	// 可以在任何线程上随时调用
+	static HotKeyHookStats get_hot_key_hook_stats();
+	// threshold 为相对 LowLevelHooksTimeout 的比例，超过它的调用会触发 Slow。
+	// 回调在安装钩子的线程上执行，不在钩子过程内；传入空的 function 取消
+	static void set_hot_key_latency_callback(function<void(const HotKeyLatencyEvent&)> callback, double threshold = 0.5);
+
 public:
 	virtual const wstring get_class_name() const;
 
@@ -198,47 +508,88 @@ protected:
 	// 虚函数：判断窗口类是否已注册（控件类可覆盖此方法）
 	virtual bool class_registered() const {
 		WNDCLASSEXW wc{};
-		return (bool)GetClassInfoExW(GetModuleHandleW(NULL), class_name.c_str(), &wc);
+		return (bool)GetClassInfoExW(GetModuleHandleW(NULL), get_class_name().c_str(), &wc);
 	}
 	virtual HFONT get_font() {
-		if (default_font) return default_font;
-		set_default_font();
+		lock_guard lock(default_font_mutex);
+		if (!default_font) set_default_font();
 		return default_font;
 	}
 
 public:
+	// 替换默认字体不会影响仍在使用旧字体的窗口，旧字体在这些窗口销毁后才删除
 	static void set_default_font(HFONT font);
 	static void set_default_font(wstring font_name = L"Consolas");
+	static void set_default_font(GdiFont font);
 	static void set_accelerator(HACCEL accelerator);
 
 private:
-	wstring class_name;
 	virtual void register_class_if_needed();
+	ATOM resolve_class_atom();
+protected:
+	ATOM class_atom = 0; // 窗口类；为 0 时按类名创建
+private:
 	DWORD _owner = 0;
 
 protected:
-	// 检查窗口句柄有效性
+	// 检查窗口句柄有效性；推迟创建的窗口在这里创建
 	inline void validate_hwnd() const {
-		if (!hwnd) throw window_not_initialized_exception();
+		if (hwnd) return;
+		if (!deferred()) throw window_not_initialized_exception();
+		const_cast<Window*>(this)->materialize();
+	}
+	// 已经 create() 但 HWND 尚未创建
+	inline bool deferred() const {
+		return !hwnd && setup_info && setup_info->deferred_parent;
+	}
+	// 控件的父窗口，用于判断能否推迟创建
+	virtual HWND creation_parent() const {
+		return NULL;
+	}
+	// 以对象指定、当时还没有 HWND 的父窗口（例如推迟创建的父窗口）
+	virtual Window* creation_parent_window() const {
+		return nullptr;
+	}
+	// 父窗口有了 HWND 之后、创建自己之前调用
+	virtual void resolve_creation_parent(HWND) {}
+	// 不会触发推迟创建的 HWND，可能为 NULL
+	static HWND handle_of(const Window& window) {
+		return window.hwnd;
 	}
 
 	virtual HWND new_window();
 
+	// 创建参数只在创建之前需要，创建后释放，窗口存活期间只占一个指针
 	class setup_info_class {
 	public:
 		wstring title;
 		int width = 0, height = 0, x = 0, y = 0;
 		LONG style = WS_OVERLAPPED, styleEx = 0; 
 		HMENU hMenu = 0;
-	} *setup_info;
+		// 推迟创建期间设置的字体
+		HFONT font = NULL;
+		GdiFont font_ref;
+		// 推迟创建时所在的 deferred_children 列表及位置
+		Window* deferred_parent = nullptr;
+		size_t deferred_slot = 0;
+	};
+	unique_ptr<setup_info_class> setup_info;
 
 	virtual void transfer_ownership() final {
 		_owner = GetCurrentThreadId();
 	}
 
 private:
+	// 窗口正在使用的缓存字体
+	GdiFont font_ref;
 	bool _created = false;
 	bool is_main_window = false;
+	// 由 create_controls 统一设置字体，m_onCreated 跳过
+	bool defer_font = false;
+	// 注册过快捷键或序列；没注册过的窗口销毁时不必加锁查表
+	bool hotkey_owner = false;
+	// 祖先窗口的 WM_DESTROY 已经一并清理了本窗口的框架状态
+	bool released = false;
 
 public:
 	Window(
@@ -251,6 +602,16 @@ public:
 		LONG styleEx = WS_EX_CONTROLPARENT,
 		HMENU hMenu = nullptr
 	);
+	Window(
+		std::u8string_view title,
+		int width,
+		int height,
+		int x = 0,
+		int y = 0,
+		LONG style = WS_OVERLAPPED,
+		LONG styleEx = WS_EX_CONTROLPARENT,
+		HMENU hMenu = nullptr
+	) : Window(util::u8ws(title), width, height, x, y, style, styleEx, hMenu) {}
 	Window();
 	virtual ~Window();
 
@@ -259,19 +620,24 @@ public:
 
 	Window(Window&& other) noexcept :
 		hwnd(other.hwnd)
-		,setup_info(other.setup_info)
+		,setup_info(std::move(other.setup_info))
 		//,notification_router(other.notification_router)
 	{
+		_created = other._created;
 		other.hwnd = nullptr;
+		other._created = false;
+		other.setup_info.reset();
 		//other.notification_router = nullptr;
 		if (hwnd) {
 			SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
 			managed[hwnd] = this;
 		}
+		relink_deferred(&other);
 	}
 	Window& operator=(Window&& other) noexcept;
 
 	virtual operator HWND() const final {
+		if (deferred()) const_cast<Window*>(this)->materialize();
 		return hwnd;
 	}
 
@@ -294,7 +660,38 @@ public:
 		LONG styleEx = 0,
 		HMENU hMenu = nullptr
 	) final;
+	virtual void create(
+		std::u8string_view title,
+		int width,
+		int height,
+		int x = 0,
+		int y = 0,
+		LONG style = 0,
+		LONG styleEx = 0,
+		HMENU hMenu = nullptr
+	) final;
 	virtual bool created() final;
+private:
+	// 真正创建 HWND
+	void materialize();
+	void unlist_deferred();
+	void materialize_deferred_children();
+	void abandon_deferred_children();
+	// 移动后把 deferred_children 中指向 from 的记录改为指向自己
+	void relink_deferred(const Window* from);
+public:
+
+	// 批量创建时的控件描述，children 以 control 为父窗口
+	struct ControlDescriptor {
+		BaseSystemWindow* control = nullptr;
+		wstring text;
+		int width = 0, height = 0, x = 0, y = 0;
+		LONG style = 0; // 为 0 时使用控件自己的默认样式
+		vector<ControlDescriptor> children;
+	};
+	// 批量创建子控件：本窗口暂停重绘，先父后子地创建所有控件，
+	// 再统一设置字体，最后只重绘一次。某个控件创建失败时抛出异常，已经创建的控件保留
+	virtual void create_controls(const vector<ControlDescriptor>& controls) final;
 
 	// 添加子窗口（类似appendChild）
 	virtual void append(const Window& child) {
@@ -335,16 +732,29 @@ public:
 	virtual bool force_focus(DWORD timeout = 10000) final;
 
 	inline void move(int x, int y) {
+		if (deferred()) {
+			setup_info->x = x; setup_info->y = y;
+			return;
+		}
 		validate_hwnd();
 		SetWindowPos(hwnd, nullptr, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
 	}
 
 	inline void resize(int w, int h) {
+		if (deferred()) {
+			setup_info->width = w; setup_info->height = h;
+			return;
+		}
 		validate_hwnd();
 		SetWindowPos(hwnd, nullptr, 0, 0, w, h, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
 	}
 
 	inline void resize(int x, int y, int w, int h) {
+		if (deferred()) {
+			setup_info->x = x; setup_info->y = y;
+			setup_info->width = w; setup_info->height = h;
+			return;
+		}
 		validate_hwnd();
 		SetWindowPos(hwnd, nullptr, x, y, w, h, SWP_NOZORDER | SWP_NOACTIVATE);
 	}
@@ -359,6 +769,11 @@ public:
 	}
 
 	inline void enable(bool enabled = true) {
+		if (deferred()) {
+			if (enabled) setup_info->style &= ~WS_DISABLED;
+			else setup_info->style |= WS_DISABLED;
+			return;
+		}
 		validate_hwnd();
 		EnableWindow(hwnd, enabled);
 	}
@@ -368,6 +783,12 @@ public:
 
 	// 窗口显示系列函数
 	inline void show(int nCmdShow = SW_SHOW) {
+		// 父窗口仍然隐藏，只需要记下可见性
+		if (deferred()) {
+			if (nCmdShow == SW_HIDE) setup_info->style &= ~WS_VISIBLE;
+			else setup_info->style |= WS_VISIBLE;
+			return;
+		}
 		validate_hwnd();
 		ShowWindow(hwnd, nCmdShow);
 		UpdateWindow(hwnd);
@@ -388,9 +809,23 @@ public:
 
 	virtual wstring text() const;
 	virtual void text(const std::wstring& text);
+	virtual size_t text_length() const;
+	// 读到调用者的字符串里；容量足够时不分配内存
+	virtual void text_into(wstring& out) const;
+	// 返回写入的字符数（不含结尾的 0），放不下时截断
+	virtual size_t text_into(span<wchar_t> buffer) const;
+	// skip_if_unchanged 为 true 时先比较当前文本，相同就不发送 WM_SETTEXT（也就不会重绘）
+	virtual void text(wstring_view text, bool skip_if_unchanged);
+	// UTF-8 版本
+	virtual void text(std::u8string_view text);
+	virtual void text_into(std::u8string& out) const;
+	virtual std::u8string u8text() const;
 
 	virtual HFONT font() const;
+	// 字体由调用者管理，必须比窗口活得久
 	virtual void font(HFONT font);
+	// 窗口持有字体的引用，直到换用其他字体或被销毁
+	virtual void font(GdiFont font);
 
 	virtual void add_style(LONG_PTR style) final;
 	virtual void remove_style(LONG_PTR style) final;
@@ -402,6 +837,10 @@ protected:
 		validate_hwnd();
 		DestroyWindow(hwnd);
 	}
+	// 销毁整棵子树：父窗口在此期间暂停重绘，结束后只重绘一次。
+	// 包含大量控件的窗口可以在析构函数中调用它，
+	// 这样作为成员的控件析构时窗口已经不存在，不会再逐个 DestroyWindow
+	virtual void destroy_tree() final;
 
 	virtual void override_style(LONG_PTR style) final;
 	virtual void override_style_ex(LONG_PTR styleEx) final;
@@ -433,14 +872,16 @@ private:
 	LRESULT dispatchMessageToWindowAndGetResult(msg_t msg, WPARAM wParam, LPARAM lParam, bool isNotification = false);
 
 	LRESULT destroy_handler_internal(WPARAM wParam, LPARAM lParam);
+	// WM_DESTROY 先发给子树的根，再发给各个子窗口；根在这里一次性清理整棵子树
+	void release_subtree();
 
 	using EventRouter = unordered_map<msg_t,
 		std::vector<
 			std::function<void(EventData&)>
 		>
 	>;
-	EventRouter router;
-	recursive_mutex router_lock;
+	// 第一次添加监听器时才分配；只在所属线程上访问，不需要加锁
+	unique_ptr<EventRouter> router;
 
 protected:
 	// 注册事件处理器
@@ -452,33 +893,146 @@ protected:
 
 private:
 	// 快捷键相关功能
+	// 同一线程上的键盘钩子和鼠标钩子共享一个上下文，输入都进入 handle_input 做一次匹配
 	class HotKeyProcInternal {
 	public:
 		HHOOK hHook = NULL;
+		HHOOK hMouseHook = NULL;
+		// 应该挂上的钩子。SetWindowsHookExW 失败时句柄仍为 NULL，低级钩子由定时器重试
+		bool want_hook = false;
+		bool want_mouse_hook = false;
 		DWORD thread_id = 0;
+		hotkey::ModifierTracker modifiers; // 仅低级钩子使用
+		hotkey::SequenceState sequence;    // 多键序列进行到哪一步
+		// 以下仅低级钩子使用：用于判断钩子是否已被系统移除
+		bool suspect = false;              // 某次调用超过了 LowLevelHooksTimeout
+		DWORD last_call = 0;               // 最近一次调用的 GetTickCount
+		// 吞掉了某个鼠标键的按下，就把对应的松开也吞掉，窗口不会收到不成对的消息
+		uint32_t swallowed_buttons = 0;
+		void swallow_button(int vk_code) {
+			swallowed_buttons |= hotkey::button_modifier(vk_code);
+		}
+		bool release_button(int vk_code) {
+			uint32_t bit = hotkey::button_modifier(vk_code);
+			bool swallowed = (swallowed_buttons & bit) != 0;
+			swallowed_buttons &= ~bit;
+			return swallowed;
+		}
 	};
 	static atomic<size_t> hotkey_global_count;
 	static bool hotkey_handler_contains(bool ctrl, bool shift, bool alt, int vk_code, HotKeyOptions::Scope scope);
-	static LRESULT __stdcall handlekb(
-		int vk, bool ctrl, bool alt, bool shift,
-		PKBDLLHOOKSTRUCT pkb,
-		int code, WPARAM wParam, LPARAM lParam,
-		HotKeyProcInternal* data
+	// 返回 true 表示吞掉这个输入
+	static bool handle_input(
+		HotKeyProcInternal* user,
+		int vk, uint32_t modifiers, bool low_level,
+		PKBDLLHOOKSTRUCT pkb, PMSLLHOOKSTRUCT pms,
+		WPARAM wParam, LPARAM lParam
 	);
 	static LRESULT CALLBACK keyboard_proc(
 		int    code,
 		WPARAM wParam,
-		LPARAM lParam,
-		long long userdata
+		LPARAM lParam
 	);
 	static LRESULT CALLBACK keyboard_proc_LL(
 		int    code,
 		WPARAM wParam,
-		LPARAM lParam,
-		long long userdata
+		LPARAM lParam
 	);
-	using MyHookProc = LRESULT(__stdcall*)(int code, WPARAM wParam, LPARAM lParam, long long userdata);
-	static HOOKPROC make_hHook_proc(MyHookProc pfn, long long userdata);
+	static LRESULT CALLBACK mouse_proc(
+		int    code,
+		WPARAM wParam,
+		LPARAM lParam
+	);
+	static LRESULT CALLBACK mouse_proc_LL(
+		int    code,
+		WPARAM wParam,
+		LPARAM lParam
+	);
+	// 钩子过程总是在安装它的线程上被调用，所以上下文放在线程局部变量里即可
+	static thread_local HotKeyProcInternal* hotkey_thread_hook;
+	static thread_local HotKeyProcInternal* hotkey_global_hook;
+	// 异步回调：钩子把任务投递给注册线程上的消息窗口，在那里执行
+	class HotKeyJob {
+	public:
+		HotKeyHandler handler;
+		uint32_t key = 0;
+		const void* owner = nullptr;
+		WPARAM wParam = 0;
+		LPARAM lParam = 0;
+		KBDLLHOOKSTRUCT kbd{};
+		bool has_kbd = false;
+		MSLLHOOKSTRUCT mouse{};
+		bool has_mouse = false;
+		bool sequence = false;   // 来自多键序列
+		uint64_t generation = 0; // 投递时序列快照的版本
+	};
+	enum HotKeySinkCommand : WPARAM {
+		HotKeySink_Job,        // lParam: HotKeyJob*
+		HotKeySink_Unregister, // lParam: RegisterHotKey 的 id
+		HotKeySink_Slow,       // lParam: (耗时微秒 << 1) | 是否低级钩子
+	};
+	static constexpr UINT_PTR hotkey_watchdog_timer = 1; // sink 上检查低级钩子的定时器
+	static hotkey::LatencyHistogram hotkey_latency_low_level;
+	static hotkey::LatencyHistogram hotkey_latency_thread;
+	static atomic<uint64_t> hotkey_reinstalls;
+	static atomic<uint64_t> hotkey_slow_threshold_us; // 0 表示没有回调
+	static function<void(const HotKeyLatencyEvent&)> hotkey_latency_callback; // 受 hotkey_latency_mutex 保护
+	static std::mutex hotkey_latency_mutex;
+	static uint32_t hotkey_low_level_timeout();
+	static void notify_hot_key_latency(const HotKeyLatencyEvent& event);
+	static void seed_low_level_modifiers(HotKeyProcInternal* data);
+	static void check_low_level_hooks();
+	// 统计一次钩子调用的耗时（QueryPerformanceCounter），放在钩子过程开头
+	class HookLatencyScope {
+	public:
+		HookLatencyScope(HotKeyProcInternal* user, bool low_level);
+		~HookLatencyScope();
+	private:
+		HotKeyProcInternal* user;
+		bool low_level;
+		LONGLONG start;
+	};
+	static UINT hotkey_dispatch_message;
+	static HWND hotkey_sink();
+	static LRESULT CALLBACK hotkey_sink_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	static hotkey::Foreground resolve_foreground();
+	static void invoke_hot_key(const HotKeyHandler& handler, const void* owner, WPARAM wParam, LPARAM lParam, PKBDLLHOOKSTRUCT pkb, PMSLLHOOKSTRUCT pms);
+	// System 作用域的简单组合键交给 RegisterHotKey，不需要低级钩子
+	class HotKeyNativeBackend : public hotkey::NativeBackend {
+	public:
+		bool add(const void* target, int id, uint32_t key) override;
+		bool remove(const void* target, int id) override;
+	};
+	static HotKeyNativeBackend hotkey_native_backend;
+	static hotkey::BackendSelector hotkey_backends; // 受 hotkey_handlers_mutex 保护
+	// Windowed/Thread 的异步快捷键按顶层窗口编译成加速键表，快捷键变化后才重建
+	class HotKeyAccelerators {
+	public:
+		HotKeyAccelerators() = default;
+		HotKeyAccelerators(const HotKeyAccelerators&) = delete;
+		HotKeyAccelerators& operator=(const HotKeyAccelerators&) = delete;
+		~HotKeyAccelerators();
+		HACCEL haccel = NULL;
+		hotkey::AcceleratorTable<HotKeyHandler> table;
+	};
+	// 正在 TranslateAcceleratorW 中的表和消息，sink 收到 WM_COMMAND 时用它找到绑定
+	static thread_local const HotKeyAccelerators* hotkey_translating;
+	static thread_local const MSG* hotkey_translating_msg;
+	static bool translate_hot_key_accelerator(MSG* lpMsg, HWND hRootWnd);
+	// run() 中安装的一组输入钩子：键盘钩子，以及可选的鼠标钩子，二者共享同一个上下文。
+	// 嵌套的 run() 复用本线程已有的钩子，不会重复安装
+	class HotKeyHook {
+	public:
+		HotKeyProcInternal* data = nullptr;
+		bool install(HotKeyProcInternal*& slot, int idHook, HOOKPROC proc, DWORD dwThreadId);
+		// 在 install 得到的上下文上再挂鼠标钩子；已经挂过则什么也不做
+		bool install_mouse(int idHook, HOOKPROC proc, DWORD dwThreadId);
+		void uninstall();
+	private:
+		HotKeyProcInternal** slot = nullptr;
+		bool owns_mouse = false;
+	};
+	void add_hot_key(uint32_t key, function<void(HotKeyProcData&)> callback, HotKeyOptions::Scope scope, HotKeyPolicy policy);
 protected:
 	// 注意：快捷键支持必须
 	// - 要么在 Window::run() 之前调用register_hot_key
@@ -492,16 +1046,46 @@ protected:
 	// 备注：register_hot_key内部会自动设置Option_EnableHotkey为true，因此若**在Window::run之前**
 	// 调用register_hot_key，则不需要再调用set_global_option。
 	// 如果是运行时添加快捷键，则需要提前调用set_global_option。
+	//
+	// 不带 policy 的重载保持原有行为，即 HotKeyPolicy::Sync()：
+	// 回调在钩子过程内执行，由 preventDefault 决定是否吞键。
+	// 新代码建议使用 HotKeyPolicy::Async()。
+	// Windowed/Thread 作用域的 Async() 快捷键会编译进加速键表，在 Window::run() 的消息循环中
+	// 由 TranslateAcceleratorW 处理，不需要钩子；因此它们只在 Window::run() 驱动的消息循环中生效，
+	// 加速键命令 id 0xA000 - 0xAFFF 保留给框架使用。
 	virtual void register_hot_key(
 		bool ctrl, bool alt, bool shift,
 		int vk_code,
 		function<void(HotKeyProcData&)> callback,
 		HotKeyOptions::Scope scope = HotKeyOptions::Scope::Thread
 	) final;
+	virtual void register_hot_key(
+		bool ctrl, bool alt, bool shift,
+		int vk_code,
+		function<void(HotKeyProcData&)> callback,
+		HotKeyOptions::Scope scope,
+		HotKeyPolicy policy
+	) final;
+	// 鼠标快捷键。vk_code 为 hotkey::vk 中的鼠标键（LButton、XButton1 等）或滚轮（WheelUp 等），
+	// buttons 为需要同时按住的其他鼠标键（hotkey::Mod_RButton 等），例如按住右键再滚动滚轮。
+	// 与键盘快捷键共用同一张表和同一组钩子
+	virtual void register_mouse_hot_key(
+		bool ctrl, bool alt, bool shift, uint32_t buttons,
+		int vk_code,
+		function<void(HotKeyProcData&)> callback,
+		HotKeyOptions::Scope scope = HotKeyOptions::Scope::Thread,
+		HotKeyPolicy policy = HotKeyPolicy::Async()
+	) final;
+	virtual void remove_mouse_hot_key(
+		bool ctrl, bool alt, bool shift, uint32_t buttons,
+		int vk_code,
+		HotKeyOptions::Scope scope
+	) final;
 	virtual void remove_hot_key(
 		bool ctrl, bool alt, bool shift,
 		int vk_code
 	) final {
+		HotKeyBatch batch;
 		remove_hot_key(ctrl, alt, shift, vk_code, HotKeyOptions::Scope::Windowed);
 		remove_hot_key(ctrl, alt, shift, vk_code, HotKeyOptions::Scope::Thread);
 		remove_hot_key(ctrl, alt, shift, vk_code, HotKeyOptions::Scope::Process);
@@ -512,8 +1096,33 @@ protected:
 		int vk_code,
 		HotKeyOptions::Scope scope
 	) final;
+	// 多键序列快捷键，例如 { {true, false, false, 'K'}, {true, false, false, 'C'} }（Ctrl+K, Ctrl+C）。
+	// 至少两步；timeout_ms 为两步之间最长的间隔。序列的第一步优先于同一按键上的单键快捷键，
+	// 中间步骤的按键总是被吞掉。与已有序列互为前缀时抛出 window_hotkey_duplication_exception
+	virtual void register_hot_key_sequence(
+		const vector<HotKeyStroke>& strokes,
+		function<void(HotKeyProcData&)> callback,
+		HotKeyOptions::Scope scope = HotKeyOptions::Scope::Thread,
+		HotKeyPolicy policy = HotKeyPolicy::Async(),
+		uint32_t timeout_ms = 1000
+	) final;
+	virtual void remove_hot_key_sequence(
+		const vector<HotKeyStroke>& strokes,
+		HotKeyOptions::Scope scope
+	) final;
 	virtual void remove_all_hot_key_on_window() final;
 	virtual void remove_all_hot_key_global() final;
+	// 每次注册或移除快捷键都会把整张表复制一份发布给钩子，连续注册 N 个快捷键的代价是 O(N²)。
+	// 在 HotKeyBatch 的生存期内，修改只记录下来，最外层的 HotKeyBatch 析构时每张表只发布一次：
+	//   { HotKeyBatch batch; for (...) register_hot_key(...); }
+	// 可以嵌套，也可以跨线程；批量期间钩子仍使用之前发布的快照，其他线程的修改同样推迟到批量结束
+	class HotKeyBatch {
+	public:
+		HotKeyBatch();
+		~HotKeyBatch();
+		HotKeyBatch(const HotKeyBatch&) = delete;
+		HotKeyBatch& operator=(const HotKeyBatch&) = delete;
+	};
 };
 
 #pragma region macros to simplify the event handling
@@ -544,19 +1153,37 @@ public:
 	}
 	virtual void set_parent(HWND parent) {
 		this->parent = parent;
+		parent_window = nullptr;
 	}
+	// 不会创建推迟创建的父窗口：这时记下父窗口对象，自己也跟着推迟
 	virtual void set_parent(Window* pParent) {
-		if (pParent) this->parent = *pParent;
-		else this->parent = nullptr;
+		parent = pParent ? handle_of(*pParent) : nullptr;
+		parent_window = parent ? nullptr : pParent;
+	}
+	void set_parent(Window& window) {
+		set_parent(&window);
 	}
 protected:
 	static std::atomic<unsigned long long> ctlid_generator;
 	unsigned long long ctlid;
 	HWND parent;
+	Window* parent_window = nullptr;
 	bool class_registered() const override {
 		return true;
 	}
+	HWND creation_parent() const override {
+		return parent;
+	}
+	Window* creation_parent_window() const override {
+		return parent_window;
+	}
+	void resolve_creation_parent(HWND handle) override {
+		parent = handle;
+		parent_window = nullptr;
+	}
 	HWND new_window() override;
+	// 用 setup_info 和 parent 创建子窗口，param 作为 lpParam 传给 WM_NCCREATE/WM_CREATE
+	HWND create_window(LPVOID param);
 	// 注意，对已经注册的Win32控件类，无法使用RegisterClassExW
 	// 也就是说，我们的WndProc将不会被调用
 	// 因此只能使用WINDOW_add_notification_handler而不是WINDOW_add_handler
@@ -587,6 +1214,9 @@ public:
 	Static(HWND parent, const std::wstring& text, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
 		: BaseSystemWindow(parent, text, width, height, x, y, style) {
 	}
+	Static(HWND parent, std::u8string_view text, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
+		: Static(parent, util::u8ws(text), width, height, x, y, style) {
+	}
 	Static() : BaseSystemWindow(0, L"", 0, 0, 1, 1, STYLE) {}
 	~Static() override {}
 protected:
@@ -605,6 +1235,9 @@ public:
 	Edit(HWND parent, const std::wstring& text, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
 		: BaseSystemWindow(parent, text, width, height, x, y, style) {
 	}
+	Edit(HWND parent, std::u8string_view text, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
+		: Edit(parent, util::u8ws(text), width, height, x, y, style) {
+	}
 	Edit() : BaseSystemWindow(0, L"", 0, 0, 1, 1, STYLE) {}
 	~Edit() override {}
 	void onChange(CEventHandler handler) {
@@ -617,6 +1250,17 @@ public:
 	void redo() {
 		undo(); // win32控件的迷惑设计。。。参考：https://learn.microsoft.com/zh-cn/windows/win32/controls/em-undo
 	}
+	// 追加到末尾：不读取已有的内容，也不进入撤销记录。
+	// 追加的内容同样受 max_length 限制
+	void append(wstring_view text) {
+		validate_hwnd();
+		int length = GetWindowTextLengthW(hwnd);
+		Edit_SetSel(hwnd, length, length);
+		// EM_REPLACESEL 需要以 0 结尾的字符串
+		thread_local wstring scratch;
+		scratch.assign(text);
+		SendMessageW(hwnd, EM_REPLACESEL, FALSE, (LPARAM)scratch.c_str());
+	}
 	void max_length(int length) {
 		validate_hwnd();
 		if (length < 0) throw std::invalid_argument("Length must be greater than 0");
@@ -634,14 +1278,59 @@ public:
 		validate_hwnd();
 		return Edit_GetLineCount(hwnd);
 	}
-	wstring get_line(int line) {
+	// 行首的字符位置；行号超出范围时返回 -1
+	int line_index(int line) {
+		validate_hwnd();
+		return Edit_LineIndex(hwnd, line);
+	}
+	// 行的长度，不含换行符
+	size_t line_length(int line) {
 		validate_hwnd();
-		wchar_t* buffer = new wchar_t[16384];
-		Edit_GetLine(hwnd, line, buffer, 16384);
-		wstring text(buffer);
-		delete[] buffer;
+		int index = Edit_LineIndex(hwnd, line);
+		if (index < 0) return 0;
+		return (size_t)Edit_LineLength(hwnd, index);
+	}
+	wstring get_line(int line) {
+		wstring text;
+		get_line_into(line, text);
 		return text;
 	}
+	// 读到调用者的字符串里，长度准确；容量足够时不分配内存。返回行的长度
+	size_t get_line_into(int line, wstring& out) {
+		validate_hwnd();
+		out.clear();
+		int index = Edit_LineIndex(hwnd, line);
+		if (index < 0) return 0;
+		size_t length = (size_t)Edit_LineLength(hwnd, index);
+		if (length == 0) return 0;
+		if (length > 0xFFFF) {
+			// EM_GETLINE 的长度字只有 16 位，超长的行从全文里截取
+			text_into(out);
+			out.erase(0, (size_t)index);
+			out.resize((std::min)(length, out.size()));
+			return out.size();
+		}
+		out.resize(length);
+		// EM_GETLINE 从缓冲区的第一个 WORD 读取最多写入的字符数，写入的内容不以 0 结尾
+		*reinterpret_cast<WORD*>(out.data()) = (WORD)length;
+		size_t copied = (size_t)SendMessageW(hwnd, EM_GETLINE, (WPARAM)line, (LPARAM)out.data());
+		out.resize(copied);
+		return copied;
+	}
+	// 一次读取从 first 开始的 count 行，count 为 -1 时读到末尾。
+	// out 里已有的字符串会被复用，返回实际读到的行数
+	size_t get_lines(int first, int count, vector<wstring>& out) {
+		validate_hwnd();
+		return text::read_lines(*this, text::clamp_lines(Edit_GetLineCount(hwnd), first, count), out);
+	}
+
+	// 逐行遍历：for (const wstring& line : edit.lines()) ...
+	using LineRange = text::LineRange<Edit>;
+	// 行数在调用时确定，遍历期间修改内容不会改变范围
+	LineRange lines(int first = 0, int count = -1) {
+		validate_hwnd();
+		return LineRange(this, text::clamp_lines(Edit_GetLineCount(hwnd), first, count));
+	}
 	bool readonly() {
 		validate_hwnd();
 		return is_readonly;
@@ -677,6 +1366,8 @@ public:
 	static const LONG STYLE = WS_CHILD | BS_CENTER | BS_PUSHBUTTON | WS_VISIBLE | WS_TABSTOP;
 	Button(HWND parent, const std::wstring& text, int width, int height, int x = 0, int y = 0, int ctlid = 0, LONG style = STYLE)
 		: BaseSystemWindow(parent, text, width, height, x, y, style, ctlid) {}
+	Button(HWND parent, std::u8string_view text, int width, int height, int x = 0, int y = 0, int ctlid = 0, LONG style = STYLE)
+		: Button(parent, util::u8ws(text), width, height, x, y, ctlid, style) {}
 	Button() : BaseSystemWindow(0, L"", 0, 0, 1, 1, STYLE) {}
 	~Button() override {}
 	void onClick(CEventHandler handler) {
@@ -708,6 +1399,9 @@ public:
 	CheckBox(HWND parent, const std::wstring& text, int width, int height, int x = 0, int y = 0, int ctlid = 0, LONG style = STYLE)
 		: Button(parent, text, width, height, x, y, ctlid, style) {
 	}
+	CheckBox(HWND parent, std::u8string_view text, int width, int height, int x = 0, int y = 0, int ctlid = 0, LONG style = STYLE)
+		: CheckBox(parent, util::u8ws(text), width, height, x, y, ctlid, style) {
+	}
 	CheckBox() : Button(0, L"", 0, 0, 1, 1, 0, STYLE) {}
 	void onCreated() {
 		Button::onCreated();
@@ -741,6 +1435,233 @@ private:
 	}
 };
 
+// 控件池：频繁重建的界面（搜索结果、动态表单）复用已经创建好的控件，
+// 而不是每次销毁后重新 CreateWindowExW、设置字体和监听器。
+// release 的控件被隐藏并放回池中，下次 acquire 时更新文本和位置后重新显示；
+// 空闲控件超过 high_water 时多余的直接销毁。池拥有所有控件，必须在所属线程上使用
+template <class Control>
+class ControlPool final {
+public:
+	using Reset = function<void(Control&)>;
+
+	explicit ControlPool(HWND parent, size_t high_water = 256, Reset reset = nullptr)
+		: parent(parent), controls(high_water), reset(std::move(reset)) {}
+	ControlPool(const ControlPool&) = delete;
+	ControlPool& operator=(const ControlPool&) = delete;
+
+	// 移动并显示只需要一次 SetWindowPos
+	Control& acquire(const wstring& text, int width, int height, int x = 0, int y = 0) {
+		return controls.acquire(
+			[&] {
+				auto control = make_unique<Control>();
+				control->set_parent(parent);
+				control->create(text, width, height, x, y);
+				return control;
+			},
+			[&](Control& control) {
+				control.text(text);
+				SetWindowPos(control, nullptr, x, y, width, height,
+					SWP_NOZORDER | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+			});
+	}
+	// 控件不属于这个池时什么也不做；空闲控件超过上限时直接销毁
+	void release(Control& control) {
+		controls.release(control, [this](Control& idle) { park(idle); });
+	}
+	void release_all() {
+		controls.release_all([this](Control& idle) { park(idle); });
+	}
+	void high_water(size_t high_water) {
+		controls.high_water(high_water);
+	}
+	size_t high_water() const {
+		return controls.high_water();
+	}
+	size_t idle() const {
+		return controls.idle();
+	}
+	size_t in_use() const {
+		return controls.in_use();
+	}
+
+private:
+	HWND parent;
+	pool::Recycler<Control> controls;
+	Reset reset;
+	void park(Control& control) {
+		SetWindowPos(control, nullptr, 0, 0, 0, 0,
+			SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_HIDEWINDOW);
+		if (reset) reset(control);
+	}
+};
+
+// 自己绘制、按行滚动的只读视图的公共部分：字体和行高、垂直滚动条、滚轮和按键。
+// 派生类只提供数据（line_count 和 first_line）并处理 WM_PAINT；
+// top 是第一个可见行，取值在 [first_line(), max_top()] 之间
+class ScrollView : public BaseSystemWindow {
+public:
+	static constexpr LONG STYLE = WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | WS_TABSTOP;
+	ScrollView(HWND parent, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
+		: BaseSystemWindow(parent, L"", width, height, x, y, style) {
+	}
+	~ScrollView() override {}
+
+protected:
+	// 自己绘制，需要注册窗口类并经过 StaticWndProc
+	bool class_registered() const override {
+		return Window::class_registered();
+	}
+	HWND new_window() override;
+	void onCreated() override;
+	virtual void setup_event_handlers() override;
+
+	uint64_t top = 0;
+	int line_height = 16;
+	HFONT view_font = NULL;
+
+	// 总行数
+	virtual size_t line_count() const = 0;
+	// 第一行的编号，不从 0 开始的数据源（如只保留最新若干行的日志）需要覆盖
+	virtual uint64_t first_line() const {
+		return 0;
+	}
+	// 滚动到指定行，超出范围时取最近的合法值
+	virtual void scroll_to(uint64_t line);
+	// 行数、窗口大小或字体变化之后把 top 调整回合法范围
+	virtual void fit();
+	// 整行可见的行数
+	int rows() const;
+	uint64_t max_top() const;
+	void scroll_by(long long delta);
+	// 滚动条的范围只有 int，行数太多时每一格代表多行
+	size_t scroll_scale() const;
+	void update_scrollbar();
+
+private:
+	int wheel_delta = 0;
+
+	void measure();
+
+	void onSize(EventData& data);
+	void onVScroll(EventData& data);
+	void onMouseWheel(EventData& data);
+	void onKeyDown(EventData& data);
+	void onSetFont(EventData& data);
+};
+
+// 高频追加的只读日志视图，用来代替 text(text() + line)。
+// append 可以在任何线程上调用：行先攒在 LineBatch 中，每一批只向窗口投递一条消息，
+// 界面线程把整批移进 LineRing 后只请求一次重绘；绘制时只画可见的行，与总行数无关。
+// 只保留最新的 capacity 行。滚动到底部时自动跟随新行。
+// 窗口销毁前必须停止其他线程上的追加
+class LogView : public ScrollView {
+public:
+	LogView(HWND parent, int width, int height, int x = 0, int y = 0, size_t capacity = 10000, LONG style = STYLE)
+		: ScrollView(parent, width, height, x, y, style), lines(capacity), batch(capacity) {
+	}
+	LogView() : LogView(0, 0, 0, 1, 1) {}
+	~LogView() override {}
+
+	// 文本按换行拆成多行
+	void append(wstring_view text);
+	void append(std::u8string_view text);
+	// 以下只能在界面线程上调用
+	void clear();
+	// 已经显示的行数
+	size_t size() const {
+		return lines.size();
+	}
+	// 0 为最早的一行
+	wstring line(size_t index) const {
+		return index < lines.size() ? lines[index] : wstring();
+	}
+	size_t capacity() const {
+		return lines.capacity();
+	}
+	void capacity(size_t capacity);
+	// 超长的行被截断，限制单行占用的内存
+	void max_line_length(size_t length) {
+		lines.max_line_length(length);
+		batch.max_line_length(length);
+	}
+	// 界面来不及显示而丢弃的行数
+	uint64_t dropped() const {
+		return batch.dropped();
+	}
+	bool following() const {
+		return follow;
+	}
+	void scroll_to_end();
+
+protected:
+	void onCreated() override;
+	virtual void setup_event_handlers() override;
+	// 行号是 LineRing 的序号，top 为第一个可见行的序号
+	size_t line_count() const override {
+		return lines.size();
+	}
+	uint64_t first_line() const override {
+		return lines.first_sequence();
+	}
+	// 停在最后一页时跟随新行
+	void scroll_to(uint64_t sequence) override;
+	void fit() override;
+
+private:
+	static constexpr UINT flush_message = WM_USER + 1;
+	logging::LineRing lines;
+	logging::LineBatch batch;
+	bool follow = true;
+
+	void signal();
+	void flush();
+
+	void onFlush(EventData& data);
+	void onPaint(EventData& data);
+};
+
+// 大文档的只读视图，显示 text::PieceTable（UTF-8）的一份快照，用来打开编辑框装不下的文件。
+// 绘制时只取可见的行并解码成 UTF-16，开销与文档大小无关；超长的行被截断。
+// 快照引用的原始文本（通常是 util::MappedFile）必须比视图活得更久。
+// 文档修改后再调用一次 document() 刷新，滚动位置尽量保持不变
+class TextView : public ScrollView {
+public:
+	TextView(HWND parent, int width, int height, int x = 0, int y = 0, LONG style = STYLE)
+		: ScrollView(parent, width, height, x, y, style) {
+	}
+	TextView() : TextView(0, 0, 0, 1, 1) {}
+	~TextView() override {}
+
+	void document(text::PieceTable::Snapshot snapshot);
+	const text::PieceTable::Snapshot& document() const {
+		return doc;
+	}
+	// 第一个可见行
+	size_t top_line() const {
+		return (size_t)top;
+	}
+	using ScrollView::scroll_to;
+	// 每行最多显示的字节数
+	size_t max_line_length() const {
+		return max_length;
+	}
+	void max_line_length(size_t length);
+
+protected:
+	virtual void setup_event_handlers() override;
+	size_t line_count() const override {
+		return doc.line_count();
+	}
+
+private:
+	text::PieceTable::Snapshot doc;
+	size_t max_length = 4096;
+	// 绘制时复用的解码缓冲区
+	wstring decoded;
+
+	void onPaint(EventData& data);
+};
+
 endpackage;
 #pragma endregion
 
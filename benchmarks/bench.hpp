@@ -0,0 +1,49 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 基准测试用的计时工具：重复运行直到耗时足够长，取多轮中最快的一轮
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+namespace w32oop::bench {
+	using clock = std::chrono::steady_clock;
+
+	inline double elapsed_ns(clock::time_point since) {
+		return std::chrono::duration<double, std::nano>(clock::now() - since).count();
+	}
+
+	// 防止编译器把结果优化掉（T 为整数或指针）
+	template <class T>
+	inline volatile T sink{};
+
+	template <class T>
+	inline void keep(T value) {
+		sink<T> = value;
+	}
+
+	// f(iterations) 执行 iterations 次操作；打印每次操作的纳秒数并返回它
+	template <class F>
+	double run(const char* name, F&& f, int rounds = 5) {
+		uint64_t iterations = 1;
+		for (;;) {
+			auto start = clock::now();
+			f(iterations);
+			if (elapsed_ns(start) > 2e7 || iterations >= (uint64_t(1) << 40)) break;
+			iterations *= 2;
+		}
+		double best = 1e300;
+		for (int i = 0; i < rounds; ++i) {
+			auto start = clock::now();
+			f(iterations);
+			best = (std::min)(best, elapsed_ns(start) / static_cast<double>(iterations));
+		}
+		std::printf("%-48s %12.1f ns/op\n", name, best);
+		return best;
+	}
+}
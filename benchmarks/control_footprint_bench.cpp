@@ -0,0 +1,109 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 每个控件对象的大小和框架为它分配的堆内存。
+// 替换全局 operator new/delete 统计仍未释放的字节数；
+// 只统计 C++ 堆，不包括系统为 HWND 分配的内存
+#include "Window.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+using namespace w32oop;
+using namespace w32oop::foundation;
+
+namespace {
+	long long live_bytes = 0;
+	long long allocations = 0;
+
+	// 每块内存前面记下它的大小，释放时减去
+	constexpr size_t header = alignof(std::max_align_t);
+
+	void* allocate(size_t size) {
+		void* block = std::malloc(size + header);
+		if (!block) throw std::bad_alloc();
+		*static_cast<size_t*>(block) = size;
+		live_bytes += static_cast<long long>(size);
+		++allocations;
+		return static_cast<char*>(block) + header;
+	}
+	void release(void* p) noexcept {
+		if (!p) return;
+		void* block = static_cast<char*>(p) - header;
+		live_bytes -= static_cast<long long>(*static_cast<size_t*>(block));
+		std::free(block);
+	}
+}
+
+void* operator new(size_t size) {
+	return allocate(size);
+}
+void* operator new[](size_t size) {
+	return allocate(size);
+}
+void operator delete(void* p) noexcept {
+	release(p);
+}
+void operator delete[](void* p) noexcept {
+	release(p);
+}
+void operator delete(void* p, size_t) noexcept {
+	release(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+	release(p);
+}
+
+namespace {
+	constexpr size_t count = 1000;
+
+	class Form : public Window {
+	public:
+		Form() : Window(L"control_footprint_bench", 800, 600, 0, 0, WS_OVERLAPPEDWINDOW) {}
+	protected:
+		void setup_event_handlers() override {}
+	};
+
+	// 对象本身之外的堆内存：构造以后、创建以后、注册一个回调以后
+	template <class Control, class Listen>
+	void measure(const char* name, Form& form, Listen listen) {
+		std::vector<std::unique_ptr<Control>> controls;
+		controls.reserve(count);
+		long long base = live_bytes;
+		for (size_t i = 0; i < count; ++i) controls.push_back(std::make_unique<Control>());
+		long long constructed = live_bytes - base - static_cast<long long>(count * sizeof(Control));
+		for (auto& control : controls) {
+			control->set_parent(form);
+			control->create(L"text", 100, 20, 0, 0);
+		}
+		long long created = live_bytes - base - static_cast<long long>(count * sizeof(Control));
+		for (auto& control : controls) listen(*control);
+		long long listening = live_bytes - base - static_cast<long long>(count * sizeof(Control));
+		std::printf("%-8s sizeof %4zu   heap/control: constructed %6.1f  created %6.1f  with callback %6.1f bytes\n",
+			name, sizeof(Control),
+			static_cast<double>(constructed) / count,
+			static_cast<double>(created) / count,
+			static_cast<double>(listening) / count);
+	}
+}
+
+int main() {
+	Form form;
+	form.create();
+	std::printf("sizeof(Window) %zu, sizeof(BaseSystemWindow) %zu\n", sizeof(Window), sizeof(BaseSystemWindow));
+	measure<Static>("Static", form, [](Static& control) {
+		control.on(STN_CLICKED, [](EventData&) {});
+	});
+	measure<Button>("Button", form, [](Button& control) {
+		control.onClick([](EventData&) {});
+	});
+	measure<Edit>("Edit", form, [](Edit& control) {
+		control.onChange([](EventData&) {});
+	});
+	return 0;
+}
@@ -0,0 +1,100 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 每次刷新换掉 1000 行：每次重新创建控件，对比用 ControlPool 复用控件。
+// 计时包括处理完刷新期间积压的消息，也就是包括重绘
+#include "bench.hpp"
+#include "Window.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+using namespace w32oop::foundation;
+
+namespace {
+	constexpr size_t row_count = 1000;
+	constexpr int refreshes = 20;
+
+	class Form : public Window {
+	public:
+		Form() : Window(L"control_pool_bench", 800, 600, 0, 0, WS_OVERLAPPEDWINDOW) {}
+		void settle() {
+			UpdateWindow(hwnd);
+			MSG msg;
+			while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+				TranslateMessage(&msg);
+				DispatchMessageW(&msg);
+			}
+		}
+	protected:
+		void setup_event_handlers() override {}
+	};
+
+	std::wstring row_text(int refresh, size_t i) {
+		return L"row " + std::to_wstring(refresh) + L"." + std::to_wstring(i);
+	}
+	int x_of(size_t i) {
+		return static_cast<int>(i / 30) * 100;
+	}
+	int y_of(size_t i) {
+		return static_cast<int>(i % 30) * 20;
+	}
+
+	// 返回每次刷新的平均毫秒数；第一次刷新不计时
+	double recreate(Form& form) {
+		std::vector<std::unique_ptr<Button>> rows;
+		double total = 0;
+		for (int refresh = 0; refresh <= refreshes; ++refresh) {
+			auto start = bench::clock::now();
+			rows.clear();
+			for (size_t i = 0; i < row_count; ++i) {
+				auto row = std::make_unique<Button>();
+				row->set_parent(&form);
+				row->create(row_text(refresh, i), 100, 20, x_of(i), y_of(i));
+				rows.push_back(std::move(row));
+			}
+			form.settle();
+			if (refresh) total += bench::elapsed_ns(start) / 1e6;
+		}
+		return total / refreshes;
+	}
+
+	double pooled(Form& form) {
+		ControlPool<Button> pool(form, row_count);
+		double total = 0;
+		for (int refresh = 0; refresh <= refreshes; ++refresh) {
+			auto start = bench::clock::now();
+			pool.release_all();
+			for (size_t i = 0; i < row_count; ++i) {
+				pool.acquire(row_text(refresh, i), 100, 20, x_of(i), y_of(i));
+			}
+			form.settle();
+			if (refresh) total += bench::elapsed_ns(start) / 1e6;
+		}
+		return total / refreshes;
+	}
+}
+
+int main() {
+	double without = 0, with = 0;
+	{
+		Form form;
+		form.create();
+		form.show();
+		without = recreate(form);
+	}
+	{
+		Form form;
+		form.create();
+		form.show();
+		with = pooled(form);
+	}
+	std::printf("%zu rows per refresh, %d refreshes\n", row_count, refreshes);
+	std::printf("%-48s %12.2f ms\n", "recreate every row", without);
+	std::printf("%-48s %12.2f ms\n", "ControlPool", with);
+	return 0;
+}
@@ -0,0 +1,90 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 在一个可见的窗口里创建 1000 和 10000 个控件：
+// 逐个 create()（每个控件各自设置字体，父窗口随时可能重绘）对比一次 create_controls()。
+// 计时包括处理完创建期间积压的消息，也就是包括重绘
+#include "bench.hpp"
+#include "Window.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+using namespace w32oop::foundation;
+
+namespace {
+	class Form : public Window {
+	public:
+		Form() : Window(L"create_controls_bench", 800, 600, 0, 0, WS_OVERLAPPEDWINDOW) {}
+		std::vector<std::unique_ptr<Button>> rows;
+
+		void one_by_one(size_t count) {
+			rows.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				auto row = std::make_unique<Button>();
+				row->set_parent(this);
+				row->create(L"row", 100, 20, x_of(i), y_of(i));
+				rows.push_back(std::move(row));
+			}
+		}
+		void batched(size_t count) {
+			vector<ControlDescriptor> list;
+			list.reserve(count);
+			rows.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				rows.push_back(std::make_unique<Button>());
+				list.push_back({ rows.back().get(), L"row", 100, 20, x_of(i), y_of(i) });
+			}
+			create_controls(list);
+		}
+		void settle() {
+			UpdateWindow(hwnd);
+			MSG msg;
+			while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+				TranslateMessage(&msg);
+				DispatchMessageW(&msg);
+			}
+		}
+	protected:
+		void setup_event_handlers() override {}
+	private:
+		static int x_of(size_t i) {
+			return static_cast<int>(i / 30) * 100;
+		}
+		static int y_of(size_t i) {
+			return static_cast<int>(i % 30) * 20;
+		}
+	};
+
+	template <class Fill>
+	double time_ms(size_t count, Fill fill) {
+		Form form;
+		form.create();
+		form.show();
+		form.settle();
+		auto start = bench::clock::now();
+		fill(form, count);
+		form.settle();
+		return bench::elapsed_ns(start) / 1e6;
+	}
+}
+
+int main() {
+	constexpr int rounds = 3;
+	for (size_t count : { 1000, 10000 }) {
+		double each = 1e300, batch = 1e300;
+		for (int round = 0; round < rounds; ++round) {
+			each = (std::min)(each, time_ms(count, [](Form& form, size_t n) { form.one_by_one(n); }));
+			batch = (std::min)(batch, time_ms(count, [](Form& form, size_t n) { form.batched(n); }));
+		}
+		std::string name = std::to_string(count) + " controls, one by one";
+		std::printf("%-48s %12.2f ms\n", name.c_str(), each);
+		name = std::to_string(count) + " controls, create_controls()";
+		std::printf("%-48s %12.2f ms\n", name.c_str(), batch);
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 销毁一个包含 10000 个控件的窗口：
+// destroy_tree() 一次销毁整棵子树，对比控件逐个析构（每个控件各自 DestroyWindow）。
+// 部分控件注册了快捷键，用来覆盖按所有者移除快捷键的路径。
+// destroy_tree() 之后统计仍然持有句柄的控件：应当为 0，之后的析构不再调用 DestroyWindow
+#include "bench.hpp"
+#include "Window.hpp"
+#include <memory>
+#include <vector>
+
+using namespace w32oop;
+using namespace w32oop::foundation;
+
+namespace {
+	constexpr size_t control_count = 10000;
+	constexpr size_t bound_count = 200; // 26 个字母乘以 8 种修饰键组合以内，键不重复
+
+	class Row : public Button {
+	public:
+		void bind(size_t i) {
+			size_t mods = i / 26;
+			register_hot_key(mods & 1, mods & 2, mods & 4, 'A' + static_cast<int>(i % 26),
+				[](HotKeyProcData&) {}, HotKeyOptions::Scope::Windowed);
+		}
+	};
+
+	class Form : public Window {
+	public:
+		Form() : Window(L"destroy_subtree_bench", 800, 600, 0, 0, WS_OVERLAPPEDWINDOW) {}
+		std::vector<std::unique_ptr<Row>> rows;
+
+		void populate() {
+			HotKeyBatch batch;
+			rows.reserve(control_count);
+			for (size_t i = 0; i < control_count; ++i) {
+				auto row = std::make_unique<Row>();
+				row->set_parent(this);
+				row->create(L"row", 100, 20, static_cast<int>(i / 30) * 100, static_cast<int>(i % 30) * 20);
+				if (i < bound_count) row->bind(i);
+				rows.push_back(std::move(row));
+			}
+		}
+		void teardown() {
+			destroy_tree();
+		}
+		size_t live_handles() const {
+			size_t count = 0;
+			for (const auto& row : rows) {
+				if (handle_of(*row)) ++count;
+			}
+			return count;
+		}
+	protected:
+		void setup_event_handlers() override {}
+	};
+
+	double ms_since(bench::clock::time_point start) {
+		return bench::elapsed_ns(start) / 1e6;
+	}
+}
+
+int main() {
+	constexpr int rounds = 3;
+	double tree = 1e300, members = 1e300, each = 1e300;
+	size_t stale = 0;
+	for (int round = 0; round < rounds; ++round) {
+		{
+			Form form;
+			form.create();
+			form.populate();
+			auto start = bench::clock::now();
+			form.teardown();
+			tree = (std::min)(tree, ms_since(start));
+			stale = (std::max)(stale, form.live_handles());
+			start = bench::clock::now();
+			form.rows.clear();
+			members = (std::min)(members, ms_since(start));
+		}
+		{
+			Form form;
+			form.create();
+			form.populate();
+			auto start = bench::clock::now();
+			// 控件先于窗口析构，每个控件各自 DestroyWindow 并清理自己的状态
+			form.rows.clear();
+			form.teardown();
+			each = (std::min)(each, ms_since(start));
+		}
+	}
+	std::printf("%zu controls, %zu with hot keys\n", control_count, bound_count);
+	std::printf("%-48s %12.2f ms\n", "destroy_tree()", tree);
+	std::printf("%-48s %12zu\n", "controls still holding an HWND afterwards", stale);
+	std::printf("%-48s %12.2f ms\n", "destroying the control objects afterwards", members);
+	std::printf("%-48s %12.2f ms\n", "controls destroyed one by one", each);
+	return 0;
+}
@@ -0,0 +1,164 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 记事本示例打开大文件：显示出第一屏文字的时间、全部加载的时间和进程的内存峰值。
+//   whole  以前的做法：整个文件读进堆，整体转换成 UTF-16，一次 text() 交给编辑框
+//   stream 现在的做法：MappedFile + TextDecoder，先显示 64 KiB，之后每块 1 MiB 追加
+//   decode 同 stream，但不交给编辑框，只看加载器本身的开销
+// 内存峰值是整个进程的值，所以每个文件、每种做法都在单独的子进程中运行。
+// 用法：file_load_bench [大小（MB）...]，默认 10 100 1024；测试文件写在临时目录，结束后删除
+#include "Window.hpp"
+#include <psapi.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+using namespace w32oop::foundation;
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	double elapsed_ms(clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(clock::now() - since).count();
+	}
+
+	class Form : public Window {
+	public:
+		Form() : Window(L"file_load_bench", 800, 600, 0, 0, WS_OVERLAPPEDWINDOW) {}
+	protected:
+		void setup_event_handlers() override {}
+	};
+
+	// 中英文混排的 UTF-8 文本，写到 megabytes MB 为止
+	bool make_file(const std::wstring& path, size_t megabytes) {
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		std::string block;
+		for (int i = 0; block.size() < (1 << 20); ++i) {
+			block += "line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog, "
+				"\xE6\x95\x8F\xE6\x8D\xB7\xE7\x9A\x84\xE6\xA3\x95\xE8\x89\xB2\xE7\x8B\x90\xE7\x8B\xB8\r\n";
+		}
+		block.resize(1 << 20);
+		// 不在行中间截断多字节字符
+		block.resize(block.rfind('\n') + 1);
+		bool ok = true;
+		size_t total = megabytes << 20;
+		for (size_t written = 0; ok && written < total; written += block.size()) {
+			DWORD done = 0;
+			ok = WriteFile(file, block.data(), (DWORD)block.size(), &done, nullptr) && done == block.size();
+		}
+		CloseHandle(file);
+		return ok;
+	}
+
+	std::string read_all(const std::wstring& path) {
+		std::string bytes;
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return bytes;
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		bytes.resize((size_t)size.QuadPart);
+		size_t pos = 0;
+		while (pos < bytes.size()) {
+			DWORD want = (DWORD)(std::min)(bytes.size() - pos, (size_t)1 << 30), got = 0;
+			if (!ReadFile(file, bytes.data() + pos, want, &got, nullptr) || !got) break;
+			pos += got;
+		}
+		bytes.resize(pos);
+		CloseHandle(file);
+		return bytes;
+	}
+
+	// 子进程：按 mode 加载 path，输出一行结果
+	int run_child(const std::wstring& mode, const std::wstring& path) {
+		Form form;
+		Edit editor;
+		if (mode != L"decode") {
+			form.create();
+			editor.set_parent(form);
+			editor.create(L"", 620, 400, 10, 10, Edit::STYLE | ES_MULTILINE | WS_VSCROLL | ES_AUTOVSCROLL);
+			editor.max_length(0);
+		}
+		double first = 0;
+		size_t units = 0;
+		auto start = clock::now();
+		if (mode == L"whole") {
+			std::wstring text = util::s2ws(read_all(path));
+			units = text.size();
+			editor.text(text);
+			first = elapsed_ms(start);
+		}
+		else {
+			util::MappedFile file(path);
+			if (!file.is_open()) return 1;
+			util::TextDecoder decoder(file.bytes());
+			std::wstring chunk;
+			decoder.next(chunk, 64 * 1024);
+			units = chunk.size();
+			if (mode == L"stream") editor.text(chunk);
+			first = elapsed_ms(start);
+			while (decoder.next(chunk)) {
+				units += chunk.size();
+				if (mode == L"stream") editor.append(chunk);
+			}
+		}
+		double total = elapsed_ms(start);
+		PROCESS_MEMORY_COUNTERS memory{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+		std::printf("%-7ls first text %9.1f ms   all %9.1f ms   %11zu chars   peak working set %7.1f MB   peak private %7.1f MB\n",
+			mode.c_str(), first, total, units,
+			static_cast<double>(memory.PeakWorkingSetSize) / (1 << 20),
+			static_cast<double>(memory.PeakPagefileUsage) / (1 << 20));
+		std::fflush(stdout);
+		return 0;
+	}
+
+	bool spawn(const std::wstring& self, const std::wstring& mode, const std::wstring& path) {
+		std::wstring command = L"\"" + self + L"\" --child " + mode + L" \"" + path + L"\"";
+		STARTUPINFOW startup{};
+		startup.cb = sizeof(startup);
+		PROCESS_INFORMATION process{};
+		if (!CreateProcessW(self.c_str(), command.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process)) return false;
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD code = 1;
+		GetExitCodeProcess(process.hProcess, &code);
+		CloseHandle(process.hThread);
+		CloseHandle(process.hProcess);
+		return code == 0;
+	}
+}
+
+int wmain(int argc, wchar_t** argv) {
+	if (argc == 4 && std::wstring(argv[1]) == L"--child") return run_child(argv[2], argv[3]);
+
+	std::vector<size_t> sizes;
+	for (int i = 1; i < argc; ++i) sizes.push_back((size_t)_wtoi64(argv[i]));
+	if (sizes.empty()) sizes = { 10, 100, 1024 };
+
+	wchar_t buffer[MAX_PATH] = {};
+	GetModuleFileNameW(nullptr, buffer, MAX_PATH);
+	std::wstring self = buffer;
+	GetTempPathW(MAX_PATH, buffer);
+	std::wstring temp = buffer;
+
+	for (size_t megabytes : sizes) {
+		std::wstring path = temp + L"w32oop_file_load_bench_" + std::to_wstring(megabytes) + L".txt";
+		if (!make_file(path, megabytes)) {
+			std::printf("cannot write %ls\n", path.c_str());
+			return 1;
+		}
+		std::printf("%zu MB UTF-8\n", megabytes);
+		std::fflush(stdout);
+		for (const wchar_t* mode : { L"decode", L"stream", L"whole" }) {
+			if (!spawn(self, mode, path)) std::printf("%-7ls failed (out of memory?)\n", mode);
+		}
+		DeleteFileW(path.c_str());
+	}
+	return 0;
+}
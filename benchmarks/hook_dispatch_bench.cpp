@@ -0,0 +1,123 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 钩子上下文的两种取法：线程局部变量（现在的做法），
+// 以及原来的做法——每次 run() 生成一页可执行的跳板代码。
+// 分别测量安装/卸载一次线程键盘钩子的耗时，以及每个键盘消息经过钩子的额外耗时
+#include "bench.hpp"
+#include <windows.h>
+#include <cstring>
+
+using namespace w32oop;
+
+namespace {
+	struct Context {
+		uint64_t calls = 0;
+	};
+	thread_local Context* current = nullptr;
+	Context context;
+
+	LRESULT CALLBACK tls_proc(int code, WPARAM wParam, LPARAM lParam) {
+		if (code == HC_ACTION) ++current->calls;
+		return CallNextHookEx(NULL, code, wParam, lParam);
+	}
+
+	// 跳板的目标：和 tls_proc 做同样的事，但上下文是固定的，代表跳板传进来的那一个
+	LRESULT CALLBACK thunk_target(int code, WPARAM wParam, LPARAM lParam) {
+		if (code == HC_ACTION) ++context.calls;
+		return CallNextHookEx(NULL, code, wParam, lParam);
+	}
+
+	// 原来的安装过程：分配一页，写入跳板，改为可执行
+	struct Thunk {
+		void* page = nullptr;
+		HOOKPROC proc = nullptr;
+
+		bool create(HOOKPROC target) {
+			page = VirtualAlloc(NULL, 4096, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+			if (!page) return false;
+#if defined(_M_X64) || defined(__x86_64__)
+			// mov r10, &context; mov rax, target; jmp rax
+			unsigned char code[22] = { 0x49, 0xBA, 0, 0, 0, 0, 0, 0, 0, 0, 0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xE0 };
+			void* ctx = &context;
+			memcpy(code + 2, &ctx, 8);
+			memcpy(code + 12, &target, 8);
+			SIZE_T written = 0;
+			WriteProcessMemory(GetCurrentProcess(), page, code, sizeof(code), &written);
+			DWORD old = 0;
+			VirtualProtect(page, 4096, PAGE_EXECUTE_READ, &old);
+			FlushInstructionCache(GetCurrentProcess(), page, sizeof(code));
+			proc = reinterpret_cast<HOOKPROC>(page);
+#else
+			// 跳板只有 x64 版本；其他架构上只计入系统调用的开销
+			DWORD old = 0;
+			VirtualProtect(page, 4096, PAGE_EXECUTE_READ, &old);
+			proc = target;
+#endif
+			return true;
+		}
+		void destroy() {
+			if (page) VirtualFree(page, 0, MEM_RELEASE);
+			page = nullptr;
+		}
+	};
+
+	// 投递 batch 个按键消息再全部取出；钩子在 PeekMessage 取出按键消息时被调用
+	void pump_keys(uint64_t n) {
+		constexpr uint64_t batch = 1000;
+		DWORD thread = GetCurrentThreadId();
+		MSG msg;
+		for (uint64_t done = 0; done < n; done += batch) {
+			uint64_t count = (std::min)(batch, n - done);
+			for (uint64_t i = 0; i < count; ++i) PostThreadMessageW(thread, WM_KEYDOWN, 'A', 0);
+			while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {}
+		}
+	}
+}
+
+int main() {
+	DWORD thread = GetCurrentThreadId();
+	MSG msg;
+	PeekMessageW(&msg, NULL, 0, 0, PM_NOREMOVE); // 创建消息队列
+
+	bench::run("install+uninstall, thread-local context", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			current = &context;
+			HHOOK hook = SetWindowsHookExW(WH_KEYBOARD, tls_proc, NULL, thread);
+			UnhookWindowsHookEx(hook);
+			current = nullptr;
+		}
+	});
+	bench::run("install+uninstall, generated thunk", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			Thunk thunk;
+			if (!thunk.create(thunk_target)) return;
+			HHOOK hook = SetWindowsHookExW(WH_KEYBOARD, thunk.proc, NULL, thread);
+			UnhookWindowsHookEx(hook);
+			thunk.destroy();
+		}
+	});
+
+	bench::run("key message, no hook", pump_keys);
+	{
+		current = &context;
+		HHOOK hook = SetWindowsHookExW(WH_KEYBOARD, tls_proc, NULL, thread);
+		bench::run("key message, thread-local context", pump_keys);
+		UnhookWindowsHookEx(hook);
+		current = nullptr;
+	}
+	{
+		Thunk thunk;
+		if (thunk.create(thunk_target)) {
+			HHOOK hook = SetWindowsHookExW(WH_KEYBOARD, thunk.proc, NULL, thread);
+			bench::run("key message, generated thunk", pump_keys);
+			UnhookWindowsHookEx(hook);
+			thunk.destroy();
+		}
+	}
+	std::printf("hook calls: %llu\n", static_cast<unsigned long long>(context.calls));
+	return 0;
+}
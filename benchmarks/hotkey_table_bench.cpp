@@ -0,0 +1,121 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 钩子每次按键的查找开销（单键和多键序列），以及注册 N 个快捷键时逐个发布与批量发布的差别
+#include "bench.hpp"
+#include "HotKeyTable.hpp"
+#include <string>
+
+using namespace w32oop::hotkey;
+using namespace w32oop;
+
+namespace {
+	using BenchTable = Table<int>;
+
+	const int owner = 0, window = 0;
+
+	struct Resolver {
+		Foreground operator()() const {
+			return { &window, 7, 100 };
+		}
+	};
+
+	BenchTable::binding_type binding(Scope scope, int handler) {
+		BenchTable::binding_type result;
+		result.scope = scope;
+		result.owner = &owner;
+		result.window = &window;
+		result.thread = 7;
+		result.handler = handler;
+		return result;
+	}
+
+	uint32_t nth_key(size_t i) {
+		return pack(0x30 + static_cast<int>(i % 0x40), static_cast<uint32_t>(i / 0x40) & 0xFF);
+	}
+
+	BenchTable build(size_t count) {
+		BenchTable table;
+		for (size_t i = 0; i < count; ++i) table.insert(nth_key(i), binding(i % 2 ? Thread : System, static_cast<int>(i)));
+		return table;
+	}
+}
+
+int main() {
+	for (size_t count : { 16, 256, 10000 }) {
+		BenchTable table = build(count);
+		std::string name = "match hit, " + std::to_string(count) + " bindings";
+		bench::run(name.c_str(), [&](uint64_t n) {
+			const BenchTable::binding_type* hit = nullptr;
+			for (uint64_t i = 0; i < n; ++i) {
+				ForegroundCache<Resolver> foreground{ Resolver{} };
+				hit = table.match(nth_key(i % count), foreground, 100);
+				bench::keep(hit);
+			}
+		});
+		name = "match miss, " + std::to_string(count) + " bindings";
+		bench::run(name.c_str(), [&](uint64_t n) {
+			const BenchTable::binding_type* hit = nullptr;
+			for (uint64_t i = 0; i < n; ++i) {
+				ForegroundCache<Resolver> foreground{ Resolver{} };
+				hit = table.match(pack(0x20, Mod_Alt | Mod_Shift | Mod_Ctrl), foreground, 100);
+				bench::keep(hit);
+			}
+		});
+	}
+
+	// 多键序列：每次按键在前缀树当前节点上查找一次，与序列的数量无关
+	for (size_t count : { 10, 10000 }) {
+		SequenceTable<int> sequences;
+		for (size_t i = 0; i < count; ++i) {
+			sequences.insert({ nth_key(i % 4096), nth_key(i / 4096 + 1), pack('Z', Mod_Ctrl) },
+				binding(Thread, static_cast<int>(i)), 1000);
+		}
+		SequenceTrie<int> trie(sequences);
+		std::string name = "sequence advance, " + std::to_string(count) + " sequences";
+		bench::run(name.c_str(), [&](uint64_t n) {
+			SequenceState state;
+			const Binding<int>* matched = nullptr;
+			uint32_t now = 0;
+			for (uint64_t i = 0; i < n; ++i) {
+				ForegroundCache<Resolver> foreground{ Resolver{} };
+				// 三步一轮：两个中间步骤加上完成序列的一步
+				size_t which = (i / 3) % count;
+				uint32_t key = i % 3 == 0 ? nth_key(which % 4096) : i % 3 == 1 ? nth_key(which / 4096 + 1) : pack('Z', Mod_Ctrl);
+				auto step = advance(trie, 1, state, key, ++now, foreground, 100, false, matched);
+				bench::keep(static_cast<int>(step));
+			}
+		});
+	}
+
+	// Window 的主表每次发布都会被完整复制一份：
+	// 逐个发布时注册 N 个快捷键的代价是 O(N²)，用 Window::HotKeyBatch 批量发布则是 O(N)
+	for (size_t count : { 64, 512, 2048 }) {
+		std::string name = "register " + std::to_string(count) + ", publish each";
+		bench::run(name.c_str(), [&](uint64_t n) {
+			for (uint64_t round = 0; round < n; ++round) {
+				Published<BenchTable> published;
+				BenchTable table;
+				for (size_t i = 0; i < count; ++i) {
+					table.insert(nth_key(i), binding(Thread, static_cast<int>(i)));
+					published.publish(std::make_unique<const BenchTable>(table));
+				}
+			}
+		}, 3);
+		name = "register " + std::to_string(count) + ", publish once";
+		bench::run(name.c_str(), [&](uint64_t n) {
+			for (uint64_t round = 0; round < n; ++round) {
+				Published<BenchTable> published;
+				BenchTable table;
+				for (size_t i = 0; i < count; ++i) {
+					table.insert(nth_key(i), binding(Thread, static_cast<int>(i)));
+				}
+				published.publish(std::make_unique<const BenchTable>(table));
+			}
+		}, 3);
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 遍历 100k 行：以前的 Edit::get_line 每行分配一块 16384 字符的缓冲区，
+// 现在的 LineRange / read_lines 复用同一块缓冲区。行来源是内存中的假编辑框，只比较分配和复制的开销
+#include "bench.hpp"
+#include "LineRange.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+
+namespace {
+	const int line_count = 100000;
+
+	// 模拟 EM_GETLINE：把一行复制到调用者的缓冲区
+	struct StubEdit {
+		std::vector<std::wstring> rows;
+		StubEdit() {
+			for (int i = 0; i < line_count; ++i) rows.push_back(L"[" + std::to_wstring(i) + L"] the quick brown fox jumps over the lazy dog");
+		}
+		size_t copy_line(int line, wchar_t* out, size_t capacity) const {
+			const std::wstring& row = rows[(size_t)line];
+			size_t n = (std::min)(row.size(), capacity);
+			std::memcpy(out, row.data(), n * sizeof(wchar_t));
+			return n;
+		}
+		// 以前的 get_line：每次新建一块固定大小的缓冲区，再构造结果字符串
+		std::wstring get_line_old(int line) const {
+			std::vector<wchar_t> buffer(16384);
+			size_t n = copy_line(line, buffer.data(), buffer.size());
+			return std::wstring(buffer.data(), n);
+		}
+		size_t get_line_into(int line, std::wstring& out) const {
+			out.resize(rows[(size_t)line].size());
+			size_t n = copy_line(line, out.data(), out.size());
+			out.resize(n);
+			return n;
+		}
+	};
+}
+
+int main() {
+	const StubEdit edit;
+	bench::run("100k lines, get_line per line (old)", [&](uint64_t n) {
+		for (uint64_t round = 0; round < n; ++round) {
+			size_t total = 0;
+			for (int i = 0; i < line_count; ++i) total += edit.get_line_old(i).size();
+			bench::keep(total);
+		}
+	}, 3);
+	bench::run("100k lines, LineRange", [&](uint64_t n) {
+		for (uint64_t round = 0; round < n; ++round) {
+			size_t total = 0;
+			for (const auto& line : text::LineRange<const StubEdit>(&edit, text::clamp_lines(line_count, 0, -1))) total += line.size();
+			bench::keep(total);
+		}
+	}, 3);
+	std::vector<std::wstring> block;
+	bench::run("100k lines, read_lines into a reused vector", [&](uint64_t n) {
+		for (uint64_t round = 0; round < n; ++round) {
+			bench::keep(text::read_lines(edit, text::clamp_lines(line_count, 0, -1), block));
+		}
+	}, 3);
+	return 0;
+}
@@ -0,0 +1,55 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 1 GiB 文档（每行 80 个字符）上的片段表：建表、随机编辑、按行定位、绘制一屏和连续输入。
+// 用法：piece_table_bench [大小（MiB）]，默认 1024
+#include "bench.hpp"
+#include "PieceTable.hpp"
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace w32oop;
+using namespace w32oop::text;
+
+int main(int argc, char** argv) {
+	size_t megabytes = argc > 1 ? (size_t)std::strtoull(argv[1], nullptr, 10) : 1024;
+	std::string original(megabytes << 20, 'a');
+	for (size_t i = 79; i < original.size(); i += 80) original[i] = '\n';
+
+	auto start = bench::clock::now();
+	PieceTable table(original);
+	std::printf("%-48s %12.1f ms   %zu lines, %zu pieces\n", "build", bench::elapsed_ns(start) / 1e6, table.line_count(), table.pieces());
+
+	std::mt19937_64 rng(2);
+	bench::run("random insert / erase", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) {
+			size_t pos = rng() % table.size();
+			if (i & 1) table.erase(pos, 10);
+			else table.insert(pos, "hello\n");
+		}
+	});
+	std::printf("%-48s %12zu pieces\n", "", table.pieces());
+
+	bench::run("line_start of a random line", [&](uint64_t n) {
+		size_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i) sum += table.line_start(rng() % table.line_count());
+		bench::keep(sum);
+	});
+	bench::run("60 visible lines from a snapshot", [&](uint64_t n) {
+		size_t sum = 0;
+		for (uint64_t i = 0; i < n; ++i) {
+			table.snapshot().for_each_line(rng() % table.line_count(), 60, 4096, [&](std::string_view line) { sum += line.size(); });
+		}
+		bench::keep(sum);
+	});
+	size_t caret = table.size() / 2;
+	bench::run("typing one character", [&](uint64_t n) {
+		for (uint64_t i = 0; i < n; ++i) table.insert(caret++, "x");
+	});
+	std::printf("%-48s %12zu pieces\n", "", table.pieces());
+	return 0;
+}
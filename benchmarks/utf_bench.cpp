@@ -0,0 +1,82 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// UTF-8 <-> UTF-16 的吞吐量。utf_bench_scalar（W32OOP_UTF_NO_SIMD）和 utf_bench_avx2 是同一份代码的其他编译版本，
+// 对比三者的输出就能看出 SIMD 快速路径在不同文本上的收益
+#include "bench.hpp"
+#include "Utf.hpp"
+#include <random>
+#include <string>
+
+using namespace w32oop;
+
+namespace {
+	const size_t text_bytes = 1 << 20;
+
+	const char* simd_name() {
+#if W32OOP_UTF_AVX2
+		return "avx2";
+#elif W32OOP_UTF_SSE2
+		return "sse2";
+#elif W32OOP_UTF_NEON
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+
+	// 约 text_bytes 字节的 UTF-8 文本；ascii_percent 是 ASCII 字符的比例，其余字符在 [low, high) 中随机
+	std::string make_text(unsigned ascii_percent, char32_t low, char32_t high) {
+		std::mt19937 rng(44);
+		std::u16string units;
+		std::string text;
+		while (text.size() < text_bytes) {
+			if (rng() % 100 < ascii_percent) {
+				text += char(0x20 + rng() % 0x5F);
+				continue;
+			}
+			char32_t cp = low + rng() % (high - low);
+			char16_t pair[2] = {};
+			size_t n = 1;
+			if (cp < 0x10000) {
+				pair[0] = char16_t(cp);
+			}
+			else {
+				pair[0] = char16_t(0xD800 + ((cp - 0x10000) >> 10));
+				pair[1] = char16_t(0xDC00 + (cp & 0x3FF));
+				n = 2;
+			}
+			text += utf::to_utf8(std::u16string_view(pair, n));
+		}
+		return text;
+	}
+
+	void measure(const char* kind, const std::string& text) {
+		std::u16string wide = utf::to_utf16(text);
+		std::u16string decoded(text.size(), u'\0');
+		std::string encoded(wide.size() * 3, '\0');
+		std::string name = std::string(simd_name()) + " utf8->utf16, " + kind;
+		double ns = bench::run(name.c_str(), [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) bench::keep(utf::convert(text, decoded.data()).written);
+		});
+		std::printf("%-48s %12.0f MB/s\n", "", static_cast<double>(text.size()) / ns * 1e3);
+		name = std::string(simd_name()) + " utf16->utf8, " + kind;
+		ns = bench::run(name.c_str(), [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) bench::keep(utf::convert(wide, encoded.data()).written);
+		});
+		std::printf("%-48s %12.0f MB/s\n", "", static_cast<double>(text.size()) / ns * 1e3);
+	}
+}
+
+int main() {
+	// 每次操作转换约 1 MiB；MB/s 按 UTF-8 字节数计算
+	measure("ascii", make_text(100, 0, 1));
+	measure("ascii + 2% latin", make_text(98, 0xC0, 0x180));
+	measure("source code with cjk comments", make_text(85, 0x4E00, 0x9FA6));
+	measure("cjk", make_text(0, 0x4E00, 0x9FA6));
+	measure("emoji", make_text(50, 0x1F300, 0x1F600));
+	return 0;
+}
@@ -2,6 +2,7 @@
 #define UNICODE 1
 #define _UNICODE 1
 #include "../../Window.hpp"
+#include "../../SessionJournal.hpp"
 #include <fstream>
 // To simplify the code, we included a CPP
 // however, never do it in a real project!
@@ -47,10 +48,29 @@ namespace MyDemo {
         Edit lblFilePath;
         Edit txtEditor;
         std::wstring currentFilePath; // 当前文件路径
-        HFONT editorFont = NULL;
+        GdiFont editorFont;
+        // 正在加载的文件：整个映射进内存，每次解码一块追加到编辑框，两块之间界面保持响应
+        util::MappedFile loadingFile;
+        std::optional<util::TextDecoder> loader;
+        std::wstring loadedChunk;
+        bool loading = false;
         HANDLE hSessionLock = NULL;
         wstring session_file;
         wstring autoload;
+        // 会话日志：每次自动保存只追加变化的部分，日志过大时重写成一个快照
+        journal::Journal sessionJournal;
+        wstring sessionText;
+        bool sessionNeedsCompaction = false;
+        // 编辑框内容每次变化加一（包括加载文件）；与日志记录到的值相同时自动保存什么也不做
+        uint64_t contentRevision = 0;
+        uint64_t journaledRevision = 0;
+        wstring journaledPath;
+        // 保存在后台线程上进行，界面线程只交出一份文本的快照
+        std::optional<util::AsyncFileWriter> saver;
+        uint64_t editRevision = 0;       // 每次修改加一
+        LPARAM pendingSaveId = 0;      // 最近一次保存请求的序号
+        uint64_t pendingSaveRevision = 0; // 最近一次保存时的修改序号
+        bool closeAfterSave = false;
 
         bool unsaved = false;
 
@@ -68,6 +88,8 @@ namespace MyDemo {
 
     protected:
         void onCreated() override {
+            saver.emplace(hwnd, WM_USER + 4);
+
             // 创建 [打开文件] 按钮
             btnOpen.set_parent(*this);
             btnOpen.create(L"打开文件", 80, 30, 10, 10);
@@ -89,15 +111,17 @@ namespace MyDemo {
             lblFilePath.readonly(true);
 
             // 创建字体
-            editorFont = CreateFontW(-18, -9, 0, 0, FW_NORMAL, 0, 0, 0, DEFAULT_CHARSET,
-                OUT_CHARACTER_PRECIS, CLIP_CHARACTER_PRECIS, CLEARTYPE_QUALITY, FF_DONTCARE,
-                L"NSimsun");
+            editorFont = GdiCache::font(L"NSimsun", -18, -9, FW_NORMAL, CLEARTYPE_QUALITY);
 
             // 创建多行编辑框
             txtEditor.set_parent(*this);
             txtEditor.create(L"", 620, 400, 10, 50, 
                 WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_AUTOHSCROLL | ES_AUTOVSCROLL | ES_MULTILINE | ES_WANTRETURN | WS_HSCROLL | WS_VSCROLL);
+            txtEditor.max_length(0); // 多行编辑框：不限制长度，追加大文件时不会被截断
             txtEditor.onChange([&](EventData &) { 
+                ++contentRevision;
+                if (loading) return; // 加载时追加的内容不算修改
+                ++editRevision;
                 if (!unsaved) {
                     btnSave.text(L"请保存!");
                 }
@@ -106,7 +130,7 @@ namespace MyDemo {
             txtEditor.font(editorFont);
 
             register_hot_key(true, false, false, 'W', [this](HotKeyProcData& event){
-                event.preventDefault();
+                // Async: 回调在窗口线程上执行，可以直接操作界面，不需要再开线程
                 // 线程模式钩子需要一些额外处理
                 int repeat_count = event.lParam & 0x0000FFFF;
                 if (repeat_count > 1) return;
@@ -114,35 +138,32 @@ namespace MyDemo {
                 if (released_key) return;
 
                 close();
-            }, HotKeyOptions::Windowed);
+            }, HotKeyOptions::Windowed, HotKeyPolicy::Async());
             register_hot_key(true, false, false, 'O', [this](HotKeyProcData& event){
-                event.preventDefault();
                 // 线程模式钩子需要一些额外处理
                 int repeat_count = event.lParam & 0x0000FFFF;
                 if (repeat_count > 1) return;
                 int released_key = (event.lParam >> 31) & 1;
                 if (released_key) return;
 
-                thread([this](){ openFile(); }).detach();
-            }, HotKeyOptions::Windowed);
+                openFile();
+            }, HotKeyOptions::Windowed, HotKeyPolicy::Async());
             register_hot_key(true, false, false, 'S', [this](HotKeyProcData& event){
-                event.preventDefault();
                 // 线程模式钩子需要一些额外处理
                 int repeat_count = event.lParam & 0x0000FFFF;
                 if (repeat_count > 1) return;
                 int released_key = (event.lParam >> 31) & 1;
                 if (released_key) return;
-                thread([this](){ saveFile(); }).detach();
-            }, HotKeyOptions::Windowed);
+                saveFile();
+            }, HotKeyOptions::Windowed, HotKeyPolicy::Async());
             register_hot_key(true, false, true, 'S', [this](HotKeyProcData& event){
-                event.preventDefault();
                 // 线程模式钩子需要一些额外处理
                 int repeat_count = event.lParam & 0x0000FFFF;
                 if (repeat_count > 1) return;
                 int released_key = (event.lParam >> 31) & 1;
                 if (released_key) return;
-                thread([this](){ saveFile(true); }).detach();
-            }, HotKeyOptions::Windowed); // Ctrl+Shift+S
+                saveFile(true);
+            }, HotKeyOptions::Windowed, HotKeyPolicy::Async()); // Ctrl+Shift+S
 
             add_style_ex(WS_EX_ACCEPTFILES); // 允许接受文件
 
@@ -151,10 +172,7 @@ namespace MyDemo {
                 GetTempPathW(MAX_PATH, szTempFile);
                 GetTempFileNameW(wstring(szTempFile).c_str(), L"ntp", 0, szTempFile);
                 session_file = szTempFile;
-                hSessionLock = CreateFileW(
-                    session_file.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
-                    nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-                if (!hSessionLock || hSessionLock == INVALID_HANDLE_VALUE) {
+                if (!replaceSessionFile(sessionJournal.compact(L"", L""))) {
                     MessageBoxW(hwnd, L"无法锁定session！", NULL, MB_ICONERROR);
                     close();
                     return;
@@ -164,11 +182,15 @@ namespace MyDemo {
                     loadFile(autoload);
                 }
             } else {
-                // 恢复会话
-                loadFile(session_file, true);
-                hSessionLock = CreateFileW(
-                    session_file.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
-                    nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                // 恢复会话：回放日志，再压缩成一个快照继续使用
+                if (!restoreSession()) ExitProcess(0); // 已经失效
+                if (!replaceSessionFile(sessionJournal.compact(currentFilePath, sessionText))) {
+                    MessageBoxW(hwnd, L"无法锁定session！", NULL, MB_ICONERROR);
+                    close();
+                    return;
+                }
+                journaledRevision = contentRevision;
+                journaledPath = currentFilePath;
                 unsaved = true;
                 btnSave.text(L"请保存!");
             }
@@ -177,67 +199,116 @@ namespace MyDemo {
         }
         void onDestroy() override {
             if (hSessionLock) CloseHandle(hSessionLock);
-            if (editorFont) DeleteObject(editorFont);
             KillTimer(hwnd, 1);
         }
 
     public:
         void save_session(EventData& event) {
-            // 保存到session_file
-            string u8 = ConvertUTF16ToUTF8(txtEditor.text());
-            DWORD bytesWritten = 0;
-            // 写入文件路径
-            CloseHandle(hSessionLock);
-            hSessionLock = CreateFileW(
-                session_file.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
-                nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr); // 截断文件
-            if (!hSessionLock || hSessionLock == INVALID_HANDLE_VALUE) {
-                return event.returnValue(0);
+            if (loading) return event.returnValue(0); // 还没有加载完
+            // 上次记录之后没有修改：不读取文本，也不比较差异
+            if (!sessionNeedsCompaction && contentRevision == journaledRevision && currentFilePath == journaledPath) {
+                return event.returnValue(1);
             }
-            const wchar_t* filepath = currentFilePath.c_str();
-            DWORD dwFilePathLen = (DWORD)currentFilePath.length();
-            WriteFile(hSessionLock, &dwFilePathLen, sizeof(DWORD), &bytesWritten, nullptr);
-            if (dwFilePathLen) WriteFile(hSessionLock, filepath, DWORD(dwFilePathLen * sizeof(wchar_t)), &bytesWritten, nullptr);
-            // 写入文件内容
-            if (!WriteFile(hSessionLock, u8.c_str(), u8.length(), &bytesWritten, nullptr)) {
-                return event.returnValue(0);
+            uint64_t revision = contentRevision;
+            // 只追加上次保存之后的变化，写入量与编辑量有关，与文档大小无关
+            txtEditor.text_into(sessionText);
+            if (sessionNeedsCompaction || sessionJournal.should_compact()) {
+                sessionNeedsCompaction = !replaceSessionFile(sessionJournal.compact(currentFilePath, sessionText));
+                if (sessionNeedsCompaction) return event.returnValue(0);
             }
+            else {
+                std::string_view changes = sessionJournal.record(currentFilePath, sessionText);
+                if (!changes.empty() && !appendSessionFile(changes)) {
+                    // 文件和日志的状态可能已经不一致，下次整个重写
+                    sessionNeedsCompaction = true;
+                    return event.returnValue(0);
+                }
+            }
+            journaledRevision = revision;
+            journaledPath = currentFilePath;
             event.returnValue(1);
         }
-        void loadFile(wstring filePath, bool isRecovery = false) {
+        bool appendSessionFile(std::string_view bytes) {
+            if (!hSessionLock || hSessionLock == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER zero{};
+            if (!SetFilePointerEx(hSessionLock, zero, nullptr, FILE_END)) return false;
+            DWORD bytesWritten = 0;
+            return WriteFile(hSessionLock, bytes.data(), (DWORD)bytes.size(), &bytesWritten, nullptr)
+                && bytesWritten == bytes.size();
+        }
+        // 先写临时文件再替换，任何时刻崩溃都至少留下一个完整的会话文件
+        bool replaceSessionFile(std::string_view bytes) {
+            wstring temp = session_file + L".tmp";
+            HANDLE hTemp = CreateFileW(temp.c_str(), GENERIC_WRITE, 0,
+                nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (hTemp == INVALID_HANDLE_VALUE) return false;
+            DWORD bytesWritten = 0;
+            bool written = WriteFile(hTemp, bytes.data(), (DWORD)bytes.size(), &bytesWritten, nullptr)
+                && bytesWritten == bytes.size() && FlushFileBuffers(hTemp);
+            CloseHandle(hTemp);
+            if (hSessionLock && hSessionLock != INVALID_HANDLE_VALUE) CloseHandle(hSessionLock);
+            bool replaced = written && MoveFileExW(temp.c_str(), session_file.c_str(),
+                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+            if (!replaced) DeleteFileW(temp.c_str());
+            hSessionLock = CreateFileW(
+                session_file.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (hSessionLock == INVALID_HANDLE_VALUE) hSessionLock = NULL;
+            return replaced && hSessionLock;
+        }
+        bool restoreSession() {
+            util::MappedFile file(session_file);
+            if (!file.is_open()) return false;
+            // 末尾写到一半的记录被丢弃，恢复到最后一次完整保存的状态
+            journal::ReplayResult result = journal::replay(file.bytes());
+            if (!result.has_snapshot) return false;
+            currentFilePath.assign(result.document.path.begin(), result.document.path.end());
+            sessionText.assign(result.document.text.begin(), result.document.text.end());
+            lblFilePath.text(currentFilePath);
+            txtEditor.text(sessionText);
+            return true;
+        }
+        void loadFile(wstring filePath) {
             currentFilePath = filePath;
-            HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-            if (hFile == INVALID_HANDLE_VALUE) {
-                if (isRecovery) ExitProcess(0); // 已经失效
-                MessageBoxW(hwnd, (L"对不起！我打不开这个文件！原因是：" + to_wstring(GetLastError())).c_str(), L"Sorry!", MB_ICONERROR);
+            loader.reset(); // 先停止上一次加载，它引用着旧的映射
+            if (!loadingFile.open(filePath)) {
+                loading = false;
+                txtEditor.readonly(false);
+                MessageBoxW(hwnd, (L"对不起！我打不开这个文件！原因是：" + to_wstring(loadingFile.error())).c_str(), L"Sorry!", MB_ICONERROR);
                 return;
             }
-            char* buffer = new char[1024 * 1024 * 32 + 1]; // 32MB
-            DWORD bytesRead = 0;
-            if (isRecovery) {
-                // 读取文件名长度
-                DWORD fileNameLength = 0;
-                if (ReadFile(hFile, &fileNameLength, sizeof(DWORD), &bytesRead, nullptr)) {
-                    if (fileNameLength == 0) currentFilePath = L"";
-                    else {
-                        wchar_t* fileName = new wchar_t[fileNameLength + 1];
-                        if (ReadFile(hFile, fileName, fileNameLength * sizeof(wchar_t), &bytesRead, nullptr)) {
-                            fileName[fileNameLength] = L'\0'; // 确保字符串以空字符结尾
-                            currentFilePath = fileName;
-                            delete[] fileName;
-                        }
-                    }
-                }
-            }
-            if (ReadFile(hFile, buffer, 1024 * 1024 * 32, &bytesRead, nullptr)) {
-                wstring u16 = ConvertUTF8ToUTF16(buffer);
-                txtEditor.text(u16);
-            } else {
-                MessageBoxW(hwnd, (L"对不起！我读不出来这个文件！原因是：" + to_wstring(GetLastError())).c_str(), L"Sorry!", MB_ICONERROR);
+            lblFilePath.text(currentFilePath);
+            // 编码由 BOM 或内容判断
+            loader.emplace(loadingFile.bytes());
+            loading = true;
+            txtEditor.readonly(true); // 追加时会移动光标，加载完成前不允许编辑
+            // 第一块取小一些，尽快显示出内容
+            loader->next(loadedChunk, 64 * 1024);
+            txtEditor.text(loadedChunk);
+            if (!loader->done()) post(WM_USER + 3);
+            else loadNextChunk();
+        }
+        // 解码并追加下一块；全部加载完成后返回 false
+        bool loadNextChunk() {
+            if (!loader) return false;
+            loader->next(loadedChunk);
+            txtEditor.append(loadedChunk);
+            if (!loader->done()) {
+                lblFilePath.text(currentFilePath + L"（正在加载 " +
+                    to_wstring(loader->position() * 100 / loader->size()) + L"%）");
+                return true;
             }
-            CloseHandle(hFile);
-            delete[] buffer;
+            loader.reset();
+            loadingFile.close();
+            ++contentRevision; // 多行编辑框的 WM_SETTEXT 不发送 EN_CHANGE，加载的内容由这里标记
+            loading = false;
+            txtEditor.readonly(false);
             lblFilePath.text(currentFilePath);
+            return false;
+        }
+        void onLoadNextChunk(EventData &e) {
+            e.preventDefault();
+            if (loadNextChunk()) post(WM_USER + 3);
         }
         // 打开文件
         void openFile() {
@@ -269,8 +340,9 @@ namespace MyDemo {
             }
         }
 
-        // 保存文件
-        void saveFile(bool saveas = false) {
+        // 保存文件；请求已交给后台线程时返回 true，结果由 onSaveProgress 处理
+        bool saveFile(bool saveas = false) {
+            if (loading) return false; // 还没有加载完
             // 如果没有打开过文件，弹出“另存为”对话框
             if (saveas || currentFilePath.empty()) {
                 wchar_t filePath[MAX_PATH] = {0};
@@ -283,26 +355,16 @@ namespace MyDemo {
                 ofn.Flags = OFN_EXPLORER;
 
                 if (!GetSaveFileName(&ofn))
-                    return;
+                    return false;
                 currentFilePath = filePath;
                 lblFilePath.text(currentFilePath);
             }
 
-            // 写入文件
-            HANDLE hFile = CreateFileW(currentFilePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-            if (hFile == INVALID_HANDLE_VALUE) {
-                MessageBoxW(hwnd, (L"对不起！我不能保存这个文件！原因是：" + to_wstring(GetLastError())).c_str(), L"Sorry!", MB_ICONERROR); 
-                return;
-            }
-            string u8 = ConvertUTF16ToUTF8(txtEditor.text());
-            DWORD bytesWritten = 0;
-            if (!WriteFile(hFile, u8.c_str(), u8.length(), &bytesWritten, nullptr)) {
-                MessageBoxW(hwnd, (L"对不起！我写不了这个文件！原因是：" + to_wstring(GetLastError())).c_str(), L"Sorry!", MB_ICONERROR);
-            } else {
-                unsaved = false;
-                btnSave.text(L"保存文件");
-            }
-            CloseHandle(hFile);
+            // 编码和写入在后台进行；连续保存同一个文件时只会写最新的一份
+            pendingSaveRevision = editRevision;
+            pendingSaveId = saver->save(currentFilePath, txtEditor.text());
+            btnSave.text(L"正在保存");
+            return true;
         }
 
     private:
@@ -340,6 +402,33 @@ namespace MyDemo {
             txtEditor.move(editorLeft, editorTop);
         }
 
+        void onSaveProgress(EventData &e) {
+            e.preventDefault();
+            // 较早的请求被新的请求取代了，它的进度、结果和 Superseded 都不再关心
+            if (e.lParam != pendingSaveId) return;
+            switch (LOWORD(e.wParam)) {
+            case util::AsyncFileWriter::Progress:
+                btnSave.text(L"保存 " + to_wstring(HIWORD(e.wParam)) + L"%");
+                break;
+            case util::AsyncFileWriter::Succeeded:
+                if (pendingSaveRevision != editRevision) {
+                    // 保存期间又有修改，写进去的是旧的快照
+                    closeAfterSave = false;
+                    btnSave.text(L"请保存!");
+                    break;
+                }
+                unsaved = false;
+                btnSave.text(L"保存文件");
+                if (closeAfterSave) PostMessage(hwnd, WM_CLOSE, 0, 0);
+                break;
+            case util::AsyncFileWriter::Failed:
+                closeAfterSave = false;
+                btnSave.text(unsaved ? L"请保存!" : L"保存文件");
+                MessageBoxW(hwnd, (L"对不起！我不能保存这个文件！原因是：" + to_wstring(HIWORD(e.wParam))).c_str(), L"Sorry!", MB_ICONERROR);
+                break;
+            }
+        }
+
         void onWillClose(EventData &e) {
             if (!unsaved) {
                 CloseHandle(hSessionLock);
@@ -348,6 +437,11 @@ namespace MyDemo {
                 return;
             }
             e.preventDefault();
+            if (saver->busy() && pendingSaveRevision == editRevision) {
+                // 当前内容正在保存，写完后再关闭
+                closeAfterSave = true;
+                return;
+            }
             int r = 0;
             TaskDialog(hwnd, NULL, L"未保存的更改!", L"你有未保存的更改，是否保存？", 
                 L"如果不保存，更改将丢失！", TDCBF_YES_BUTTON | TDCBF_NO_BUTTON | TDCBF_CANCEL_BUTTON,
@@ -358,12 +452,8 @@ namespace MyDemo {
                 PostMessage(hwnd, WM_CLOSE, 0, 0);
             }
             else if (r == IDYES) {
-                // 保存
-                saveFile();
-                if (!unsaved) {
-                    // 然后关闭
-                    PostMessage(hwnd, WM_CLOSE, 0, 0);
-                }
+                // 保存，写完后在 onSaveProgress 中关闭
+                if (saveFile()) closeAfterSave = true;
             }
         }
         void onWillShutdown(EventData &e) {
@@ -418,6 +508,8 @@ namespace MyDemo {
             WINDOW_add_handler(WM_DROPFILES, onDrop);
             WINDOW_add_handler(WM_TIMER, onTimer);
             WINDOW_add_handler(WM_USER + 2, save_session);
+            WINDOW_add_handler(WM_USER + 3, onLoadNextChunk);
+            WINDOW_add_handler(WM_USER + 4, onSaveProgress);
         }
     };
 
@@ -443,4 +535,4 @@ int wmain(int argc, wchar_t* argv[]) {
     app.show();
     // message loop
     return Window::run();
-}
\ No newline at end of file
+}
\ No newline at end of file
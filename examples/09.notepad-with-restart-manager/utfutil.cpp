@@ -1,45 +1,37 @@
 ﻿#include<string>
+#include<string_view>
 #include<windows.h>
+#include "../../Utf.hpp"
 
-std::string ConvertUTF16ToUTF8(PCWSTR utf16Str);
+// 转换由 Utf.hpp 完成，只扫描一遍输入，非法序列替换为 U+FFFD
+inline std::string ConvertUTF16ToUTF8(std::wstring_view utf16Str) {
+	return w32oop::utf::to_utf8<std::string>(utf16Str);
+}
+inline std::string ConvertUTF16ToUTF8(PCWSTR utf16Str) {
+	if (utf16Str == nullptr) return "";
+	return ConvertUTF16ToUTF8(std::wstring_view(utf16Str));
+}
 inline std::string ConvertUTF16ToUTF8(const std::wstring& utf16Str) {
-	return ConvertUTF16ToUTF8(utf16Str.c_str());
+	return ConvertUTF16ToUTF8(std::wstring_view(utf16Str));
 }
 inline bool ConvertUTF16ToUTF8(
 	const std::wstring& utf16Str, std::string& receiver
 ) {
-	return (receiver = ConvertUTF16ToUTF8(utf16Str.c_str())).length();
+	return (receiver = ConvertUTF16ToUTF8(utf16Str)).length();
 }
 
-std::wstring ConvertUTF8ToUTF16(PCSTR utf8Str);
+inline std::wstring ConvertUTF8ToUTF16(std::string_view utf8Str) {
+	return w32oop::utf::to_utf16<std::wstring>(utf8Str);
+}
+inline std::wstring ConvertUTF8ToUTF16(PCSTR utf8Str) {
+	if (utf8Str == nullptr) return L"";
+	return ConvertUTF8ToUTF16(std::string_view(utf8Str));
+}
 inline std::wstring ConvertUTF8ToUTF16(const std::string& utf8Str) {
-	return ConvertUTF8ToUTF16(utf8Str.c_str());
+	return ConvertUTF8ToUTF16(std::string_view(utf8Str));
 }
 inline bool ConvertUTF8ToUTF16(
 	const std::string& utf8Str, std::wstring& receiver
 ) {
-	return (receiver = ConvertUTF8ToUTF16(utf8Str.c_str())).length();
-}
-
-
-std::string ConvertUTF16ToUTF8(PCWSTR utf16Str) {
-	if (utf16Str == nullptr) return "";
-	int utf16Len = static_cast<int>(wcslen(utf16Str));
-	int utf8Len = WideCharToMultiByte(CP_UTF8, 0, utf16Str,
-		utf16Len,	nullptr, 0, nullptr, nullptr);
-	std::string utf8Str(utf8Len, 0);  // 创建一个足够大的字符串来容纳UTF-8字符串
-	WideCharToMultiByte(CP_UTF8, 0, utf16Str, utf16Len, &utf8Str[0],
-		utf8Len, nullptr, nullptr);
-	return utf8Str;
-}
-
-std::wstring ConvertUTF8ToUTF16(PCSTR utf8Str) {
-	if (utf8Str == nullptr) return L"";
-	int utf8Len = static_cast<int>(strlen(utf8Str));
-	int utf16Len = MultiByteToWideChar(CP_UTF8, 0, utf8Str,
-		utf8Len, nullptr, 0);
-	std::wstring utf16Str(utf16Len, 0);  // 创建一个足够大的wstring来容纳UTF-16字符串
-	MultiByteToWideChar(CP_UTF8, 0, utf8Str, utf8Len,
-		&utf16Str[0], utf16Len);
-	return utf16Str;
+	return (receiver = ConvertUTF8ToUTF16(utf8Str)).length();
 }
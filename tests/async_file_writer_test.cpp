@@ -0,0 +1,132 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// util::AsyncFileWriter 的通知：每条通知都带着请求的序号，失败时带着错误码。
+// 通知投递给一个只接收消息的窗口，测试线程自己取消息
+#include "check.hpp"
+#include "Window.hpp"
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+
+namespace {
+	const UINT notify_message = WM_APP + 49;
+
+	struct Notice {
+		util::AsyncFileWriter::Notification kind;
+		WORD detail;
+		LPARAM id;
+	};
+
+	HWND message_window() {
+		return CreateWindowExW(0, L"STATIC", L"", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, GetModuleHandleW(NULL), NULL);
+	}
+
+	// 取通知直到收到 id 的 Succeeded 或 Failed
+	std::vector<Notice> collect(HWND window, LPARAM id) {
+		std::vector<Notice> notices;
+		MSG msg;
+		while (GetMessageW(&msg, window, notify_message, notify_message) > 0) {
+			Notice notice{ (util::AsyncFileWriter::Notification)LOWORD(msg.wParam), HIWORD(msg.wParam), msg.lParam };
+			notices.push_back(notice);
+			if (notice.id == id && notice.kind != util::AsyncFileWriter::Progress) break;
+		}
+		return notices;
+	}
+
+	std::wstring temp_directory() {
+		wchar_t buffer[MAX_PATH] = {};
+		GetTempPathW(MAX_PATH, buffer);
+		return buffer;
+	}
+
+	std::string read_file(const std::wstring& path) {
+		util::MappedFile file(path);
+		return std::string(file.bytes());
+	}
+}
+
+TEST(success_carries_the_request_id) {
+	HWND window = message_window();
+	CHECK(window != NULL);
+	std::wstring path = temp_directory() + L"w32oop_async_writer_test.txt";
+	LPARAM id = 0;
+	{
+		util::AsyncFileWriter writer(window, notify_message);
+		id = writer.save(path, L"hello \x4E16\x754C");
+		auto notices = collect(window, id);
+		CHECK(!notices.empty());
+		int last_percent = -1;
+		for (const auto& notice : notices) {
+			CHECK(notice.id == id);
+			if (notice.kind == util::AsyncFileWriter::Progress) {
+				CHECK(notice.detail <= 100 && (int)notice.detail > last_percent);
+				last_percent = notice.detail;
+			}
+		}
+		CHECK(last_percent == 100);
+		CHECK(notices.back().kind == util::AsyncFileWriter::Succeeded);
+	}
+	CHECK(read_file(path) == "hello \xE4\xB8\x96\xE7\x95\x8C");
+	DeleteFileW(path.c_str());
+	DestroyWindow(window);
+}
+
+TEST(failure_carries_the_request_id_and_error) {
+	HWND window = message_window();
+	std::wstring good = temp_directory() + L"w32oop_async_writer_test_ok.txt";
+	std::wstring bad = temp_directory() + L"w32oop_no_such_directory\\nested\\file.txt";
+	util::AsyncFileWriter writer(window, notify_message);
+	LPARAM failing = writer.save(bad, L"lost");
+	LPARAM succeeding = writer.save(good, L"kept");
+	CHECK(failing != succeeding);
+	auto notices = collect(window, succeeding);
+	bool failed = false, succeeded = false;
+	for (const auto& notice : notices) {
+		if (notice.kind == util::AsyncFileWriter::Failed) {
+			// 失败的通知能和成功的那次区分开
+			CHECK(notice.id == failing);
+			CHECK(notice.detail != 0);
+			failed = true;
+		}
+		if (notice.kind == util::AsyncFileWriter::Succeeded) {
+			CHECK(notice.id == succeeding);
+			succeeded = true;
+		}
+	}
+	CHECK(failed && succeeded);
+	CHECK(!writer.busy());
+	DeleteFileW(good.c_str());
+	DestroyWindow(window);
+}
+
+TEST(merged_requests_report_the_newest_id) {
+	HWND window = message_window();
+	std::wstring path = temp_directory() + L"w32oop_async_writer_test_merge.txt";
+	util::AsyncFileWriter writer(window, notify_message);
+	// 第一个请求可能已经开始写入；之后同一路径的请求合并成最后一个，被取代的序号收到 Superseded
+	std::vector<LPARAM> ids;
+	for (int i = 0; i < 5; ++i) ids.push_back(writer.save(path, L"version " + std::to_wstring(i)));
+	auto notices = collect(window, ids.back());
+	for (const auto& notice : notices) {
+		CHECK(notice.kind != util::AsyncFileWriter::Failed);
+		if (notice.id != ids.front() && notice.id != ids.back()) CHECK(notice.kind == util::AsyncFileWriter::Superseded);
+	}
+	// 除了最后一个，每个序号都以 Succeeded 或 Superseded 结束，且只结束一次
+	for (size_t i = 0; i + 1 < ids.size(); ++i) {
+		size_t endings = 0;
+		for (const auto& notice : notices) {
+			if (notice.id == ids[i] && notice.kind != util::AsyncFileWriter::Progress) ++endings;
+		}
+		CHECK(endings == 1);
+	}
+	CHECK(read_file(path) == "version 4");
+	DeleteFileW(path.c_str());
+	DestroyWindow(window);
+}
+
+TEST_MAIN()
@@ -0,0 +1,60 @@
+﻿#pragma once
+/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// 测试用的最小框架：TEST 注册用例，CHECK 失败时打印位置并继续，
+// main 返回失败的用例数。不引入第三方测试库
+#include <cstdio>
+#include <vector>
+
+namespace w32oop::test {
+	struct Case {
+		const char* name;
+		void (*run)();
+	};
+	inline std::vector<Case>& cases() {
+		static std::vector<Case> list;
+		return list;
+	}
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+	struct Registrar {
+		Registrar(const char* name, void (*run)()) {
+			cases().push_back({ name, run });
+		}
+	};
+	inline bool check(bool ok, const char* expr, const char* file, int line) {
+		if (!ok) {
+			std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+			++failures();
+		}
+		return ok;
+	}
+	inline int run_all() {
+		int failed = 0;
+		for (auto& item : cases()) {
+			int before = failures();
+			item.run();
+			bool ok = failures() == before;
+			if (!ok) ++failed;
+			std::printf("[%s] %s\n", ok ? "  OK  " : "FAILED", item.name);
+		}
+		std::printf("%zu cases, %d failed\n", cases().size(), failed);
+		return failed;
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static ::w32oop::test::Registrar name##_registrar(#name, name); \
+	static void name()
+
+#define CHECK(expr) ::w32oop::test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+#define TEST_MAIN() \
+	int main() { return ::w32oop::test::run_all(); }
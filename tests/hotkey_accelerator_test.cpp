@@ -0,0 +1,159 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// preferred_route 的路由规则，以及 compile_accelerators 把绑定翻译成 ACCEL 表
+#include "check.hpp"
+#include "HotKeyTable.hpp"
+
+using namespace w32oop::hotkey;
+
+namespace {
+	using TestTable = Table<int>;
+	using TestBinding = TestTable::binding_type;
+
+	const int root_a = 0, root_b = 0;
+	constexpr uint32_t thread_a = 11, thread_b = 12;
+
+	// 与 BackendSelector::attach 一样由 preferred_route 决定是否是加速键
+	TestBinding make(Scope scope, int handler, uint32_t key, bool synchronous = false, const void* root = &root_a, uint32_t thread = thread_a) {
+		TestBinding binding;
+		binding.scope = scope;
+		binding.window = root;
+		binding.thread = thread;
+		binding.swallow = true;
+		binding.synchronous = synchronous;
+		binding.accelerator = preferred_route(scope, key, true, synchronous) == Route::Accelerator;
+		binding.handler = handler;
+		return binding;
+	}
+
+	void add(TestTable& table, uint32_t key, Scope scope, int handler, bool synchronous = false, const void* root = &root_a, uint32_t thread = thread_a) {
+		CHECK(table.insert(key, make(scope, handler, key, synchronous, root, thread)));
+	}
+}
+
+TEST(preferred_route_rules) {
+	uint32_t plain = pack('S', Mod_Ctrl);
+	CHECK(preferred_route(Windowed, plain, true, false) == Route::Accelerator);
+	CHECK(preferred_route(Thread, plain, true, false) == Route::Accelerator);
+	CHECK(preferred_route(Thread, plain, true, true) == Route::Hook);
+	CHECK(preferred_route(Thread, plain, false, false) == Route::Hook);
+	CHECK(preferred_route(Process, plain, true, false) == Route::Hook);
+	CHECK(preferred_route(System, plain, true, false) == Route::Native);
+	CHECK(preferred_route(System, plain, false, false) == Route::LowLevelHook);
+	CHECK(preferred_route(System, plain, true, true) == Route::LowLevelHook);
+
+	// 加速键和 RegisterHotKey 都不能表达的键
+	for (int vk_code : { vk::LButton, vk::XButton2, vk::WheelDown, vk::LShift, vk::RMenu, vk::LWin }) {
+		uint32_t key = pack(vk_code, Mod_Ctrl);
+		CHECK(!native_expressible(key));
+		CHECK(preferred_route(Thread, key, true, false) == Route::Hook);
+		CHECK(preferred_route(System, key, true, false) == Route::LowLevelHook);
+	}
+	CHECK(native_expressible(pack(0x03, Mod_Ctrl))); // VK_CANCEL (Ctrl+Break)
+	CHECK(!native_expressible(pack(0, Mod_Ctrl)));
+}
+
+TEST(entries_are_sorted_and_numbered) {
+	TestTable table;
+	uint32_t save = pack('S', Mod_Ctrl), find = pack('F', Mod_Ctrl | Mod_Shift), help = pack(0x70, Mod_Alt);
+	add(table, help, Thread, 3);
+	add(table, save, Windowed, 1);
+	add(table, find, Thread, 2);
+
+	auto result = compile_accelerators(table, &root_a, thread_a);
+	CHECK(result.entries.size() == 3);
+	CHECK(result.bindings.size() == 3);
+	if (result.entries.size() != 3) return;
+	// 按打包后的键（修饰键在高位）排序，命令 id 依次递增
+	CHECK(result.entries[0] == (AccelEntry{ accel::VirtKey | accel::Control, 'S', accel::first_command }));
+	CHECK(result.entries[1] == (AccelEntry{ accel::VirtKey | accel::Control | accel::Shift, 'F', accel::first_command + 1 }));
+	CHECK(result.entries[2] == (AccelEntry{ accel::VirtKey | accel::Alt, 0x70, accel::first_command + 2 }));
+	CHECK(result.bindings[0].handler == 1);
+	CHECK(result.bindings[1].handler == 2);
+	CHECK(result.bindings[2].handler == 3);
+
+	CHECK(result.command(accel::first_command + 2)->handler == 3);
+	CHECK(result.command(accel::first_command + 3) == nullptr);
+	CHECK(result.command(accel::first_command - 1) == nullptr);
+	CHECK(result.command(0x0001) == nullptr);
+}
+
+TEST(only_bindings_for_this_root_and_thread) {
+	TestTable table;
+	add(table, pack('A', Mod_Ctrl), Windowed, 1, false, &root_a);
+	add(table, pack('B', Mod_Ctrl), Windowed, 2, false, &root_b);
+	add(table, pack('C', Mod_Ctrl), Thread, 3, false, &root_a, thread_a);
+	add(table, pack('D', Mod_Ctrl), Thread, 4, false, &root_a, thread_b);
+
+	auto a = compile_accelerators(table, &root_a, thread_a);
+	CHECK(a.bindings.size() == 2);
+	if (a.bindings.size() == 2) {
+		CHECK(a.bindings[0].handler == 1);
+		CHECK(a.bindings[1].handler == 3);
+	}
+	auto b = compile_accelerators(table, &root_b, thread_b);
+	CHECK(b.bindings.size() == 2);
+	if (b.bindings.size() == 2) {
+		CHECK(b.bindings[0].handler == 2);
+		CHECK(b.bindings[1].handler == 4);
+	}
+	CHECK(compile_accelerators(TestTable{}, &root_a, thread_a).entries.empty());
+}
+
+TEST(narrower_hook_binding_keeps_the_key_on_the_hook) {
+	// 同一个键上第一个生效的绑定不是加速键时，这个键不进表，仍由钩子按优先级处理
+	TestTable table;
+	uint32_t key = pack('K', Mod_Ctrl);
+	add(table, key, Windowed, 1, true);  // 同步，走钩子
+	add(table, key, Thread, 2);          // 异步，本可以是加速键
+	CHECK(compile_accelerators(table, &root_a, thread_a).entries.empty());
+	// 在另一个根窗口下 Windowed 绑定不生效，Thread 绑定胜出
+	auto other = compile_accelerators(table, &root_b, thread_a);
+	CHECK(other.bindings.size() == 1 && other.bindings[0].handler == 2);
+
+	// Process 作用域总是生效，它排在 Thread 之后，不影响 Thread 的加速键
+	TestTable process;
+	add(process, key, Thread, 3);
+	add(process, key, Process, 4);
+	auto result = compile_accelerators(process, &root_a, thread_a);
+	CHECK(result.bindings.size() == 1 && result.bindings[0].handler == 3);
+	// Process 绑定在另一个线程上胜出，这个键不进表
+	CHECK(compile_accelerators(process, &root_a, thread_b).entries.empty());
+}
+
+TEST(native_bindings_are_skipped) {
+	TestTable table;
+	uint32_t key = pack('N', Mod_Ctrl | Mod_Alt);
+	auto native = make(System, 1, key);
+	native.native_id = 9;
+	table.insert(key, native);
+	add(table, pack('M', Mod_Ctrl), Thread, 2);
+	auto result = compile_accelerators(table, &root_a, thread_a);
+	CHECK(result.bindings.size() == 1 && result.bindings[0].handler == 2);
+}
+
+TEST(table_is_capped_at_the_reserved_command_range) {
+	// 普通键盘键乘以修饰键组合不足 0x1000 个，这里把鼠标组合位也算进去凑出足够多的键
+	std::vector<int> keys;
+	for (int vk_code = 0x08; vk_code <= 0xFE; ++vk_code) {
+		if (native_expressible(pack(vk_code, Mod_None))) keys.push_back(vk_code);
+	}
+	TestTable table;
+	size_t count = accel::command_count + 16;
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t key = pack(keys[i % keys.size()], static_cast<uint32_t>(i / keys.size()));
+		CHECK(table.insert(key, make(Thread, static_cast<int>(i), key)));
+	}
+	auto result = compile_accelerators(table, &root_a, thread_a);
+	CHECK(result.entries.size() == accel::command_count);
+	CHECK(result.bindings.size() == accel::command_count);
+	for (size_t i = 0; i < result.entries.size(); ++i) {
+		CHECK(accel::is_command(result.entries[i].cmd));
+	}
+}
+
+TEST_MAIN()
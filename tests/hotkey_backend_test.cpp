@@ -0,0 +1,193 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// hotkey::BackendSelector：RegisterHotKey 后端的选择、回退和 id 分配。
+// Window.cpp 中的实现调用 RegisterHotKey；这里用记录调用的假后端代替
+#include "check.hpp"
+#include "HotKeyTable.hpp"
+#include <set>
+
+using namespace w32oop::hotkey;
+
+namespace {
+	class FakeNative : public NativeBackend {
+	public:
+		bool accept = true;       // add 的结果
+		bool synchronous = true;  // remove 的结果
+		std::set<int> active;
+		std::vector<uint32_t> added_keys;
+		int removes = 0;
+
+		bool add(const void*, int id, uint32_t key) override {
+			if (!accept) return false;
+			CHECK(active.insert(id).second);
+			added_keys.push_back(key);
+			return true;
+		}
+		bool remove(const void*, int id) override {
+			++removes;
+			CHECK(active.erase(id) == 1);
+			return synchronous;
+		}
+	};
+
+	using TestBinding = Binding<int>;
+
+	const int sink = 0;
+
+	TestBinding make(Scope scope, bool swallow = true, bool synchronous = false) {
+		TestBinding binding;
+		binding.scope = scope;
+		binding.swallow = swallow;
+		binding.synchronous = synchronous;
+		binding.target = &sink;
+		return binding;
+	}
+}
+
+TEST(system_async_swallowing_binding_goes_native) {
+	FakeNative native;
+	BackendSelector selector(native);
+	auto binding = make(System);
+	uint32_t key = pack('K', Mod_Ctrl | Mod_Alt);
+	CHECK(selector.attach(key, binding) == Route::Native);
+	CHECK(binding.native_id != 0);
+	CHECK(!binding.accelerator);
+	CHECK(native.active.count(binding.native_id) == 1);
+	CHECK(native.added_keys.size() == 1 && native.added_keys[0] == key);
+
+	selector.detach(binding);
+	CHECK(native.active.empty());
+	CHECK(native.removes == 1);
+}
+
+TEST(bindings_that_need_inspection_stay_on_hooks) {
+	FakeNative native;
+	BackendSelector selector(native);
+	uint32_t key = pack('K', Mod_Ctrl);
+
+	auto sync = make(System, false, true);
+	CHECK(selector.attach(key, sync) == Route::LowLevelHook);
+	auto passthrough = make(System, false, false);
+	CHECK(selector.attach(key, passthrough) == Route::LowLevelHook);
+	auto process = make(Process);
+	CHECK(selector.attach(key, process) == Route::Hook);
+	auto thread_sync = make(Thread, true, true);
+	CHECK(selector.attach(key, thread_sync) == Route::Hook);
+	CHECK(!thread_sync.accelerator);
+
+	// RegisterHotKey 不能表达鼠标键和单独的修饰键
+	auto mouse = make(System);
+	CHECK(selector.attach(pack(vk::XButton1, Mod_Ctrl), mouse) == Route::LowLevelHook);
+	auto modifier = make(System);
+	CHECK(selector.attach(pack(vk::LShift, Mod_Ctrl), modifier) == Route::LowLevelHook);
+	auto wheel = make(System);
+	CHECK(selector.attach(pack(vk::WheelUp, Mod_None), wheel) == Route::LowLevelHook);
+
+	CHECK(native.added_keys.empty());
+	for (auto* binding : { &sync, &passthrough, &process, &thread_sync, &mouse, &modifier, &wheel }) {
+		CHECK(binding->native_id == 0);
+	}
+}
+
+TEST(thread_and_windowed_async_bindings_become_accelerators) {
+	FakeNative native;
+	BackendSelector selector(native);
+	auto windowed = make(Windowed);
+	CHECK(selector.attach(pack('S', Mod_Ctrl), windowed) == Route::Accelerator);
+	CHECK(windowed.accelerator);
+	auto thread = make(Thread);
+	CHECK(selector.attach(pack(0x70, Mod_None), thread) == Route::Accelerator);
+	CHECK(thread.accelerator);
+	CHECK(native.added_keys.empty());
+
+	// 重新选择时清除上一次的结果
+	thread.synchronous = true;
+	CHECK(selector.attach(pack(0x70, Mod_None), thread) == Route::Hook);
+	CHECK(!thread.accelerator);
+}
+
+TEST(falls_back_to_low_level_hook_when_registration_fails) {
+	FakeNative native;
+	BackendSelector selector(native);
+	native.accept = false;
+	auto taken = make(System);
+	CHECK(selector.attach(pack('T', Mod_Ctrl), taken) == Route::LowLevelHook);
+	CHECK(taken.native_id == 0);
+	selector.detach(taken);
+	CHECK(native.removes == 0);
+
+	// 失败时分配的 id 被归还，下一个绑定拿到同一个 id
+	native.accept = true;
+	auto next = make(System);
+	CHECK(selector.attach(pack('U', Mod_Ctrl), next) == Route::Native);
+	CHECK(next.native_id == 1);
+}
+
+TEST(ids_are_reused_only_after_synchronous_removal) {
+	FakeNative native;
+	BackendSelector selector(native);
+	auto first = make(System), second = make(System);
+	selector.attach(pack('A', Mod_Alt), first);
+	selector.attach(pack('B', Mod_Alt), second);
+	CHECK(first.native_id != second.native_id);
+
+	int freed = first.native_id;
+	selector.detach(first);
+	auto third = make(System);
+	selector.attach(pack('C', Mod_Alt), third);
+	CHECK(third.native_id == freed);
+
+	// 异步注销的 id 可能还会收到 WM_HOTKEY，不能立即复用
+	native.synchronous = false;
+	int pending = second.native_id;
+	selector.detach(second);
+	auto fourth = make(System);
+	selector.attach(pack('D', Mod_Alt), fourth);
+	CHECK(fourth.native_id != pending);
+	CHECK(fourth.native_id != third.native_id);
+}
+
+TEST(runs_out_of_ids_gracefully) {
+	FakeNative native;
+	BackendSelector selector(native);
+	int last = 0;
+	for (int i = 0; i < 0xBFFF; ++i) {
+		auto binding = make(System);
+		if (selector.attach(pack('A', Mod_Alt), binding) != Route::Native) {
+			CHECK(false);
+			return;
+		}
+		last = binding.native_id;
+	}
+	CHECK(last == 0xBFFF);
+	auto overflow = make(System);
+	CHECK(selector.attach(pack('A', Mod_Alt), overflow) == Route::LowLevelHook);
+	CHECK(overflow.native_id == 0);
+}
+
+TEST(table_erase_releases_native_registrations) {
+	// Window.cpp 在 Table 的删除回调中调用 detach
+	FakeNative native;
+	BackendSelector selector(native);
+	Table<int> table;
+	const int owner = 0;
+	for (int vk_code : { 'A', 'B', 'C' }) {
+		auto binding = make(System);
+		binding.owner = &owner;
+		uint32_t key = pack(vk_code, Mod_Ctrl | Mod_Shift);
+		selector.attach(key, binding);
+		table.insert(key, binding);
+	}
+	CHECK(native.active.size() == 3);
+	auto detach = [&selector](const Table<int>::binding_type& binding) { selector.detach(binding); };
+	table.erase(pack('A', Mod_Ctrl | Mod_Shift), System, detach);
+	CHECK(native.active.size() == 2);
+	table.erase_owner(&owner, detach);
+	CHECK(native.active.empty());
+}
+
+TEST_MAIN()
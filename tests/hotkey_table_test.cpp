@@ -0,0 +1,311 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// hotkey::Table 的查找、优先级和按所有者删除，多键序列的前缀树，以及钩子耗时的统计
+#include "check.hpp"
+#include "HotKeyTable.hpp"
+
+using namespace w32oop::hotkey;
+
+namespace {
+	using TestTable = Table<int>;
+	using TestBinding = TestTable::binding_type;
+
+	const int owner_a = 0, owner_b = 0;
+	const int window_a = 0, window_b = 0;
+
+	TestBinding make(Scope scope, int handler, const void* owner = &owner_a) {
+		TestBinding binding;
+		binding.scope = scope;
+		binding.owner = owner;
+		binding.window = &window_a;
+		binding.thread = 7;
+		binding.handler = handler;
+		return binding;
+	}
+
+	struct Resolver {
+		Foreground value;
+		int* calls;
+		Foreground operator()() const {
+			++*calls;
+			return value;
+		}
+	};
+
+	ForegroundCache<Resolver> foreground(const void* window, uint32_t thread, uint32_t process, int& calls) {
+		return ForegroundCache<Resolver>(Resolver{ { window, thread, process }, &calls });
+	}
+}
+
+TEST(insert_rejects_duplicate_scope) {
+	TestTable table;
+	uint32_t key = pack('A', Mod_Ctrl);
+	CHECK(table.insert(key, make(Thread, 1)));
+	CHECK(!table.insert(key, make(Thread, 2)));
+	CHECK(table.insert(key, make(System, 3)));
+	CHECK(table.size() == 2);
+	CHECK(table.contains(key, Thread));
+	CHECK(table.contains(key, System));
+	CHECK(!table.contains(key, Windowed));
+	CHECK(!table.contains(pack('A', Mod_Shift), Thread));
+}
+
+TEST(find_returns_bindings_sorted_by_scope) {
+	TestTable table;
+	uint32_t key = pack('B', Mod_None);
+	table.insert(key, make(System, 4));
+	table.insert(key, make(Windowed, 1));
+	table.insert(key, make(Process, 3));
+	table.insert(key, make(Thread, 2));
+	auto list = table.find(key);
+	CHECK(list && list->size() == 4);
+	if (!list) return;
+	for (size_t i = 0; i < list->size(); ++i) {
+		CHECK((*list)[i].handler == static_cast<int>(i) + 1);
+	}
+	CHECK(table.find(pack('B', Mod_Alt)) == nullptr);
+}
+
+TEST(match_prefers_narrowest_accepting_scope) {
+	TestTable table;
+	uint32_t key = pack('C', Mod_Ctrl);
+	table.insert(key, make(Windowed, 1));
+	table.insert(key, make(Thread, 2));
+	table.insert(key, make(System, 4));
+
+	int calls = 0;
+	auto in_window = foreground(&window_a, 7, 100, calls);
+	auto hit = table.match(key, in_window, 100);
+	CHECK(hit && hit->handler == 1);
+
+	auto other_window = foreground(&window_b, 7, 100, calls);
+	hit = table.match(key, other_window, 100);
+	CHECK(hit && hit->handler == 2);
+
+	auto other_thread = foreground(&window_b, 8, 100, calls);
+	hit = table.match(key, other_thread, 100);
+	CHECK(hit && hit->handler == 4);
+
+	// 没有前台窗口时只有 System 作用域生效
+	auto nothing = foreground(nullptr, 0, 0, calls);
+	hit = table.match(key, nothing, 100);
+	CHECK(hit && hit->handler == 4);
+}
+
+TEST(match_resolves_foreground_at_most_once) {
+	TestTable table;
+	uint32_t key = pack('D', Mod_None);
+	table.insert(key, make(Windowed, 1));
+	table.insert(key, make(Thread, 2));
+	table.insert(key, make(Process, 3));
+
+	int calls = 0;
+	auto cache = foreground(&window_b, 8, 100, calls);
+	auto hit = table.match(key, cache, 100);
+	CHECK(hit && hit->handler == 3);
+	CHECK(calls == 1);
+
+	// 只有 System 绑定或者没有绑定时不需要解析前台窗口
+	TestTable global;
+	global.insert(key, make(System, 4));
+	calls = 0;
+	auto untouched = foreground(&window_a, 7, 100, calls);
+	CHECK(global.match(pack('E', Mod_None), untouched, 100) == nullptr);
+	CHECK(global.match(key, untouched, 100) != nullptr);
+	CHECK(calls == 0);
+	CHECK(!untouched.is_resolved());
+}
+
+TEST(match_skips_native_and_yields_to_accelerators) {
+	TestTable table;
+	uint32_t key = pack('F', Mod_Ctrl);
+	auto native = make(Thread, 1);
+	native.native_id = 5;
+	table.insert(key, native);
+	table.insert(key, make(System, 2));
+
+	int calls = 0;
+	auto cache = foreground(&window_a, 7, 100, calls);
+	auto hit = table.match(key, cache, 100);
+	CHECK(hit && hit->handler == 2);
+	hit = table.match(key, cache, 100, true);
+	CHECK(hit && hit->handler == 1);
+
+	// 加速键绑定胜出时钩子什么也不做，让按键走到消息循环
+	TestTable accelerators;
+	auto accelerator = make(Windowed, 3);
+	accelerator.accelerator = true;
+	accelerators.insert(key, accelerator);
+	accelerators.insert(key, make(System, 4));
+	CHECK(accelerators.match(key, cache, 100) == nullptr);
+	hit = accelerators.match(key, cache, 100, true);
+	CHECK(hit && hit->handler == 3);
+}
+
+TEST(erase_and_erase_owner) {
+	TestTable table;
+	uint32_t first = pack('G', Mod_None), second = pack('H', Mod_Shift);
+	table.insert(first, make(Thread, 1, &owner_a));
+	table.insert(first, make(System, 2, &owner_b));
+	table.insert(second, make(Thread, 3, &owner_a));
+
+	int erased = 0;
+	auto count_erased = [&erased](const TestBinding&) { ++erased; };
+	CHECK(!table.erase(first, Process, count_erased));
+	CHECK(table.erase(first, System, count_erased));
+	CHECK(erased == 1);
+	CHECK(!table.has_owner(&owner_b));
+	CHECK(table.size() == 2);
+
+	CHECK(table.erase_owner(&owner_a, count_erased) == 2);
+	CHECK(erased == 3);
+	CHECK(table.empty());
+	CHECK(table.find(first) == nullptr);
+	CHECK(table.find(second) == nullptr);
+	CHECK(table.erase_owner(&owner_a) == 0);
+}
+
+TEST(copies_are_independent) {
+	// Window 每次发布都复制主表；快照之后的修改不能影响已发布的表
+	TestTable table;
+	uint32_t key = pack('I', Mod_Alt);
+	table.insert(key, make(Thread, 1));
+	TestTable snapshot = table;
+	table.erase(key, Thread);
+	table.insert(key, make(Process, 2));
+	auto list = snapshot.find(key);
+	CHECK(list && list->size() == 1 && (*list)[0].handler == 1);
+	CHECK(snapshot.has_owner(&owner_a));
+}
+
+TEST(modifier_tracker_seed_and_update) {
+	ModifierTracker tracker;
+	tracker.seed(ModifierTracker::LCtrl, Mod_RButton | Mod_Ctrl);
+	CHECK(tracker.mask() == Mod_Ctrl);
+	// seed 只保留鼠标键位
+	CHECK(tracker.chord_mask(vk::LButton) == (Mod_Ctrl | Mod_RButton));
+	CHECK(tracker.chord_mask(vk::RButton) == Mod_Ctrl);
+
+	CHECK(tracker.update(vk::RShift, true));
+	CHECK(tracker.mask() == (Mod_Ctrl | Mod_Shift));
+	CHECK(tracker.update(vk::LControl, false));
+	CHECK(tracker.mask() == Mod_Shift);
+	CHECK(!tracker.update('A', true));
+	tracker.update_button(vk::RButton, false);
+	CHECK(tracker.chord_mask(vk::LButton) == Mod_Shift);
+}
+
+TEST(sequence_table_rejects_ambiguous_sequences) {
+	SequenceTable<int> table;
+	uint32_t k = pack('K', Mod_Ctrl), c = pack('C', Mod_Ctrl), u = pack('U', Mod_Ctrl);
+	CHECK(!table.insert({ k }, make(Thread, 1), 1000));
+	CHECK(table.insert({ k, c }, make(Thread, 1), 1000));
+	CHECK(!table.insert({ k, c }, make(Thread, 2), 1000));
+	CHECK(table.insert({ k, c }, make(System, 3), 1000));
+	CHECK(table.insert({ k, u }, make(Thread, 4), 1000));
+	// 互为前缀的序列无法区分
+	CHECK(!table.insert({ k, c, u }, make(Thread, 5), 1000));
+	CHECK(!table.insert({ k }, make(Process, 6), 1000));
+	CHECK(table.size() == 3);
+	CHECK(table.contains({ k, c }, System));
+	CHECK(table.erase({ k, c }, Thread));
+	CHECK(!table.contains({ k, c }, Thread));
+	CHECK(table.erase_owner(&owner_a) == 2);
+	CHECK(table.empty());
+}
+
+TEST(sequence_advance_pending_then_matched) {
+	SequenceTable<int> table;
+	uint32_t k = pack('K', Mod_Ctrl), c = pack('C', Mod_Ctrl), u = pack('U', Mod_Ctrl);
+	table.insert({ k, c }, make(Thread, 1), 500);
+	table.insert({ k, u }, make(Thread, 2), 500);
+	SequenceTrie<int> trie(table);
+	SequenceState state;
+	const Binding<int>* matched = nullptr;
+	int calls = 0;
+	auto cache = foreground(&window_a, 7, 100, calls);
+
+	CHECK(advance(trie, 1, state, k, 1000, cache, 100, false, matched) == SequenceStep::Pending);
+	// 修饰键本身不打断序列
+	CHECK(advance(trie, 1, state, pack(vk::LControl, Mod_Ctrl), 1100, cache, 100, false, matched) == SequenceStep::None);
+	CHECK(advance(trie, 1, state, u, 1200, cache, 100, false, matched) == SequenceStep::Matched);
+	CHECK(matched && matched->handler == 2);
+	CHECK(state.node == 0);
+	CHECK(advance(trie, 1, state, u, 1300, cache, 100, false, matched) == SequenceStep::None);
+	// System 作用域只由低级钩子处理
+	CHECK(advance(trie, 1, state, k, 1400, cache, 100, true, matched) == SequenceStep::None);
+}
+
+TEST(sequence_advance_resets_on_timeout_and_new_trie) {
+	SequenceTable<int> table;
+	uint32_t k = pack('K', Mod_Ctrl), c = pack('C', Mod_Ctrl);
+	table.insert({ k, c }, make(Thread, 1), 500);
+	SequenceTrie<int> trie(table);
+	SequenceState state;
+	const Binding<int>* matched = nullptr;
+	int calls = 0;
+	auto cache = foreground(&window_a, 7, 100, calls);
+
+	// 超时后第二步不再接上，按普通按键处理
+	CHECK(advance(trie, 1, state, k, 1000, cache, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 1, state, c, 1501, cache, 100, false, matched) == SequenceStep::None);
+	// 毫秒计数回绕时仍然按先后比较
+	CHECK(advance(trie, 1, state, k, 0xFFFFFF00u, cache, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 1, state, c, 0x00000010u, cache, 100, false, matched) == SequenceStep::Matched);
+	// 发布了新的前缀树，旧的节点编号不再有效
+	CHECK(advance(trie, 1, state, k, 2000, cache, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 2, state, c, 2100, cache, 100, false, matched) == SequenceStep::None);
+	// 错误的第二步本身可能是新序列的开头
+	CHECK(advance(trie, 2, state, k, 2200, cache, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 2, state, k, 2300, cache, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 2, state, c, 2400, cache, 100, false, matched) == SequenceStep::Matched);
+}
+
+TEST(sequence_advance_ignores_unreachable_scopes) {
+	SequenceTable<int> table;
+	uint32_t k = pack('K', Mod_Ctrl), c = pack('C', Mod_Ctrl);
+	table.insert({ k, c }, make(Windowed, 1), 500);
+	SequenceTrie<int> trie(table);
+	SequenceState state;
+	const Binding<int>* matched = nullptr;
+	int calls = 0;
+	// 前台是另一个窗口：第一步就不吞键
+	auto other = foreground(&window_b, 8, 100, calls);
+	CHECK(advance(trie, 1, state, k, 1000, other, 100, false, matched) == SequenceStep::None);
+	auto own = foreground(&window_a, 7, 100, calls);
+	CHECK(advance(trie, 1, state, k, 1000, own, 100, false, matched) == SequenceStep::Pending);
+	CHECK(advance(trie, 1, state, c, 1100, own, 100, false, matched) == SequenceStep::Matched);
+	CHECK(matched && matched->handler == 1);
+}
+
+TEST(latency_buckets_by_bit_width) {
+	CHECK(latency_bucket(0) == 0);
+	CHECK(latency_bucket(1) == 1);
+	CHECK(latency_bucket(2) == 2);
+	CHECK(latency_bucket(3) == 2);
+	CHECK(latency_bucket(1024) == 11);
+	CHECK(latency_bucket(~uint64_t(0)) == latency_bucket_count - 1);
+}
+
+TEST(latency_histogram_stats) {
+	LatencyHistogram histogram;
+	CHECK(histogram.stats().percentile(0.5) == 0);
+	for (int i = 0; i < 98; ++i) histogram.record(10);
+	histogram.record(300);
+	histogram.record(5000);
+	auto stats = histogram.stats();
+	CHECK(stats.count == 100);
+	CHECK(stats.max_us == 5000);
+	CHECK(stats.mean_us() == (98 * 10 + 300 + 5000) / 100);
+	// 返回所在桶的上界：10 在 [8, 16)，300 在 [256, 512)
+	CHECK(stats.percentile(0.5) == 15);
+	CHECK(stats.percentile(0.99) == 511);
+	// 不超过最大值
+	CHECK(stats.percentile(1.0) == 5000);
+}
+
+TEST_MAIN()
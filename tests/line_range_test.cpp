@@ -0,0 +1,94 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// text::LineRange / read_lines / clamp_lines，用假的行来源代替编辑框
+#include "check.hpp"
+#include "LineRange.hpp"
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+
+namespace {
+	// 记录每一行被读了几次
+	struct FakeSource {
+		std::vector<std::wstring> rows;
+		std::vector<int> reads;
+		explicit FakeSource(size_t count) : reads(count) {
+			for (size_t i = 0; i < count; ++i) rows.push_back(L"line " + std::to_wstring(i) + std::wstring(i % 7, L'.'));
+		}
+		size_t get_line_into(int line, std::wstring& out) {
+			++reads[(size_t)line];
+			out.assign(rows[(size_t)line]);
+			return out.size();
+		}
+	};
+}
+
+TEST(clamp_lines_limits_to_total) {
+	auto span = text::clamp_lines(10, 0, -1);
+	CHECK(span.first == 0 && span.last == 10 && span.size() == 10);
+	span = text::clamp_lines(10, 3, 4);
+	CHECK(span.first == 3 && span.last == 7);
+	span = text::clamp_lines(10, 8, 5);
+	CHECK(span.first == 8 && span.last == 10);
+	span = text::clamp_lines(10, -5, 2);
+	CHECK(span.first == 0 && span.last == 2);
+	span = text::clamp_lines(10, 12, 1);
+	CHECK(span.first == 10 && span.size() == 0);
+	span = text::clamp_lines(10, 4, 0);
+	CHECK(span.size() == 0);
+	span = text::clamp_lines(0, 0, -1);
+	CHECK(span.size() == 0);
+}
+
+TEST(range_visits_each_line_once) {
+	FakeSource source(20);
+	text::LineRange<FakeSource> range(&source, text::clamp_lines(20, 5, 10));
+	CHECK(range.size() == 10);
+	int expected = 5;
+	for (auto it = range.begin(); it != range.end(); ++it) {
+		CHECK(it.index() == expected);
+		// 同一行解引用多次只读一次
+		CHECK(*it == source.rows[(size_t)expected]);
+		CHECK(it->size() == source.rows[(size_t)expected].size());
+		++expected;
+	}
+	CHECK(expected == 15);
+	for (int i = 0; i < 20; ++i) CHECK(source.reads[(size_t)i] == (i >= 5 && i < 15 ? 1 : 0));
+}
+
+TEST(range_reads_lazily) {
+	FakeSource source(5);
+	text::LineRange<FakeSource> range(&source, text::clamp_lines(5, 0, -1));
+	auto it = range.begin();
+	++it;
+	it++;
+	CHECK(*it == source.rows[2]);
+	CHECK(source.reads[0] == 0 && source.reads[1] == 0 && source.reads[2] == 1);
+	size_t count = 0;
+	for (const auto& line : text::LineRange<FakeSource>(&source, text::clamp_lines(5, 9, -1))) {
+		(void)line;
+		++count;
+	}
+	CHECK(count == 0);
+}
+
+TEST(read_lines_reuses_strings) {
+	FakeSource source(50);
+	std::vector<std::wstring> out;
+	CHECK(text::read_lines(source, text::clamp_lines(50, 10, 20), out) == 20);
+	CHECK(out.size() == 20 && out.front() == source.rows[10] && out.back() == source.rows[29]);
+	out[0].reserve(1000);
+	const wchar_t* storage = out[0].data();
+	CHECK(text::read_lines(source, text::clamp_lines(50, 40, -1), out) == 10);
+	CHECK(out.size() == 10 && out[0] == source.rows[40] && out[9] == source.rows[49]);
+	CHECK(out[0].data() == storage);
+	CHECK(text::read_lines(source, text::clamp_lines(50, 60, -1), out) == 0);
+	CHECK(out.empty());
+}
+
+TEST_MAIN()
@@ -0,0 +1,207 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// logging::LineRing 的环绕、改容量和序号，logging::LineBatch 的攒批、丢弃计数和 rearm
+#include "check.hpp"
+#include "LogBuffer.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace w32oop::logging;
+
+namespace {
+	std::wstring nth(uint64_t i) {
+		return L"line " + std::to_wstring(i);
+	}
+
+	// 检查 ring 按顺序保存 [first, end) 这些行，find 与下标一致
+	bool holds(const LineRing& ring, uint64_t first, uint64_t end) {
+		if (ring.first_sequence() != first || ring.end_sequence() != end || ring.size() != end - first) return false;
+		for (uint64_t s = first; s < end; ++s) {
+			if (ring[(size_t)(s - first)] != nth(s)) return false;
+			const std::wstring* found = ring.find(s);
+			if (!found || found != &ring[(size_t)(s - first)]) return false;
+		}
+		return (first == 0 || !ring.find(first - 1)) && !ring.find(end);
+	}
+
+	void push_range(LineRing& ring, uint64_t first, uint64_t end) {
+		for (uint64_t s = first; s < end; ++s) ring.push(nth(s));
+	}
+}
+
+TEST(splits_lines) {
+	std::vector<std::wstring> lines;
+	auto collect = [&](std::wstring_view line) { lines.emplace_back(line); };
+	for_each_line(L"a\r\nb\n\nc", collect);
+	CHECK((lines == std::vector<std::wstring>{ L"a", L"b", L"", L"c" }));
+	lines.clear();
+	for_each_line(L"x\n", collect);
+	CHECK((lines == std::vector<std::wstring>{ L"x" }));
+	lines.clear();
+	for_each_line(L"", collect);
+	CHECK((lines == std::vector<std::wstring>{ L"" }));
+}
+
+TEST(ring_wraps_around) {
+	LineRing ring(10);
+	CHECK(ring.empty() && holds(ring, 0, 0));
+	push_range(ring, 0, 7);
+	CHECK(holds(ring, 0, 7));
+	push_range(ring, 7, 10);
+	CHECK(holds(ring, 0, 10));
+	// 每个位置都环绕过几次
+	for (uint64_t end = 11; end <= 45; ++end) {
+		ring.push(nth(end - 1));
+		CHECK(holds(ring, end - 10, end));
+	}
+}
+
+TEST(ring_truncates_long_lines) {
+	LineRing ring(4, 5);
+	ring.push(L"0123456789");
+	std::wstring line = L"abcdefgh";
+	ring.push_swap(line);
+	CHECK(ring[0] == L"01234" && ring[1] == L"abcde");
+	ring.max_line_length(2);
+	ring.push(L"xyz");
+	CHECK(ring[2] == L"xy" && ring.max_line_length() == 2);
+}
+
+TEST(ring_shrinks_to_newest_lines) {
+	for (uint64_t pushed : { 3, 10, 13, 27 }) {
+		LineRing ring(10);
+		push_range(ring, 0, pushed);
+		ring.capacity(4);
+		uint64_t first = pushed > 4 ? pushed - 4 : 0;
+		CHECK(ring.capacity() == 4);
+		CHECK(holds(ring, first, pushed));
+		push_range(ring, pushed, pushed + 6);
+		CHECK(holds(ring, pushed + 2, pushed + 6));
+	}
+	LineRing ring(5);
+	push_range(ring, 0, 5);
+	ring.capacity(0);
+	CHECK(ring.capacity() == 1 && holds(ring, 4, 5));
+}
+
+TEST(ring_grows_without_losing_order) {
+	for (uint64_t pushed : { 3, 5, 8, 12 }) {
+		LineRing ring(5);
+		push_range(ring, 0, pushed);
+		uint64_t first = pushed > 5 ? pushed - 5 : 0;
+		ring.capacity(9);
+		CHECK(holds(ring, first, pushed));
+		push_range(ring, pushed, pushed + 20);
+		CHECK(holds(ring, pushed + 11, pushed + 20));
+	}
+}
+
+TEST(clear_keeps_sequences) {
+	LineRing ring(4);
+	push_range(ring, 0, 6);
+	ring.clear();
+	CHECK(ring.empty() && holds(ring, 6, 6));
+	push_range(ring, 6, 9);
+	CHECK(holds(ring, 6, 9));
+}
+
+TEST(take_from_swaps_strings) {
+	LineRing target(3), source(3);
+	// 超过短字符串优化的长度，才能比较缓冲区地址
+	const std::wstring padding(64, L'.');
+	for (int i = 0; i < 3; ++i) target.push(L"old " + std::to_wstring(i) + padding);
+	for (int i = 0; i < 2; ++i) source.push(L"new " + std::to_wstring(i) + padding);
+	const wchar_t* moved[2] = { source[0].data(), source[1].data() };
+	const wchar_t* evicted[2] = { target[0].data(), target[1].data() };
+
+	target.take_from(source);
+	CHECK(target.size() == 3 && target.first_sequence() == 2 && target.end_sequence() == 5);
+	CHECK(target[0] == L"old 2" + padding);
+	CHECK(target[1] == L"new 0" + padding && target[2] == L"new 1" + padding);
+	// 源的字符串整块移进来，没有复制
+	CHECK(target[1].data() == moved[0] && target[2].data() == moved[1]);
+	CHECK(source.empty() && source.first_sequence() == 2 && source.end_sequence() == 2);
+
+	// 被覆盖的字符串换回源的槽位，下一次 push 直接复用它们的容量
+	source.push(L"reuse");
+	source.push(L"reuse");
+	CHECK(source[0].data() == evicted[0] && source[1].data() == evicted[1]);
+}
+
+TEST(batch_signals_once_per_drain) {
+	LineBatch batch;
+	LineRing view(100);
+	CHECK(batch.push(L"a"));
+	CHECK(!batch.push(L"b"));
+	CHECK(!batch.push_text(L"c\nd"));
+	CHECK(batch.size() == 4);
+	CHECK(batch.drain(view) == 4);
+	CHECK(view.size() == 4 && view[3] == L"d" && batch.size() == 0);
+	CHECK(batch.push_text(L"e\r\nf\r\n"));
+	CHECK(batch.drain(view) == 2);
+	CHECK(view[5] == L"f");
+	// drain 之后没有新行时不需要再 drain
+	CHECK(batch.drain(view) == 0);
+	CHECK(batch.push(L"g"));
+}
+
+TEST(batch_rearm_after_failed_post) {
+	LineBatch batch;
+	CHECK(batch.push(L"a"));
+	CHECK(!batch.push(L"b"));
+	batch.rearm();
+	CHECK(batch.push(L"c"));
+	CHECK(!batch.push(L"d"));
+	LineRing view;
+	CHECK(batch.drain(view) == 4);
+}
+
+TEST(batch_counts_dropped_lines) {
+	LineBatch batch(5);
+	LineRing view(100);
+	for (int i = 0; i < 8; ++i) batch.push(nth(i));
+	CHECK(batch.size() == 5 && batch.dropped() == 3);
+	CHECK(batch.drain(view) == 5);
+	CHECK(view[0] == nth(3) && view[4] == nth(7));
+	batch.push_text(L"1\n2\n3\n4\n5\n6\n7");
+	CHECK(batch.dropped() == 5);
+	CHECK(batch.drain(view) == 5);
+	CHECK(view[5] == L"3");
+	// 改小容量之后按新的容量计数
+	batch.capacity(2);
+	for (int i = 0; i < 4; ++i) batch.push(nth(i));
+	CHECK(batch.dropped() == 7 && batch.size() == 2);
+	CHECK(batch.drain(view) == 2 && view[view.size() - 1] == nth(3));
+}
+
+TEST(batch_accounts_for_every_line_across_threads) {
+	const int producers = 4, per_producer = 20000;
+	LineBatch batch(256);
+	LineRing view(1000);
+	std::atomic<int> finished{ 0 };
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p) {
+		threads.emplace_back([&, p] {
+			for (int i = 0; i < per_producer; ++i) batch.push(nth((uint64_t)p * per_producer + i));
+			finished.fetch_add(1);
+		});
+	}
+	uint64_t drained = 0;
+	while (finished.load() < producers) {
+		drained += batch.drain(view);
+		std::this_thread::yield();
+	}
+	for (auto& thread : threads) thread.join();
+	drained += batch.drain(view);
+	CHECK(drained + batch.dropped() == (uint64_t)producers * per_producer);
+	CHECK(view.end_sequence() == drained);
+	CHECK(view.size() == (std::min)(drained, (uint64_t)view.capacity()));
+}
+
+TEST_MAIN()
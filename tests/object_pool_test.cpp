@@ -0,0 +1,157 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// pool::Recycler：ControlPool 的簿记部分（新建、重用、放回、上限）
+#include "check.hpp"
+#include "ObjectPool.hpp"
+#include <stdexcept>
+#include <string>
+
+using namespace w32oop::pool;
+
+namespace {
+	int alive = 0;
+
+	// 代替控件：记录被新建、重用和放回的次数
+	struct Item {
+		std::string text;
+		int reused = 0;
+		bool parked = false;
+		explicit Item(std::string value) : text(std::move(value)) {
+			++alive;
+		}
+		~Item() {
+			--alive;
+		}
+	};
+
+	struct Counters {
+		int created = 0;
+		int reused = 0;
+		int parked = 0;
+	};
+
+	Item& take(Recycler<Item>& pool, Counters& counters, const std::string& text) {
+		return pool.acquire(
+			[&] {
+				++counters.created;
+				return std::make_unique<Item>(text);
+			},
+			[&](Item& item) {
+				++counters.reused;
+				++item.reused;
+				item.parked = false;
+				item.text = text;
+			});
+	}
+
+	auto parker(Counters& counters) {
+		return [&counters](Item& item) {
+			++counters.parked;
+			item.parked = true;
+		};
+	}
+}
+
+TEST(released_items_are_reused) {
+	{
+		Recycler<Item> pool(8);
+		Counters counters;
+		Item& a = take(pool, counters, "a");
+		Item& b = take(pool, counters, "b");
+		CHECK(counters.created == 2);
+		CHECK(pool.in_use() == 2);
+		CHECK(pool.owns(a) && pool.owns(b));
+
+		CHECK(pool.release(a, parker(counters)));
+		CHECK(counters.parked == 1);
+		CHECK(pool.in_use() == 1 && pool.idle() == 1);
+		CHECK(!pool.owns(a));
+
+		// 最近放回的先被取出，内容由 reuse 更新
+		Item& c = take(pool, counters, "c");
+		CHECK(&c == &a);
+		CHECK(c.text == "c" && c.reused == 1 && !c.parked);
+		CHECK(counters.created == 2 && counters.reused == 1);
+		CHECK(pool.idle() == 0 && pool.in_use() == 2);
+	}
+	CHECK(alive == 0);
+}
+
+TEST(foreign_or_double_release_is_ignored) {
+	Recycler<Item> pool(8);
+	Counters counters;
+	Item outsider("x");
+	CHECK(!pool.release(outsider, parker(counters)));
+	Item& a = take(pool, counters, "a");
+	CHECK(pool.release(a, parker(counters)));
+	CHECK(!pool.release(a, parker(counters)));
+	CHECK(counters.parked == 1);
+	CHECK(pool.idle() == 1);
+}
+
+TEST(high_water_limits_idle_items) {
+	{
+		Recycler<Item> pool(2);
+		Counters counters;
+		std::vector<Item*> items;
+		for (int i = 0; i < 5; ++i) items.push_back(&take(pool, counters, std::to_string(i)));
+		CHECK(alive == 5);
+		for (auto item : items) pool.release(*item, parker(counters));
+		// 超过上限的直接销毁，不再 park
+		CHECK(pool.idle() == 2);
+		CHECK(pool.in_use() == 0);
+		CHECK(counters.parked == 2);
+		CHECK(alive == 2);
+
+		pool.high_water(4);
+		CHECK(pool.high_water() == 4);
+		for (int i = 0; i < 4; ++i) items[i] = &take(pool, counters, "again");
+		CHECK(counters.reused == 2 && counters.created == 7);
+		pool.release_all(parker(counters));
+		CHECK(pool.idle() == 4 && pool.in_use() == 0);
+
+		// 降低上限立即销毁多余的空闲对象
+		pool.high_water(1);
+		CHECK(pool.idle() == 1);
+		CHECK(alive == 1);
+		pool.high_water(0);
+		CHECK(pool.idle() == 0);
+		Item& fresh = take(pool, counters, "fresh");
+		CHECK(pool.release(fresh, parker(counters)));
+		CHECK(pool.idle() == 0);
+		CHECK(alive == 0);
+	}
+	CHECK(alive == 0);
+}
+
+TEST(failed_create_leaves_pool_unchanged) {
+	Recycler<Item> pool(4);
+	bool thrown = false;
+	try {
+		pool.acquire([]() -> std::unique_ptr<Item> { throw std::runtime_error("create"); }, [](Item&) {});
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(pool.in_use() == 0 && pool.idle() == 0);
+}
+
+TEST(churn_reaches_a_steady_state) {
+	// 每次刷新放回所有行再取出同样多的行：第一次之后不再新建
+	Recycler<Item> pool(256);
+	Counters counters;
+	for (int refresh = 0; refresh < 10; ++refresh) {
+		pool.release_all(parker(counters));
+		for (int row = 0; row < 100; ++row) take(pool, counters, "row");
+	}
+	CHECK(counters.created == 100);
+	CHECK(counters.reused == 900);
+	CHECK(pool.in_use() == 100);
+}
+
+TEST_MAIN()
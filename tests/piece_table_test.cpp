@@ -0,0 +1,160 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// text::PieceTable 与 std::string 对照：随机插入、删除、连续输入、快照和撤销之后，
+// 内容、行号和按行读取都必须与直接修改 std::string 的结果一致
+#include "check.hpp"
+#include "PieceTable.hpp"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace w32oop::text;
+
+namespace {
+	// 参考实现：按 '\n' 分行，去掉行尾的 '\r' 后截断到 max_length
+	std::vector<std::string> split_lines(const std::string& text, size_t max_length) {
+		std::vector<std::string> lines;
+		size_t start = 0;
+		while (true) {
+			size_t end = text.find('\n', start);
+			std::string line = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			lines.push_back(line.substr(0, max_length));
+			if (end == std::string::npos) break;
+			start = end + 1;
+		}
+		return lines;
+	}
+
+	size_t reference_line_start(const std::string& text, size_t line) {
+		size_t start = 0, seen = 0;
+		for (size_t i = 0; i < text.size() && seen < line; ++i) {
+			if (text[i] == '\n') {
+				++seen;
+				start = i + 1;
+			}
+		}
+		return seen < line ? text.size() : start;
+	}
+
+	std::string random_text(std::mt19937_64& rng, size_t length, const char* alphabet, size_t letters) {
+		std::string text;
+		for (size_t i = 0; i < length; ++i) text += alphabet[rng() % letters];
+		return text;
+	}
+
+	// 对照一次：全文、行数、行首、行号、单个字符和按行读取
+	void compare(std::mt19937_64& rng, const PieceTable& table, const std::string& ref) {
+		CHECK(table.size() == ref.size());
+		CHECK(table.substr() == ref);
+		auto lines = split_lines(ref, std::string::npos);
+		CHECK(table.line_count() == lines.size());
+		auto snapshot = table.snapshot();
+		for (int q = 0; q < 10; ++q) {
+			size_t line = rng() % (lines.size() + 1);
+			CHECK(table.line_start(line) == reference_line_start(ref, line));
+			if (!ref.empty()) {
+				size_t pos = rng() % ref.size();
+				CHECK(table.line_of(pos) == (size_t)std::count(ref.begin(), ref.begin() + (std::ptrdiff_t)pos, '\n'));
+				CHECK(snapshot.at(pos) == ref[pos]);
+				size_t count = rng() % 100;
+				CHECK(table.substr(pos, count) == ref.substr(pos, count));
+			}
+			size_t max_length = rng() % 2 ? std::string::npos : rng() % 10;
+			auto truncated = split_lines(ref, max_length);
+			size_t count = rng() % 40, got = 0;
+			bool same = true;
+			snapshot.for_each_line(line, count, max_length, [&](std::string_view text) {
+				same = same && line + got < truncated.size() && text == truncated[line + got];
+				++got;
+			});
+			CHECK(same);
+			CHECK(got == (std::min)(count, lines.size() > line ? lines.size() - line : 0));
+			if (line < lines.size()) CHECK(table.line(line, max_length) == truncated[line]);
+		}
+	}
+}
+
+TEST(matches_std_string_under_random_edits) {
+	std::mt19937_64 rng(1);
+	for (int round = 0; round < 20; ++round) {
+		std::string original = random_text(rng, rng() % 150000, "\n\rabcdefghijklmnopqr", 20);
+		PieceTable table(original);
+		std::string ref = original;
+		std::vector<std::pair<PieceTable::Snapshot, std::string>> snapshots;
+		for (int op = 0; op < 400; ++op) {
+			int kind = (int)(rng() % 10);
+			if (kind < 4) {
+				// 插入，偶尔很长，会跨过追加缓冲区的块
+				size_t pos = ref.empty() ? 0 : rng() % (ref.size() + 1);
+				size_t length = rng() % 4 == 0 ? rng() % 80000 : rng() % 5;
+				std::string text = random_text(rng, length, "xy\n\r", 4);
+				table.insert(pos, text);
+				ref.insert(pos, text);
+			}
+			else if (kind < 6) {
+				// 连续输入：每次接在上一次插入的后面
+				size_t pos = table.size() ? rng() % table.size() : 0;
+				char first = "ab\n"[rng() % 3];
+				table.insert(pos, std::string_view(&first, 1));
+				ref.insert(ref.begin() + (std::ptrdiff_t)pos, first);
+				for (int i = 0; i < 20; ++i) {
+					++pos;
+					table.insert(pos, "q");
+					ref.insert(ref.begin() + (std::ptrdiff_t)pos, 'q');
+				}
+			}
+			else if (kind < 8) {
+				size_t pos = ref.empty() ? 0 : rng() % ref.size();
+				size_t count = rng() % 3000;
+				table.erase(pos, count);
+				if (pos < ref.size()) ref.erase(pos, count);
+			}
+			else if (kind < 9) {
+				snapshots.push_back({ table.snapshot(), ref });
+			}
+			else if (!snapshots.empty() && rng() % 4 == 0) {
+				auto& snapshot = snapshots[rng() % snapshots.size()];
+				table.restore(snapshot.first);
+				ref = snapshot.second;
+			}
+		}
+		compare(rng, table, ref);
+		// 之后的修改不影响旧的快照
+		for (const auto& snapshot : snapshots) CHECK(snapshot.first.substr() == snapshot.second);
+	}
+}
+
+TEST(out_of_range_arguments_are_clamped) {
+	std::string original = "one\r\ntwo\nthree";
+	PieceTable table(original);
+	CHECK(table.line_count() == 3);
+	CHECK(table.line(0) == "one" && table.line(1) == "two" && table.line(2) == "three");
+	CHECK(table.line(3).empty());
+	CHECK(table.line_start(9) == table.size());
+	table.insert(1000, "!");
+	CHECK(table.substr() == "one\r\ntwo\nthree!");
+	table.erase(1000, 5);
+	table.erase(9, 1000);
+	CHECK(table.substr() == "one\r\ntwo\n");
+	CHECK(table.line_count() == 3 && table.line(2).empty());
+	table.clear();
+	CHECK(table.empty() && table.line_count() == 1);
+}
+
+TEST(typing_extends_the_last_piece) {
+	std::string original(1000, 'a');
+	PieceTable table(original);
+	table.insert(500, "x");
+	size_t pieces = table.pieces();
+	for (size_t i = 0; i < 1000; ++i) table.insert(501 + i, "y");
+	CHECK(table.pieces() == pieces);
+	CHECK(table.substr(500, 1001) == "x" + std::string(1000, 'y'));
+}
+
+TEST_MAIN()
@@ -0,0 +1,197 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// hotkey::Published 的多读者、多写者压力测试。
+// tests/CMakeLists.txt 会在支持的编译器上再构建一份 ThreadSanitizer 版本；
+// 读者读到已释放或写了一半的快照时，这里的检查或 TSan 会报错。
+// 最后打印读者（钩子过程）和写者的延迟分布和最坏值。
+// 最坏值通常来自线程被抢占（核数少于线程数时尤其明显），分位数更能反映读者本身的开销
+#include "check.hpp"
+#include "HotKeyTable.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace w32oop::hotkey;
+
+namespace {
+#if defined(__SANITIZE_THREAD__)
+	constexpr int publishes = 2000;
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+	constexpr int publishes = 2000;
+#else
+	constexpr int publishes = 20000;
+#endif
+#else
+	constexpr int publishes = 20000;
+#endif
+	constexpr int reader_count = 4;
+
+	std::atomic<int> live{ 0 };
+
+	// 每个元素都由 generation 推出；析构时清零，读到已释放的快照会被发现
+	struct Snapshot {
+		uint64_t generation = 0;
+		std::array<uint64_t, 32> values{};
+
+		Snapshot() : Snapshot(0) {}
+		explicit Snapshot(uint64_t gen) : generation(gen) {
+			for (size_t i = 0; i < values.size(); ++i) values[i] = gen * 31 + i;
+			++live;
+		}
+		~Snapshot() {
+			values.fill(0);
+			generation = ~uint64_t(0);
+			--live;
+		}
+		bool consistent() const {
+			for (size_t i = 0; i < values.size(); ++i) {
+				if (values[i] != generation * 31 + i) return false;
+			}
+			return true;
+		}
+	};
+
+	using clock = std::chrono::steady_clock;
+
+	uint64_t since_ns(clock::time_point start) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+	}
+
+	struct ReaderResult {
+		uint64_t reads = 0;
+		bool consistent = true;
+		bool monotonic = true;
+	};
+
+	// LatencyHistogram 的分桶与单位无关，这里直接记录纳秒
+	void report(const char* what, const LatencyHistogram& histogram) {
+		auto stats = histogram.stats();
+		std::printf("  %-8s n=%llu p50<=%llu ns p99<=%llu ns p99.9<=%llu ns worst=%llu ns\n", what,
+			static_cast<unsigned long long>(stats.count),
+			static_cast<unsigned long long>(stats.percentile(0.5)),
+			static_cast<unsigned long long>(stats.percentile(0.99)),
+			static_cast<unsigned long long>(stats.percentile(0.999)),
+			static_cast<unsigned long long>(stats.max_us));
+	}
+
+	// 每个读者至少读一次，读过一次后计入 started，写者等所有读者都开始后才发布
+	void read_until(const Published<Snapshot>& published, const std::atomic<bool>& done, std::atomic<int>& started, ReaderResult& result, LatencyHistogram& latency) {
+		uint64_t last = 0;
+		do {
+			auto start = clock::now();
+			uint64_t generation;
+			{
+				auto reader = published.read();
+				if (!reader->consistent()) result.consistent = false;
+				generation = reader->generation;
+			}
+			latency.record(since_ns(start));
+			if (generation < last) result.monotonic = false;
+			last = generation;
+			if (++result.reads == 1) ++started;
+		} while (!done.load(std::memory_order_acquire));
+	}
+
+	void wait_for_readers(const std::atomic<int>& started) {
+		while (started.load() < reader_count) std::this_thread::yield();
+	}
+
+}
+
+TEST(single_writer_readers_see_consistent_monotonic_snapshots) {
+	std::vector<ReaderResult> results(reader_count);
+	LatencyHistogram read_latency, publish_latency;
+	{
+		Published<Snapshot> published;
+		std::atomic<bool> done{ false };
+		std::atomic<int> started{ 0 };
+		std::vector<std::thread> readers;
+		for (auto& result : results) {
+			readers.emplace_back([&published, &done, &started, &result, &read_latency] { read_until(published, done, started, result, read_latency); });
+		}
+		wait_for_readers(started);
+		for (int i = 1; i <= publishes; ++i) {
+			auto start = clock::now();
+			published.publish(std::make_unique<const Snapshot>(static_cast<uint64_t>(i)));
+			publish_latency.record(since_ns(start));
+		}
+		done = true;
+		for (auto& thread : readers) thread.join();
+		CHECK(published.generation() == static_cast<uint64_t>(publishes));
+		CHECK(published.read()->generation == static_cast<uint64_t>(publishes));
+		// 只剩当前快照，旧的都已释放
+		CHECK(live == 1);
+	}
+	CHECK(live == 0);
+	for (auto& result : results) {
+		CHECK(result.consistent);
+		CHECK(result.monotonic);
+		CHECK(result.reads > 0);
+	}
+	report("read", read_latency);
+	report("publish", publish_latency);
+}
+
+TEST(concurrent_writers_are_serialized) {
+	std::vector<ReaderResult> results(reader_count);
+	LatencyHistogram read_latency, publish_latency;
+	{
+		Published<Snapshot> published;
+		std::atomic<bool> done{ false };
+		std::atomic<int> started{ 0 };
+		std::vector<std::thread> threads;
+		for (auto& result : results) {
+			threads.emplace_back([&published, &done, &started, &result, &read_latency] { read_until(published, done, started, result, read_latency); });
+		}
+		wait_for_readers(started);
+		std::vector<std::thread> writers;
+		for (uint64_t w = 0; w < 2; ++w) {
+			writers.emplace_back([&published, &publish_latency, w] {
+				for (int i = 0; i < publishes / 2; ++i) {
+					auto start = clock::now();
+					published.publish(std::make_unique<const Snapshot>(static_cast<uint64_t>(i) * 2 + w));
+					publish_latency.record(since_ns(start));
+				}
+			});
+		}
+		for (auto& thread : writers) thread.join();
+		done = true;
+		for (auto& thread : threads) thread.join();
+		CHECK(published.generation() == static_cast<uint64_t>(publishes / 2 * 2));
+		CHECK(published.read()->consistent());
+		CHECK(live == 1);
+	}
+	CHECK(live == 0);
+	for (auto& result : results) CHECK(result.consistent);
+	report("read", read_latency);
+	report("publish", publish_latency);
+}
+
+TEST(generation_is_read_before_snapshot) {
+	// 先读 generation() 再读快照，快照不会比它旧
+	Published<Snapshot> published;
+	std::atomic<bool> done{ false };
+	std::atomic<bool> ordered{ true };
+	std::thread reader([&] {
+		while (!done.load(std::memory_order_acquire)) {
+			uint64_t generation = published.generation();
+			auto snapshot = published.read();
+			if (snapshot->generation < generation) ordered = false;
+		}
+	});
+	for (int i = 1; i <= publishes / 4; ++i) {
+		published.publish(std::make_unique<const Snapshot>(static_cast<uint64_t>(i)));
+	}
+	done = true;
+	reader.join();
+	CHECK(ordered);
+}
+
+TEST_MAIN()
@@ -0,0 +1,234 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// journal:: 的差异、回放和压缩，以及模拟崩溃：在任意位置截断、翻转任意一位、写到一半
+#include "check.hpp"
+#include "SessionJournal.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+
+namespace {
+	// 日志写到某条记录末尾时的文件长度和文档
+	struct Checkpoint {
+		size_t end;
+		journal::Document document;
+	};
+
+	bool same(const journal::Document& a, const journal::Document& b) {
+		return a.path == b.path && a.text == b.text;
+	}
+
+	std::u16string random_text(std::mt19937& rng, size_t length) {
+		static const char16_t alphabet[] = u"abc xyz\n\x4E2D\x6587\xD83D\xDE00";
+		std::u16string text;
+		for (size_t i = 0; i < length; ++i) text += alphabet[rng() % (std::size(alphabet) - 1)];
+		return text;
+	}
+
+	// 一次追加的字节中第一条记录的长度
+	size_t first_record_size(std::string_view appended) {
+		return 8 + (size_t)journal::detail::Reader(appended.substr(0, 4)).get(4);
+	}
+
+	// 随机的插入、删除和替换，偶尔改路径
+	void edit(std::mt19937& rng, journal::Document& doc) {
+		size_t at = doc.text.empty() ? 0 : rng() % (doc.text.size() + 1);
+		size_t removed = at == doc.text.size() ? 0 : rng() % (std::min)(doc.text.size() - at, size_t(8)) ;
+		doc.text.replace(at, removed, random_text(rng, rng() % 6));
+		if (rng() % 10 == 0) doc.path = u"C:\\notes\\" + random_text(rng, 3) + u".txt";
+	}
+
+	// 生成一份日志，返回文件内容和每条记录之后的检查点
+	std::string build(std::mt19937& rng, int edits, std::vector<Checkpoint>& checkpoints) {
+		journal::Journal writer;
+		journal::Document doc{ u"C:\\notes\\a.txt", random_text(rng, 40) };
+		std::string file(writer.compact(doc.path, doc.text));
+		checkpoints = { { journal::header_size, {} }, { file.size(), doc } };
+		for (int i = 0; i < edits; ++i) {
+			journal::Document before = doc;
+			edit(rng, doc);
+			std::string_view appended = writer.record(doc.path, doc.text);
+			// 同时改了路径和文本时追加两条记录，先路径后文本，中间也是一个检查点
+			size_t first = first_record_size(appended);
+			if (doc.path != before.path && first < appended.size()) {
+				checkpoints.push_back({ file.size() + first, { doc.path, before.text } });
+			}
+			file += appended;
+			if (checkpoints.back().end != file.size()) checkpoints.push_back({ file.size(), doc });
+			CHECK(same(writer.document(), doc));
+		}
+		return file;
+	}
+
+	// 长度不超过 size 的最后一个检查点
+	const Checkpoint& last_before(const std::vector<Checkpoint>& checkpoints, size_t size) {
+		const Checkpoint* found = &checkpoints.front();
+		for (const auto& checkpoint : checkpoints) {
+			if (checkpoint.end <= size) found = &checkpoint;
+		}
+		return *found;
+	}
+}
+
+TEST(diff_finds_the_changed_range) {
+	auto change = journal::diff(u"hello world", u"hello brave world");
+	CHECK(change.offset == 6 && change.removed == 0 && change.inserted == u"brave ");
+	change = journal::diff(u"aaaa", u"aa");
+	CHECK(change.offset == 2 && change.removed == 2 && change.inserted.empty());
+	change = journal::diff(u"abc", u"abc");
+	CHECK(change.empty());
+	change = journal::diff(u"", u"xyz");
+	CHECK(change.offset == 0 && change.removed == 0 && change.inserted == u"xyz");
+	change = journal::diff(u"abcdef", u"abXYef");
+	CHECK(change.offset == 2 && change.removed == 2 && change.inserted == u"XY");
+}
+
+TEST(crc32_matches_known_value) {
+	CHECK(journal::crc32("123456789") == 0xCBF43926u);
+	CHECK(journal::crc32("") == 0);
+	CHECK(journal::crc32("6789", journal::crc32("12345")) == 0xCBF43926u);
+}
+
+TEST(replays_every_truncation_point) {
+	std::mt19937 rng(48);
+	std::vector<Checkpoint> checkpoints;
+	std::string file = build(rng, 60, checkpoints);
+	CHECK(checkpoints.size() > 40);
+	for (size_t size = 0; size <= file.size(); ++size) {
+		auto result = journal::replay(std::string_view(file).substr(0, size));
+		if (size < journal::header_size) {
+			CHECK(!result.has_snapshot && result.valid_bytes == 0 && result.truncated == (size != 0));
+			continue;
+		}
+		const Checkpoint& expected = last_before(checkpoints, size);
+		CHECK(result.valid_bytes == expected.end);
+		CHECK(result.truncated == (size != expected.end));
+		CHECK(result.has_snapshot == (expected.end > journal::header_size));
+		CHECK(same(result.document, expected.document));
+	}
+}
+
+TEST(rejects_every_single_bit_flip) {
+	std::mt19937 rng(4801);
+	std::vector<Checkpoint> checkpoints;
+	std::string file = build(rng, 20, checkpoints);
+	for (size_t byte = 0; byte < file.size(); ++byte) {
+		for (int bit = 0; bit < 8; ++bit) {
+			std::string damaged = file;
+			damaged[byte] = char(damaged[byte] ^ (1 << bit));
+			auto result = journal::replay(damaged);
+			CHECK(result.truncated);
+			if (byte < journal::header_size) {
+				CHECK(!result.has_snapshot && result.valid_bytes == 0);
+				continue;
+			}
+			// 损坏的那条记录和之后的记录都不回放
+			const Checkpoint& expected = last_before(checkpoints, byte);
+			CHECK(result.valid_bytes == expected.end);
+			CHECK(same(result.document, expected.document));
+		}
+	}
+}
+
+TEST(rejects_records_that_do_not_apply) {
+	std::string file;
+	journal::write_header(file);
+	// 没有快照之前的替换
+	journal::Change change{ 0, 0, u"x" };
+	journal::write_change(file, change);
+	auto result = journal::replay(file);
+	CHECK(!result.has_snapshot && result.truncated && result.valid_bytes == journal::header_size);
+
+	file.resize(journal::header_size);
+	journal::write_snapshot(file, u"p", u"abc");
+	size_t snapshot_end = file.size();
+	// 超出文本范围的替换
+	change = { 2, 5, u"" };
+	journal::write_change(file, change);
+	result = journal::replay(file);
+	CHECK(result.valid_bytes == snapshot_end && result.truncated && result.document.text == u"abc");
+
+	// 版本不对的文件整个不用
+	std::string other = file.substr(0, snapshot_end);
+	other[4] = 2;
+	result = journal::replay(other);
+	CHECK(!result.has_snapshot && result.truncated);
+}
+
+TEST(compaction_round_trip) {
+	std::mt19937 rng(4802);
+	journal::Journal writer(4096, 2);
+	journal::Document doc{ u"C:\\a.txt", random_text(rng, 200) };
+	std::string file(writer.compact(doc.path, doc.text));
+	int compactions = 0;
+	for (int i = 0; i < 3000; ++i) {
+		edit(rng, doc);
+		file += writer.record(doc.path, doc.text);
+		CHECK(writer.size() == file.size());
+		if (writer.should_compact()) {
+			// 压缩前后回放的结果一样
+			auto before = journal::replay(file);
+			CHECK(!before.truncated && same(before.document, doc));
+			file.assign(writer.compact(doc.path, doc.text));
+			auto after = journal::replay(file);
+			CHECK(!after.truncated && after.records == 1 && same(after.document, doc));
+			CHECK(!writer.should_compact());
+			++compactions;
+		}
+	}
+	CHECK(compactions > 0);
+	auto result = journal::replay(file);
+	CHECK(!result.truncated && same(result.document, doc));
+}
+
+TEST(resumes_after_a_torn_write) {
+	std::mt19937 rng(4803);
+	for (int round = 0; round < 200; ++round) {
+		journal::Journal writer;
+		journal::Document doc{ u"C:\\b.txt", random_text(rng, 30) };
+		std::string file(writer.compact(doc.path, doc.text));
+		for (int i = rng() % 20; i > 0; --i) {
+			edit(rng, doc);
+			file += writer.record(doc.path, doc.text);
+		}
+		journal::Document saved = doc;
+		size_t saved_end = file.size();
+		// 最后一次追加只写进去一部分，后面可能还有垃圾
+		edit(rng, doc);
+		std::string tail(writer.record(doc.path, doc.text));
+		if (tail.empty()) continue;
+		size_t cut = rng() % tail.size();
+		file += tail.substr(0, cut);
+		if (rng() % 2) file += std::string("\xFF\x00\x13", 3);
+		// 路径和文本两条记录中的第一条已经写完整
+		size_t first = first_record_size(tail);
+		if (first < tail.size() && cut >= first) {
+			saved.path = doc.path;
+			saved_end += first;
+		}
+
+		// 恢复：回放、截断到最后一条完整记录，然后继续写
+		auto result = journal::replay(file);
+		CHECK(result.valid_bytes == saved_end && same(result.document, saved));
+		CHECK(result.truncated == (file.size() != saved_end));
+		file.resize(result.valid_bytes);
+		journal::Journal resumed;
+		resumed.resume(result.document, file.size());
+		doc = saved;
+		for (int i = 0; i < 5; ++i) {
+			edit(rng, doc);
+			file += resumed.record(doc.path, doc.text);
+		}
+		CHECK(resumed.size() == file.size());
+		auto final_state = journal::replay(file);
+		CHECK(!final_state.truncated && same(final_state.document, doc));
+	}
+}
+
+TEST_MAIN()
@@ -0,0 +1,74 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// util::TextDecoder 按小块解码双字节代码页（GBK、Shift-JIS）的文本：
+// 无论有没有换行，拼接后的结果都必须与整体解码相同，块边界不能切开双字节字符
+#include "check.hpp"
+#include "Window.hpp"
+#include <string>
+
+using namespace w32oop;
+
+namespace {
+	std::string encode(const std::wstring& text, UINT code_page) {
+		int length = WideCharToMultiByte(code_page, 0, text.data(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+		std::string bytes((size_t)length, '\0');
+		WideCharToMultiByte(code_page, 0, text.data(), (int)text.size(), bytes.data(), length, nullptr, nullptr);
+		return bytes;
+	}
+
+	std::wstring decode_in_chunks(const std::string& bytes, UINT code_page, size_t chunk_bytes) {
+		util::TextDecoder decoder(bytes, utf::Encoding::Ansi, code_page);
+		std::wstring text, chunk;
+		while (decoder.next(chunk, chunk_bytes)) text += chunk;
+		return text;
+	}
+
+	// 每个块大小都试一遍，让块边界落在每个字节偏移上
+	void check_all_chunk_sizes(const std::wstring& text, UINT code_page) {
+		std::string bytes = encode(text, code_page);
+		CHECK(bytes.size() > text.size());
+		for (size_t chunk_bytes = 16; chunk_bytes < 64; ++chunk_bytes) {
+			CHECK(decode_in_chunks(bytes, code_page, chunk_bytes) == text);
+		}
+	}
+
+	// 汉字和假名的尾字节大多落在前导字节的范围内，单字节的 ASCII 让字符从奇数偏移开始
+	const std::wstring chinese = L"压缩过的单行文件也要按字符分块a中文编码测试";
+	const std::wstring japanese = L"改行のないファイルも文字単位で分割するb日本語のテキスト";
+}
+
+TEST(gbk_without_newlines) {
+	std::wstring text;
+	for (int i = 0; i < 20; ++i) text += chinese;
+	check_all_chunk_sizes(text, 936);
+}
+
+TEST(shift_jis_without_newlines) {
+	std::wstring text;
+	for (int i = 0; i < 20; ++i) text += japanese;
+	check_all_chunk_sizes(text, 932);
+}
+
+TEST(gbk_with_newlines) {
+	std::wstring text;
+	for (int i = 0; i < 20; ++i) text += chinese + (i % 3 ? L"\r\n" : L"");
+	check_all_chunk_sizes(text, 936);
+}
+
+TEST(progress_reaches_the_end) {
+	std::string bytes = encode(chinese, 936);
+	util::TextDecoder decoder(bytes, utf::Encoding::Ansi, 936);
+	std::wstring chunk;
+	size_t last = 0;
+	while (decoder.next(chunk, 16)) {
+		CHECK(decoder.position() > last);
+		last = decoder.position();
+	}
+	CHECK(decoder.done() && decoder.position() == bytes.size());
+}
+
+TEST_MAIN()
@@ -0,0 +1,330 @@
+﻿/*
+MIT License, Copyright (c) 2025 @chcs1013
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+// utf:: 的往返转换、分块与整段一致、非法输入的替换。
+// 这个文件会按默认（SSE2 / NEON）、纯标量和 AVX2 分别编译，每个版本都与下面的逐字节参考实现比较
+#include "check.hpp"
+#include "Utf.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace w32oop;
+
+namespace {
+	// 参考实现：逐个码点编码，不走任何快速路径
+	void append_utf8(std::string& out, char32_t cp) {
+		if (cp < 0x80) {
+			out += char(cp);
+		}
+		else if (cp < 0x800) {
+			out += char(0xC0 | (cp >> 6));
+			out += char(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000) {
+			out += char(0xE0 | (cp >> 12));
+			out += char(0x80 | ((cp >> 6) & 0x3F));
+			out += char(0x80 | (cp & 0x3F));
+		}
+		else {
+			out += char(0xF0 | (cp >> 18));
+			out += char(0x80 | ((cp >> 12) & 0x3F));
+			out += char(0x80 | ((cp >> 6) & 0x3F));
+			out += char(0x80 | (cp & 0x3F));
+		}
+	}
+
+	void append_utf16(std::u16string& out, char32_t cp) {
+		if (cp < 0x10000) {
+			out += char16_t(cp);
+		}
+		else {
+			out += char16_t(0xD800 + ((cp - 0x10000) >> 10));
+			out += char16_t(0xDC00 + (cp & 0x3FF));
+		}
+	}
+
+	// 参考解码：按 Unicode 表 3-7 逐字节检查，每个最长非法子序列换成一个 U+FFFD
+	std::u16string reference_utf16(std::string_view in, size_t& invalid) {
+		std::u16string out;
+		invalid = 0;
+		size_t i = 0;
+		while (i < in.size()) {
+			unsigned char b0 = (unsigned char)in[i];
+			size_t length = b0 < 0x80 ? 1 : b0 >= 0xC2 && b0 <= 0xDF ? 2 : b0 >= 0xE0 && b0 <= 0xEF ? 3 : b0 >= 0xF0 && b0 <= 0xF4 ? 4 : 0;
+			if (length == 1) {
+				out += char16_t(b0);
+				++i;
+				continue;
+			}
+			size_t k = 1;
+			char32_t cp = length ? b0 & (0x7F >> length) : 0;
+			for (; length && k < length && i + k < in.size(); ++k) {
+				unsigned char b = (unsigned char)in[i + k];
+				unsigned char lo = 0x80, hi = 0xBF;
+				if (k == 1 && b0 == 0xE0) lo = 0xA0;
+				if (k == 1 && b0 == 0xED) hi = 0x9F;
+				if (k == 1 && b0 == 0xF0) lo = 0x90;
+				if (k == 1 && b0 == 0xF4) hi = 0x8F;
+				if (b < lo || b > hi) break;
+				cp = (cp << 6) | (b & 0x3F);
+			}
+			if (length && k == length) {
+				append_utf16(out, cp);
+			}
+			else {
+				out += char16_t(utf::replacement);
+				++invalid;
+			}
+			i += length ? k : 1;
+		}
+		return out;
+	}
+
+	std::u16string decode(std::string_view in, size_t* invalid = nullptr) {
+		std::u16string out(utf::utf16_length(in), u'\0');
+		auto result = utf::convert(in, out.data());
+		CHECK(result.read == in.size());
+		CHECK(result.written == out.size());
+		if (invalid) *invalid = result.invalid;
+		return out;
+	}
+
+	std::string encode(std::u16string_view in, size_t* invalid = nullptr) {
+		std::string out(utf::utf8_length(in), '\0');
+		auto result = utf::convert(in, out.data());
+		CHECK(result.read == in.size());
+		CHECK(result.written == out.size());
+		if (invalid) *invalid = result.invalid;
+		return out;
+	}
+
+	// 语料：各种文字混排，含每种编码长度的边界码点和长段 ASCII
+	std::vector<char32_t> corpus(std::mt19937& rng, size_t count) {
+		static const char32_t edges[] = { 0x00, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFEFF, 0xFFFD, 0xFFFF, 0x10000, 0x1F600, 0x10FFFF };
+		std::vector<char32_t> result;
+		while (result.size() < count) {
+			switch (rng() % 6) {
+			case 0: {
+				// 英文：长度跨过 8 / 16 / 32 字节的 SIMD 块
+				size_t run = rng() % 70;
+				for (size_t k = 0; k < run; ++k) result.push_back(0x20 + rng() % 0x5F);
+				break;
+			}
+			case 1:
+				result.push_back(0x4E00 + rng() % 0x5200);  // 汉字
+				break;
+			case 2:
+				result.push_back(0xC0 + rng() % 0x1C0);  // 带重音的拉丁字母
+				break;
+			case 3:
+				result.push_back(0x1F300 + rng() % 0x300);  // emoji
+				break;
+			case 4:
+				result.push_back(edges[rng() % std::size(edges)]);
+				break;
+			default: {
+				char32_t cp = rng() % 0x110000;
+				if (cp >= 0xD800 && cp <= 0xDFFF) cp -= 0x800;
+				result.push_back(cp);
+				break;
+			}
+			}
+		}
+		return result;
+	}
+
+	// 随机字节，偏向能组成（或差一点组成）UTF-8 序列的值
+	std::string noisy_bytes(std::mt19937& rng, size_t count) {
+		static const unsigned char interesting[] = { 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xFF };
+		std::string result;
+		while (result.size() < count) {
+			unsigned r = rng() % 4;
+			if (r == 0) result += char(rng() % 0x80);
+			else if (r == 1) result += char(interesting[rng() % std::size(interesting)]);
+			else if (r == 2) result += char(0x80 + rng() % 0x40);
+			else {
+				char32_t cp = 0x80 + rng() % 0x10FF80;
+				if (cp >= 0xD800 && cp <= 0xDFFF) cp -= 0x800;
+				append_utf8(result, cp);
+			}
+		}
+		return result;
+	}
+}
+
+TEST(ascii_prefix_matches_byte_scan) {
+	// 非 ASCII 字节放在每个位置，起点也错开，覆盖 SIMD 块内、块边界和尾部
+	for (size_t n = 0; n <= 80; ++n) {
+		for (size_t offset = 0; offset < 4; ++offset) {
+			std::string bytes(offset + n, 'a');
+			std::u16string units(offset + n, u'a');
+			auto b = reinterpret_cast<const unsigned char*>(bytes.data()) + offset;
+			CHECK(utf::detail::ascii_prefix(b, n) == n);
+			CHECK(utf::detail::ascii_prefix(units.data() + offset, n) == n);
+			for (size_t at = 0; at < n; ++at) {
+				bytes[offset + at] = char(0x80);
+				units[offset + at] = u'\x100';
+				CHECK(utf::detail::ascii_prefix(b, n) == at);
+				CHECK(utf::detail::ascii_prefix(units.data() + offset, n) == at);
+				units[offset + at] = u'\x80';
+				CHECK(utf::detail::ascii_prefix(units.data() + offset, n) == at);
+				bytes[offset + at] = 'a';
+				units[offset + at] = u'a';
+			}
+		}
+	}
+}
+
+TEST(widen_and_narrow_every_length) {
+	std::string bytes;
+	for (int i = 0; i < 100; ++i) bytes += char(i % 0x80);
+	for (size_t n = 0; n <= 80; ++n) {
+		for (size_t offset = 0; offset < 4; ++offset) {
+			auto b = reinterpret_cast<const unsigned char*>(bytes.data()) + offset;
+			std::u16string wide(n + 1, u'#');
+			utf::detail::widen_ascii(b, n, wide.data());
+			std::string narrow(n + 1, '#');
+			utf::detail::narrow_ascii(wide.data(), n, reinterpret_cast<unsigned char*>(narrow.data()));
+			bool same = wide[n] == u'#' && narrow[n] == '#';
+			for (size_t k = 0; k < n; ++k) same = same && wide[k] == char16_t(b[k]) && narrow[k] == char(b[k]);
+			CHECK(same);
+		}
+	}
+}
+
+TEST(corpus_round_trip) {
+	std::mt19937 rng(44);
+	for (int round = 0; round < 200; ++round) {
+		std::string utf8;
+		std::u16string utf16;
+		for (char32_t cp : corpus(rng, 1 + rng() % 400)) {
+			append_utf8(utf8, cp);
+			append_utf16(utf16, cp);
+		}
+		size_t invalid = 1;
+		CHECK(decode(utf8, &invalid) == utf16);
+		CHECK(invalid == 0);
+		invalid = 1;
+		CHECK(encode(utf16, &invalid) == utf8);
+		CHECK(invalid == 0);
+		CHECK(utf::is_valid(utf8) && utf::is_valid(utf16));
+		CHECK(utf::to_utf8(utf::to_utf16(utf8)) == utf8);
+	}
+}
+
+TEST(invalid_utf8_matches_reference) {
+	// Unicode 标准 3.9 节的例子
+	size_t invalid = 0;
+	CHECK(decode("\x61\xF1\x80\x80\xE1\x80\xC2\x62\x80\x63\x80\xBF\x64", &invalid) == u"a\xFFFD\xFFFD\xFFFD" u"b\xFFFD" u"c\xFFFD\xFFFD" u"d");
+	CHECK(invalid == 6);
+	CHECK(decode("\xC0\xAF\xE0\x80\xBF\xED\xA0\x80\xF4\x90\x80\x80") == std::u16string(12, u'\xFFFD'));
+	CHECK(decode("\xF0\x9F\x98") == u"\xFFFD");
+
+	std::mt19937 rng(4401);
+	for (int round = 0; round < 2000; ++round) {
+		std::string bytes = noisy_bytes(rng, rng() % 100);
+		size_t expected_invalid = 0;
+		std::u16string expected = reference_utf16(bytes, expected_invalid);
+		invalid = 0;
+		CHECK(decode(bytes, &invalid) == expected);
+		CHECK(invalid == expected_invalid);
+		CHECK(utf::is_valid(bytes) == (expected_invalid == 0));
+	}
+}
+
+TEST(unpaired_surrogates_become_replacements) {
+	size_t invalid = 0;
+	CHECK(encode(u"a\xD800" u"b", &invalid) == "a\xEF\xBF\xBD" "b");
+	CHECK(invalid == 1);
+	CHECK(encode(u"\xDC00\xD83D", &invalid) == "\xEF\xBF\xBD\xEF\xBF\xBD");
+	CHECK(invalid == 2);
+	CHECK(encode(u"\xD83D\xDE00") == "\xF0\x9F\x98\x80");
+}
+
+TEST(chunked_decode_matches_whole) {
+	std::mt19937 rng(4402);
+	for (int round = 0; round < 1000; ++round) {
+		std::string bytes = round % 2 ? noisy_bytes(rng, rng() % 200) : std::string();
+		if (round % 2 == 0) {
+			for (char32_t cp : corpus(rng, rng() % 100)) append_utf8(bytes, cp);
+		}
+		size_t whole_invalid = 0;
+		std::u16string whole = decode(bytes, &whole_invalid);
+
+		utf::Utf8Decoder decoder;
+		std::u16string chunked;
+		size_t invalid = 0, pos = 0;
+		size_t max_chunk = 1 + rng() % 20;
+		do {
+			size_t take = (std::min)(bytes.size() - pos, size_t(rng() % (max_chunk + 1)));
+			bool final = pos + take == bytes.size() && rng() % 2;
+			std::u16string out(take + 2, u'\0');
+			auto result = decoder.feed(std::string_view(bytes).substr(pos, take), out.data(), final);
+			CHECK(result.read == take);
+			chunked.append(out.data(), result.written);
+			invalid += result.invalid;
+			pos += take;
+			if (final) break;
+		} while (pos < bytes.size() || decoder.pending());
+		if (decoder.pending()) {
+			std::u16string out(2, u'\0');
+			auto result = decoder.feed(std::string_view(), out.data(), true);
+			chunked.append(out.data(), result.written);
+			invalid += result.invalid;
+		}
+		CHECK(decoder.pending() == 0);
+		CHECK(chunked == whole);
+		CHECK(invalid == whole_invalid);
+	}
+}
+
+TEST(chunked_encode_matches_whole) {
+	static const char16_t units[] = { u'a', u'z', u'\x7F', u'\x80', u'\x7FF', u'\x800', u'\x4E2D', u'\xD83D', u'\xDE00', u'\xDBFF', u'\xDC00', u'\xFFFF' };
+	std::mt19937 rng(4403);
+	for (int round = 0; round < 1000; ++round) {
+		std::u16string text;
+		for (size_t k = rng() % 200; k > 0; --k) text += units[rng() % std::size(units)];
+		size_t whole_invalid = 0;
+		std::string whole = encode(text, &whole_invalid);
+
+		utf::Utf16Encoder encoder;
+		std::string chunked;
+		size_t invalid = 0, pos = 0;
+		while (pos < text.size()) {
+			size_t take = (std::min)(text.size() - pos, size_t(rng() % 9));
+			std::string out(take * 3 + 4, '\0');
+			auto result = encoder.feed(std::u16string_view(text).substr(pos, take), out.data());
+			CHECK(result.read == take);
+			chunked.append(out.data(), result.written);
+			invalid += result.invalid;
+			pos += take;
+		}
+		std::string out(4, '\0');
+		auto result = encoder.feed(std::u16string_view(), out.data(), true);
+		chunked.append(out.data(), result.written);
+		invalid += result.invalid;
+		CHECK(encoder.pending() == 0);
+		CHECK(chunked == whole);
+		CHECK(invalid == whole_invalid);
+	}
+}
+
+TEST(detects_encodings) {
+	size_t bom = 0;
+	CHECK(utf::detect_bom("\xEF\xBB\xBFx", bom) == utf::Encoding::Utf8 && bom == 3);
+	CHECK(utf::detect_bom("\xFF\xFEx", bom) == utf::Encoding::Utf16LE && bom == 2);
+	CHECK(utf::detect_bom("x", bom) == utf::Encoding::Unknown && bom == 0);
+	CHECK(utf::detect_encoding(std::string_view("h\0e\0l\0l\0o\0", 10)) == utf::Encoding::Utf16LE);
+	CHECK(utf::detect_encoding(std::string_view("\0h\0e\0l\0l\0o", 10)) == utf::Encoding::Utf16BE);
+	CHECK(utf::detect_encoding("plain ascii") == utf::Encoding::Utf8);
+	CHECK(utf::detect_encoding("\xE4\xB8\xAD\xE6\x96\x87") == utf::Encoding::Utf8);
+	CHECK(utf::detect_encoding("\xD6\xD0\xCE\xC4") == utf::Encoding::Ansi);
+	// 样本在多字节字符中间截断不算非法
+	CHECK(utf::detect_encoding("ab\xE4\xB8\xAD", 4) == utf::Encoding::Utf8);
+}
+
+TEST_MAIN()